@@ -0,0 +1,65 @@
+package com.passgfw
+
+/**
+ * Per-host circuit breakers, shared by every URL and detection round in the
+ * process
+ *
+ * A host opens after CIRCUIT_FAILURE_THRESHOLD consecutive failed requests
+ * and its URLs are then skipped without a request. After CIRCUIT_COOLDOWN it
+ * turns half-open: a single trial request goes out, closing the breaker on
+ * success and reopening it for another cooldown on failure. Any HTTP status
+ * counts as success, since the host answered.
+ */
+object CircuitBreaker {
+    private enum class State { CLOSED, OPEN, HALF_OPEN }
+
+    private class Host {
+        var state = State.CLOSED
+        var failures = 0
+        var openedAt = 0L
+    }
+
+    private val hosts = HashMap<String, Host>()  // Only hosts with failures
+
+    /**
+     * Whether a request to host may go out now. On a half-open host the
+     * first caller gets the trial and later callers are refused until it ends.
+     */
+    @Synchronized
+    fun allow(host: String): Boolean {
+        if (!Config.CIRCUIT_BREAKER) return true
+        val h = hosts[host] ?: return true
+        return when (h.state) {
+            State.CLOSED -> true
+            State.HALF_OPEN -> false
+            State.OPEN -> {
+                if (System.currentTimeMillis() - h.openedAt < Config.CIRCUIT_COOLDOWN) return false
+                h.state = State.HALF_OPEN
+                Logger.debug { "Circuit half-open, sending trial: $host" }
+                true
+            }
+        }
+    }
+
+    @Synchronized
+    fun recordSuccess(host: String) {
+        val h = hosts.remove(host) ?: return
+        if (h.state != State.CLOSED) {
+            Logger.info { "Circuit closed: $host" }
+        }
+    }
+
+    @Synchronized
+    fun recordFailure(host: String) {
+        if (!Config.CIRCUIT_BREAKER) return
+        val h = hosts.getOrPut(host) { Host() }
+        h.failures++
+        if (h.state == State.HALF_OPEN || h.failures >= Config.CIRCUIT_FAILURE_THRESHOLD) {
+            if (h.state != State.OPEN) {
+                Logger.warning { "Circuit open for ${Config.CIRCUIT_COOLDOWN}ms: $host (${h.failures} failures)" }
+            }
+            h.state = State.OPEN
+            h.openedAt = System.currentTimeMillis()
+        }
+    }
+}
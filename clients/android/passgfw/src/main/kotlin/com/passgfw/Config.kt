@@ -6,7 +6,9 @@ package com.passgfw
 data class URLEntry(
     val method: String,              // "api", "file", "navigate", or "remove"
     val url: String,
-    val store: Boolean = false       // 是否持久化存储（只对 api 和 file 有效，默认 false）
+    val store: Boolean = false,      // 是否持久化存储（只对 api 和 file 有效，默认 false）
+    val addrs: List<String>? = null, // IP 提示：先于 DNS 连接，同时后台解析（只对 api 和 file 有效）
+    val addrsExpires: Long = 0       // IP 提示的过期时间（Unix 秒）
 )
 
 /**
@@ -62,5 +64,54 @@ rwIDAQAB
     const val CONCURRENT_CHECK_COUNT = 3        // 同时检测的 URL 数量（批次大小）
     const val FILE_METHOD_CONCURRENT = false    // File 类型是否允许并发（建议false避免递归爆炸）
     // BUILD_CONFIG_END
+
+    // Client identity
+    const val CLIENT_ID_SIZE = 16    // 随机字节数，用于服务器端后端亲和（rendezvous hashing）
+
+    // Probe correlation
+    const val PROBE_ID_HEADER = "X-PassGFW-Probe"  // 服务器原样回显，并附带 Server-Timing
+    const val PROBE_ID_SIZE = 8      // 随机字节数（十六进制编码）
+
+    // Transport
+    const val TCP_FAST_OPEN = true   // 新建连接使用 TCP Fast Open（内核不支持时自动退回）
+
+    // DNS
+    const val DNS_CACHE = true                  // 使用内置解析缓存（A/AAAA 并行解析、持久化、地址竞速）
+    const val DNS_TIMEOUT = 3000L               // 单次解析超时（毫秒）
+    const val DNS_CACHE_TTL = 300_000L          // 解析结果缓存时间（系统接口不返回记录 TTL）
+    const val DNS_STALE_TTL = 86_400_000L       // 重新解析失败时仍可使用过期结果的时长
+    const val DNS_NEGATIVE_TTL = 30_000L        // 解析失败结果的缓存时间
+    const val DNS_RESOLUTION_DELAY = 50L        // 一个地址族先返回后等待另一族的时间（RFC 8305）
+    const val CONNECTION_ATTEMPT_DELAY = 250L   // 地址竞速中相邻两次连接尝试的间隔（RFC 8305）
+    const val RACE_BUDGET = 1000L               // 地址竞速的总时长上限，超时后交给 OkHttp 按顺序回退
+
+    // Cache revalidation
+    const val REVALIDATE_CACHE = true           // getDomains(retry=false) 返回缓存前先 TCP 连接其 domain 确认可达
+    const val REVALIDATE_TIMEOUT = 800L         // 可达性检查的总预算（毫秒，含解析）
+
+    // Circuit breaker
+    const val CIRCUIT_BREAKER = true            // 按主机熔断：同一主机上的所有 URL、所有检测轮次共享状态
+    const val CIRCUIT_FAILURE_THRESHOLD = 2     // 连续失败多少次后熔断（HTTP 错误码不算失败）
+    const val CIRCUIT_COOLDOWN = 30_000L        // 熔断时长（毫秒），之后放行一次试探请求
+
+    // Pipelining
+    const val PAYLOAD_PREFETCH = 2              // 探测进行时在后台预先加密好的请求数（每个含新 nonce，仅用一次）
+
+    // Data budget (getDomains retry loop; limits are per BUDGET_WINDOW)
+    const val DATA_BUDGET = true                // 用量超过限额一半后放慢重试，用完后等窗口内旧请求过期
+    const val BUDGET_WINDOW = 3_600_000L        // 滑动窗口（毫秒）
+    const val BUDGET_RADIO_TAIL = 10_000L       // 距上次请求结束超过此时长的请求计为一次无线唤醒
+    const val BUDGET_REQUEST_OVERHEAD = 1024L   // 每个请求在请求/响应体之外计入的字节（头部、握手估算）
+    val BUDGET_FOREGROUND_UNMETERED = BudgetLimits(probes = 3600, bytes = 16_000_000, wakeups = 120)
+    val BUDGET_FOREGROUND_METERED = BudgetLimits(probes = 1200, bytes = 4_000_000, wakeups = 60)
+    val BUDGET_BACKGROUND_UNMETERED = BudgetLimits(probes = 600, bytes = 4_000_000, wakeups = 30)
+    val BUDGET_BACKGROUND_METERED = BudgetLimits(probes = 120, bytes = 500_000, wakeups = 12)
+
+    // Cross-process answer
+    const val SHARED_ANSWER = true              // 应用的多个进程通过内存映射文件共享检测结果，同一时间只有一个进程在检测
+    const val SHARED_ANSWER_SIZE = 65_536       // 映射文件大小（字节），放不下的结果只缓存在本进程
+
+    // Diagnostics
+    const val TRACE_BUFFER_SIZE = 512           // 内存中保留的检测事件数（exportTrace 导出），0 关闭
 }
 
@@ -35,7 +35,7 @@ class CryptoHelper {
             
             true
         } catch (e: Exception) {
-            Logger.error("Failed to set public key: ${e.message}")
+            Logger.error { "Failed to set public key: ${e.message}" }
             false
         }
     }
@@ -60,7 +60,7 @@ class CryptoHelper {
             cipher.init(Cipher.ENCRYPT_MODE, key)
             cipher.doFinal(data)
         } catch (e: Exception) {
-            Logger.error("Encryption failed: ${e.message}")
+            Logger.error { "Encryption failed: ${e.message}" }
             null
         }
     }
@@ -76,7 +76,7 @@ class CryptoHelper {
             sig.update(data)
             sig.verify(signature)
         } catch (e: Exception) {
-            Logger.error("Signature verification failed: ${e.message}")
+            Logger.error { "Signature verification failed: ${e.message}" }
             false
         }
     }
@@ -0,0 +1,134 @@
+package com.passgfw
+
+import android.app.ActivityManager
+import android.content.Context
+import android.net.ConnectivityManager
+import android.os.SystemClock
+
+/**
+ * Detection limits for one BUDGET_WINDOW
+ */
+data class BudgetLimits(
+    val probes: Int,    // Requests (API probes and file lists)
+    val bytes: Long,    // Estimated bytes on the wire
+    val wakeups: Int    // Requests that had to wake the radio
+)
+
+/**
+ * Detection usage over the last BUDGET_WINDOW and the limits that apply now
+ */
+data class BudgetState(
+    val metered: Boolean,
+    val foreground: Boolean,
+    val probes: Int,
+    val bytes: Long,
+    val wakeups: Int,
+    val limits: BudgetLimits,
+    val retryDelay: Long    // Milliseconds getDomains waits before its next round
+) {
+    val exhausted: Boolean
+        get() = probes >= limits.probes || bytes >= limits.bytes || wakeups >= limits.wakeups
+}
+
+/**
+ * Radio and data budget of the detection retry loop
+ *
+ * Every request is recorded with its estimated size. A request that starts
+ * more than BUDGET_RADIO_TAIL after the previous one ended counts as a radio
+ * wake-up, since the radio has dropped out of its high-power state by then.
+ * Usage over the sliding BUDGET_WINDOW is checked against the limits for the
+ * current network (metered or not) and app state (foreground or background).
+ *
+ * retryDelay() is RETRY_INTERVAL while usage is below half of every limit,
+ * then stretches as usage grows; once a limit is reached it is the time until
+ * enough of the window has expired to get back under all limits.
+ */
+class DataBudget(context: Context) {
+    private class Request(val at: Long, val bytes: Long, val wakeup: Boolean)
+
+    private val connectivity = context.getSystemService(ConnectivityManager::class.java)
+    private val requests = ArrayDeque<Request>()  // Oldest first, within BUDGET_WINDOW
+    private var lastActivity = Long.MIN_VALUE / 2
+
+    /**
+     * Clock for record(): milliseconds since boot, including deep sleep
+     */
+    fun now(): Long = SystemClock.elapsedRealtime()
+
+    /**
+     * Record a request that started at startedAt (see now()) and moved
+     * bodyBytes of request and response bodies
+     */
+    @Synchronized
+    fun record(startedAt: Long, bodyBytes: Long) {
+        val now = now()
+        val wakeup = startedAt - lastActivity > Config.BUDGET_RADIO_TAIL
+        lastActivity = now
+        requests.addLast(Request(now, bodyBytes + Config.BUDGET_REQUEST_OVERHEAD, wakeup))
+        prune(now)
+    }
+
+    @Synchronized
+    fun state(): BudgetState {
+        val now = now()
+        prune(now)
+        val metered = isMetered()
+        val foreground = isForeground()
+        val limits = when {
+            foreground && metered -> Config.BUDGET_FOREGROUND_METERED
+            foreground -> Config.BUDGET_FOREGROUND_UNMETERED
+            metered -> Config.BUDGET_BACKGROUND_METERED
+            else -> Config.BUDGET_BACKGROUND_UNMETERED
+        }
+        val probes = requests.size
+        val bytes = requests.sumOf { it.bytes }
+        val wakeups = requests.count { it.wakeup }
+        return BudgetState(metered, foreground, probes, bytes, wakeups, limits,
+            retryDelay(now, limits, probes, bytes, wakeups))
+    }
+
+    /**
+     * Wait before the next detection round
+     */
+    fun retryDelay(): Long = if (Config.DATA_BUDGET) state().retryDelay else Config.RETRY_INTERVAL
+
+    private fun retryDelay(now: Long, limits: BudgetLimits, probes: Int, bytes: Long, wakeups: Int): Long {
+        val usage = maxOf(
+            probes.toDouble() / limits.probes,
+            bytes.toDouble() / limits.bytes,
+            wakeups.toDouble() / limits.wakeups
+        )
+        if (usage < 0.5) return Config.RETRY_INTERVAL
+        if (usage < 1) {
+            return (Config.RETRY_INTERVAL / (2 * (1 - usage))).toLong().coerceAtMost(Config.BUDGET_WINDOW)
+        }
+
+        // Exhausted: wait for the oldest requests to leave the window
+        var p = probes
+        var b = bytes
+        var w = wakeups
+        for (request in requests) {
+            p--
+            b -= request.bytes
+            if (request.wakeup) w--
+            if (p < limits.probes && b < limits.bytes && w < limits.wakeups) {
+                return (request.at + Config.BUDGET_WINDOW - now).coerceAtLeast(Config.RETRY_INTERVAL)
+            }
+        }
+        return Config.BUDGET_WINDOW
+    }
+
+    private fun prune(now: Long) {
+        while (requests.isNotEmpty() && now - requests.first().at >= Config.BUDGET_WINDOW) {
+            requests.removeFirst()
+        }
+    }
+
+    private fun isMetered(): Boolean = connectivity?.isActiveNetworkMetered ?: true
+
+    private fun isForeground(): Boolean {
+        val info = ActivityManager.RunningAppProcessInfo()
+        ActivityManager.getMyMemoryState(info)
+        return info.importance <= ActivityManager.RunningAppProcessInfo.IMPORTANCE_FOREGROUND
+    }
+}
@@ -0,0 +1,90 @@
+package com.passgfw
+
+import org.json.JSONArray
+import org.json.JSONObject
+import java.util.concurrent.atomic.AtomicLong
+import java.util.concurrent.atomic.AtomicReferenceArray
+
+/**
+ * In-memory record of recent detection events, for "stuck connecting" reports
+ *
+ * Events go into a fixed ring of TRACE_BUFFER_SIZE slots. A writer claims a
+ * sequence number with one atomic increment and overwrites the oldest slot,
+ * so recording never blocks a probe. Warnings and errors are recorded even
+ * when logging is off, which makes them the failure reasons of the trace.
+ *
+ * export() renders the ring as Chrome trace-event JSON for chrome://tracing
+ * or ui.perfetto.dev. Spans become async events, so concurrent probes get
+ * rows of their own.
+ */
+object DiagnosticTrace {
+    const val ENABLED = Config.TRACE_BUFFER_SIZE > 0
+
+    private class Event(
+        val seq: Long,
+        val name: String,
+        val startUs: Long,
+        val durUs: Long,  // -1 for an instant
+        val args: Map<String, Any?>
+    )
+
+    private val slots = AtomicReferenceArray<Event?>(Config.TRACE_BUFFER_SIZE)
+    private val next = AtomicLong()
+    private val epochMs = System.currentTimeMillis()
+    private val epochNs = System.nanoTime()
+
+    /**
+     * Monotonic microseconds since the SDK loaded; pass it to span() later
+     */
+    fun now(): Long = (System.nanoTime() - epochNs) / 1000
+
+    /**
+     * Record a span that began at startUs (from now()) and ends now
+     */
+    fun span(name: String, startUs: Long, args: Map<String, Any?> = emptyMap()) {
+        if (ENABLED) record(name, startUs, maxOf(now() - startUs, 0), args)
+    }
+
+    fun instant(name: String, args: Map<String, Any?> = emptyMap()) {
+        if (ENABLED) record(name, now(), -1, args)
+    }
+
+    private fun record(name: String, startUs: Long, durUs: Long, args: Map<String, Any?>) {
+        val seq = next.getAndIncrement()
+        slots.set((seq % Config.TRACE_BUFFER_SIZE).toInt(), Event(seq, name, startUs, durUs, args))
+    }
+
+    /**
+     * The buffered events, oldest first, as Chrome trace-event JSON
+     */
+    fun export(): String {
+        val events = JSONArray()
+        val end = next.get()
+        for (seq in maxOf(end - Config.TRACE_BUFFER_SIZE, 0) until end) {
+            // A slot still being written holds an older event
+            val event = slots.get((seq % Config.TRACE_BUFFER_SIZE).toInt())?.takeIf { it.seq == seq } ?: continue
+            val args = JSONObject()
+            event.args.forEach { (key, value) -> if (value != null) args.put(key, value) }
+            if (event.durUs < 0) {
+                events.put(traceEvent(event, "i", event.startUs).put("s", "p").put("args", args))
+            } else {
+                events.put(traceEvent(event, "b", event.startUs).put("id", seq).put("args", args))
+                events.put(traceEvent(event, "e", event.startUs + event.durUs).put("id", seq))
+            }
+        }
+        return JSONObject()
+            .put("traceEvents", events)
+            .put("displayTimeUnit", "ms")
+            .put("otherData", JSONObject().put("sdk", "android").put("epoch_ms", epochMs).put("dropped", maxOf(end - Config.TRACE_BUFFER_SIZE, 0)))
+            .toString()
+    }
+
+    private fun traceEvent(event: Event, phase: String, ts: Long): JSONObject =
+        JSONObject()
+            .put("name", event.name)
+            .put("cat", "passgfw")
+            .put("ph", phase)
+            .put("ts", ts)
+            .put("pid", 1)
+            .put("tid", 1)
+}
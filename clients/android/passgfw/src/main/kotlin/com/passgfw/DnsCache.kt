@@ -0,0 +1,293 @@
+package com.passgfw
+
+import android.net.DnsResolver
+import android.os.Build
+import android.os.CancellationSignal
+import okhttp3.Dns
+import org.json.JSONArray
+import org.json.JSONObject
+import java.net.Inet6Address
+import java.net.InetAddress
+import java.net.InetSocketAddress
+import java.net.Socket
+import java.net.URI
+import java.net.UnknownHostException
+import java.util.concurrent.ConcurrentHashMap
+import java.util.concurrent.Semaphore
+import java.util.concurrent.TimeUnit
+import java.util.concurrent.atomic.AtomicInteger
+import java.util.concurrent.atomic.AtomicReference
+import kotlin.concurrent.thread
+
+/**
+ * Caching resolver for OkHttp
+ *
+ * A and AAAA are queried in parallel (android.net.DnsResolver, API 29+;
+ * older releases use the system resolver). Answers are cached for
+ * DNS_CACHE_TTL and persisted, so the first probe after a launch skips
+ * resolution; failures are cached for DNS_NEGATIVE_TTL. An expired answer is
+ * still served when re-resolution fails, for up to DNS_STALE_TTL.
+ *
+ * Addresses are returned interleaved by family (RFC 8305), starting with the
+ * address that won the last connection race (see race()). While an entry's
+ * IP hints are valid (see addHints()), they are returned at once together
+ * with whatever the cache holds, and resolution runs in the background.
+ */
+class DnsCache(private val storage: SecureStorage? = null) : Dns {
+    private companion object {
+        const val STORAGE_KEY = "passgfw.dns_cache"
+        const val MAX_HOSTS = 64
+    }
+
+    private class Entry(
+        val addresses: List<InetAddress>,   // Empty for a cached failure
+        val resolvedAt: Long
+    )
+
+    private class Hint(val addresses: List<InetAddress>, val expiresAt: Long)
+
+    private val entries = ConcurrentHashMap<String, Entry>()
+    private val hints = ConcurrentHashMap<String, Hint>()
+    private val preferred = ConcurrentHashMap<String, InetAddress>()  // Race winners
+    private val raceFailedAt = ConcurrentHashMap<String, Long>()       // Races without a winner
+    private val resolving = ConcurrentHashMap.newKeySet<String>()
+    private val loaded by lazy { load() }
+
+    override fun lookup(hostname: String): List<InetAddress> {
+        if (isAddress(hostname)) return Dns.SYSTEM.lookup(hostname)
+        val addresses = addressesFor(hostname)
+        if (addresses.isEmpty()) throw UnknownHostException("$hostname (cached failure)")
+        val winner = preferred[hostname]?.takeIf { it in addresses } ?: return addresses
+        return listOf(winner) + interleave(addresses.filter { it != winner }, winner !is Inet6Address)
+    }
+
+    /**
+     * Register the IP hints of a URL entry. Only IP literals are accepted, so
+     * a hint never triggers a lookup of its own.
+     */
+    fun addHints(entry: URLEntry) {
+        val addrs = entry.addrs ?: return
+        val expiresAt = entry.addrsExpires * 1000
+        if (addrs.isEmpty() || expiresAt <= System.currentTimeMillis()) return
+        val host = try {
+            URI(entry.url).host
+        } catch (e: Exception) {
+            null
+        } ?: return
+        if (isAddress(host)) return
+        val addresses = addrs.filter { isAddress(it) }.mapNotNull { runCatching { InetAddress.getByName(it) }.getOrNull() }
+        if (addresses.isNotEmpty()) {
+            hints[host] = Hint(addresses, expiresAt)
+        }
+    }
+
+    /**
+     * Race TCP connections to the addresses of host, starting a new attempt
+     * every CONNECTION_ATTEMPT_DELAY or as soon as one fails, and remember the
+     * first to connect. Only runs while a host with several addresses has no
+     * winner, so the extra handshake is paid once per cache entry.
+     *
+     * The race blocks the request, so it gets RACE_BUDGET rather than the
+     * request timeout. A race without a winner is not repeated for
+     * DNS_NEGATIVE_TTL; the request falls back to OkHttp trying the
+     * interleaved addresses in turn.
+     */
+    fun race(host: String, port: Int) {
+        if (isAddress(host)) return
+        val addresses = addressesFor(host)
+        if (addresses.size < 2 || preferred[host] in addresses) return
+        val lost = raceFailedAt[host]
+        if (lost != null && System.currentTimeMillis() - lost < Config.DNS_NEGATIVE_TTL) return
+
+        val winner = AtomicReference<InetAddress?>()
+        val finished = Semaphore(0)
+        val failures = AtomicInteger()
+        val sockets = mutableListOf<Socket>()
+        val deadline = System.currentTimeMillis() + Config.RACE_BUDGET
+        var started = 0
+        for (address in addresses) {
+            val remaining = deadline - System.currentTimeMillis()
+            if (winner.get() != null || remaining <= 0) break
+            val socket = Socket()
+            synchronized(sockets) { sockets += socket }
+            started++
+            thread(isDaemon = true, name = "passgfw-race") {
+                try {
+                    socket.connect(InetSocketAddress(address, port), remaining.toInt())
+                    winner.compareAndSet(null, address)
+                } catch (e: Exception) {
+                    failures.incrementAndGet()
+                }
+                finished.release()
+            }
+            finished.tryAcquire(minOf(Config.CONNECTION_ATTEMPT_DELAY, remaining), TimeUnit.MILLISECONDS)
+        }
+        while (winner.get() == null && failures.get() < started) {
+            val remaining = deadline - System.currentTimeMillis()
+            if (remaining <= 0 || !finished.tryAcquire(remaining, TimeUnit.MILLISECONDS)) break
+        }
+        synchronized(sockets) { sockets.forEach { runCatching { it.close() } } }
+
+        val address = winner.get()
+        if (address == null) {
+            raceFailedAt[host] = System.currentTimeMillis()
+            Logger.debug { "DNS race: $host had no winner within ${Config.RACE_BUDGET}ms" }
+            return
+        }
+        raceFailedAt.remove(host)
+        preferred[host] = address
+        Logger.debug { "DNS race: $host -> ${address.hostAddress} (${addresses.size} addresses)" }
+        save()
+    }
+
+    /**
+     * Forget the race winner after a failed connection, so the next request
+     * races again
+     */
+    fun reportFailure(host: String, address: InetAddress) {
+        preferred.remove(host, address)
+    }
+
+    private fun addressesFor(host: String): List<InetAddress> {
+        loaded
+        val now = System.currentTimeMillis()
+        val cached = entries[host]
+        val fresh = cached?.takeIf {
+            val ttl = if (it.addresses.isEmpty()) Config.DNS_NEGATIVE_TTL else Config.DNS_CACHE_TTL
+            now - it.resolvedAt < ttl
+        }
+        val hint = hints[host]?.takeIf { it.expiresAt > now }
+        if (hint != null) {
+            if (fresh == null) {
+                resolveInBackground(host)
+            }
+            return interleave((hint.addresses + fresh?.addresses.orEmpty()).distinct(), true)
+        }
+        return (fresh ?: refresh(host, cached, now)).addresses
+    }
+
+    private fun resolveInBackground(host: String) {
+        if (!resolving.add(host)) return
+        thread(isDaemon = true, name = "passgfw-dns") {
+            try {
+                refresh(host, entries[host], System.currentTimeMillis())
+            } finally {
+                resolving.remove(host)
+            }
+        }
+    }
+
+    private fun refresh(host: String, cached: Entry?, now: Long): Entry {
+        val addresses = try {
+            resolve(host)
+        } catch (e: Exception) {
+            Logger.debug { "DNS resolution failed for $host: ${e.message}" }
+            emptyList()
+        }
+        if (addresses.isEmpty()) {
+            if (cached != null && cached.addresses.isNotEmpty() && now - cached.resolvedAt < Config.DNS_STALE_TTL) {
+                Logger.debug { "DNS: serving stale answer for $host" }
+                return cached
+            }
+            return Entry(emptyList(), now).also { entries[host] = it }
+        }
+
+        val entry = Entry(addresses, now)
+        entries[host] = entry
+        save()
+        return entry
+    }
+
+    private fun resolve(host: String): List<InetAddress> {
+        if (Build.VERSION.SDK_INT < Build.VERSION_CODES.Q) {
+            val all = InetAddress.getAllByName(host).toList()
+            return interleave(all, true)
+        }
+
+        val v6 = AtomicReference<List<InetAddress>?>()
+        val v4 = AtomicReference<List<InetAddress>?>()
+        val answered = Semaphore(0)
+        val cancel = CancellationSignal()
+        fun query(type: Int, into: AtomicReference<List<InetAddress>?>) {
+            DnsResolver.getInstance().query(
+                null, host, type, DnsResolver.FLAG_EMPTY, Runnable::run, cancel,
+                object : DnsResolver.Callback<List<InetAddress>> {
+                    override fun onAnswer(answer: List<InetAddress>, rcode: Int) {
+                        into.set(answer)
+                        answered.release()
+                    }
+
+                    override fun onError(error: DnsResolver.DnsException) {
+                        into.set(emptyList())
+                        answered.release()
+                    }
+                }
+            )
+        }
+        query(DnsResolver.TYPE_AAAA, v6)
+        query(DnsResolver.TYPE_A, v4)
+
+        // Once one family has addresses the other gets DNS_RESOLUTION_DELAY
+        // (RFC 8305 section 3), so a broken AAAA path costs 50ms, not a timeout
+        val deadline = System.currentTimeMillis() + Config.DNS_TIMEOUT
+        for (i in 0 until 2) {
+            val haveAddresses = !v6.get().isNullOrEmpty() || !v4.get().isNullOrEmpty()
+            var wait = deadline - System.currentTimeMillis()
+            if (haveAddresses) wait = minOf(wait, Config.DNS_RESOLUTION_DELAY)
+            if (wait <= 0 || !answered.tryAcquire(wait, TimeUnit.MILLISECONDS)) break
+        }
+        cancel.cancel()
+        return interleave(v6.get().orEmpty() + v4.get().orEmpty(), true)
+    }
+
+    /**
+     * Alternate address families, starting with IPv6 when preferV6
+     */
+    private fun interleave(addresses: List<InetAddress>, preferV6: Boolean): List<InetAddress> {
+        val (v6, v4) = addresses.partition { it is Inet6Address }
+        val (first, second) = if (preferV6) v6 to v4 else v4 to v6
+        val out = ArrayList<InetAddress>(addresses.size)
+        for (i in 0 until maxOf(first.size, second.size)) {
+            first.getOrNull(i)?.let { out += it }
+            second.getOrNull(i)?.let { out += it }
+        }
+        return out
+    }
+
+    private fun isAddress(host: String): Boolean =
+        host.contains(':') || host.all { it.isDigit() || it == '.' }
+
+    private fun load() {
+        val json = storage?.load(STORAGE_KEY) ?: return
+        try {
+            val obj = JSONObject(json)
+            for (host in obj.keys()) {
+                val item = obj.getJSONObject(host)
+                val ips = item.getJSONArray("a")
+                val addresses = (0 until ips.length()).map { InetAddress.getByName(ips.getString(it)) }
+                entries.putIfAbsent(host, Entry(addresses, item.getLong("t")))
+                item.optString("p").takeIf { it.isNotEmpty() }?.let { preferred.putIfAbsent(host, InetAddress.getByName(it)) }
+            }
+            Logger.debug { "DNS cache loaded: ${entries.size} hosts" }
+        } catch (e: Exception) {
+            Logger.warning { "Failed to load DNS cache: ${e.message}" }
+        }
+    }
+
+    private fun save() {
+        val storage = storage ?: return
+        val obj = JSONObject()
+        entries.entries
+            .filter { it.value.addresses.isNotEmpty() }
+            .sortedByDescending { it.value.resolvedAt }
+            .take(MAX_HOSTS)
+            .forEach { (host, entry) ->
+                obj.put(host, JSONObject().apply {
+                    put("a", JSONArray(entry.addresses.map { it.hostAddress }))
+                    put("t", entry.resolvedAt)
+                    preferred[host]?.let { put("p", it.hostAddress) }
+                })
+            }
+        storage.save(obj.toString(), STORAGE_KEY)
+    }
+}
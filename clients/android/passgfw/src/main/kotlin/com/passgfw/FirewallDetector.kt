@@ -4,22 +4,70 @@ import android.content.Context
 import android.content.Intent
 import android.net.Uri
 import android.util.Base64
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.coroutineScope
 import kotlinx.coroutines.delay
+import kotlinx.coroutines.flow.Flow
+import kotlinx.coroutines.flow.channelFlow
+import kotlinx.coroutines.flow.flowOn
+import kotlinx.coroutines.launch
+import kotlinx.coroutines.runInterruptible
+import kotlinx.coroutines.sync.Semaphore
+import kotlinx.coroutines.sync.withPermit
+import kotlinx.coroutines.withContext
 import org.json.JSONArray
 import org.json.JSONObject
+import java.util.Collections
+
+/**
+ * A verified answer from one API URL
+ * @param latencyMs Time from sending the probe to a verified answer
+ */
+data class DetectionResult(
+    val url: String,
+    val latencyMs: Double,
+    val data: Map<String, Any>
+)
+
+/**
+ * An encrypted probe payload and the nonce the response must echo
+ */
+internal class PreparedPayload(val nonce: ByteArray, val encrypted: ByteArray, val probeId: String)
+
+private class VerifiedResponse(val data: Map<String, Any>, val urls: JSONArray?)
 
 /**
  * Firewall Detector - Core detection logic
  */
 class FirewallDetector(private val context: Context) {
-    private val networkClient = NetworkClient()
+    private companion object {
+        const val CLIENT_ID_KEY = "passgfw.client_id"
+    }
+
+    private val storage = EncryptedStorage(context)
+    private val dnsCache = if (Config.DNS_CACHE) DnsCache(storage) else null
+    private val networkClient = NetworkClient(dns = dnsCache)
     private val cryptoHelper = CryptoHelper()
+    private val budget = DataBudget(context)
+    private val sharedAnswer = if (Config.SHARED_ANSWER) openSharedAnswer() else null
     private val urlManager: URLManager
 
+    // 稳定的安装标识，服务器据此把客户端固定到同一后端
+    private val clientId: String by lazy { loadOrCreateClientId() }
+
     // 缓存最后成功的结果
     private var cachedResult: Map<String, Any>? = null
+    // 得到缓存结果的顶层 URL，重新检测时最先尝试
+    private var cachedURL: String? = null
+    // 已采用的跨进程共享结果版本
+    @Volatile
+    private var sharedVersion = 0L
     private var lastError: String? = null
 
+    // 最近一次 API 探测的耗时拆分
+    @Volatile
+    private var lastProbeTiming: ProbeTiming? = null
+
     init {
         // Set public key
         val publicKey = Config.getPublicKey()
@@ -43,32 +91,73 @@ class FirewallDetector(private val context: Context) {
      * @return Map containing server response data, or null if all attempts fail
      */
     suspend fun getDomains(retry: Boolean, customData: String?): Map<String, Any>? {
-        // If not retry and cache exists, return cache
-        if (!retry && cachedResult != null) {
-            Logger.info("Returning cached result")
-            return cachedResult
+        // Another process may have published a newer answer
+        if (!retry) {
+            sharedAnswer?.read()?.takeIf { it.version > sharedVersion }?.let { adopt(it) }
+        }
+
+        // If not retry and cache exists, return cache while its domain is reachable
+        val cached = cachedResult
+        if (!retry && cached != null) {
+            val start = DiagnosticTrace.now()
+            val reachable = isReachable(cached)
+            DiagnosticTrace.span("revalidate", start, mapOf("domain" to cached["domain"], "ok" to reachable))
+            if (reachable) {
+                Logger.info("Returning cached result")
+                return cached
+            }
+            Logger.warning("Cached domain unreachable, re-detecting")
         }
 
         // Perform detection
-        Logger.info("Starting detection (retry=$retry)")
+        Logger.info { "Starting detection (retry=$retry)" }
 
-        // Infinite retry loop until success
-        while (true) {
-            val urls = urlManager.getURLs()
-            Logger.debug("Checking ${urls.size} URLs")
+        // One process detects at a time; the others take its answer
+        val shared = sharedAnswer ?: return detect(customData)
+        awaitLeadOrAnswer(shared)?.let { return it }
+        try {
+            return detect(customData)
+        } finally {
+            resign(shared)
+        }
+    }
 
-            val result = checkURLsSequentially(urls, customData, 0)
+    /**
+     * Infinite retry loop until success
+     */
+    private suspend fun detect(customData: String?): Map<String, Any> {
+        var round = 0
+        while (true) {
+            val urls = cachedURLFirst(urlManager.getURLs())
+            Logger.debug { "Checking ${urls.size} URLs" }
+
+            val start = DiagnosticTrace.now()
+            val result = coroutineScope {
+                val payloads = PayloadPipeline(this) { preparePayload(customData) }
+                try {
+                    checkURLsSequentially(urls, payloads, 0)
+                } finally {
+                    payloads.close()
+                }
+            }
+            DiagnosticTrace.span("detect", start, mapOf("round" to ++round, "urls" to urls.size, "ok" to (result != null)))
             if (result != null) {
-                // Success - cache and return
+                // Success - cache, share with the other processes and return
                 cachedResult = result
+                sharedAnswer?.publish(result, cachedURL)?.let { sharedVersion = it }
                 Logger.info("Detection succeeded")
                 return result
             }
 
-            // All failed, wait and retry
+            // All failed, wait and retry, slower as the data budget runs out
             lastError = "All URLs failed, retrying..."
             Logger.warning(lastError!!)
-            delay(Config.RETRY_INTERVAL)
+            val wait = budget.retryDelay()
+            if (wait > Config.RETRY_INTERVAL) {
+                Logger.info { "Data budget low, next round in ${wait / 1000}s" }
+                DiagnosticTrace.instant("budget", mapOf("wait_ms" to wait))
+            }
+            delay(wait)
         }
     }
 
@@ -77,22 +166,140 @@ class FirewallDetector(private val context: Context) {
      */
     fun getLastError(): String? = lastError
 
+    /**
+     * Get detection data usage and the limits that apply now
+     */
+    fun getBudgetState(): BudgetState = budget.state()
+
+    /**
+     * Get timing of the most recent API probe
+     */
+    fun getLastProbeTiming(): ProbeTiming? = lastProbeTiming
+
+    /**
+     * Probe every URL once and emit each verified answer as its probe
+     * completes, so answers arrive roughly fastest first. File lists are
+     * expanded as they load, with at most CONCURRENT_CHECK_COUNT requests in
+     * flight. Navigate entries are skipped and remove entries applied.
+     */
+    fun results(customData: String?): Flow<DetectionResult> = channelFlow {
+        val slots = Semaphore(Config.CONCURRENT_CHECK_COUNT)
+        val payloads = PayloadPipeline(this) { preparePayload(customData) }
+        val seen = Collections.synchronizedSet(mutableSetOf<String>())
+
+        fun walk(entries: List<URLEntry>, recursionDepth: Int) {
+            for (entry in entries) {
+                if (entry.method != "remove" && !seen.add("${entry.method} ${entry.url}")) continue
+                when (entry.method) {
+                    "api" -> launch {
+                        val result = slots.withPermit {
+                            dnsCache?.addHints(entry)
+                            val start = System.nanoTime()
+                            checkAPIMethod(entry, payloads)?.let {
+                                DetectionResult(entry.url, (System.nanoTime() - start) / 1_000_000.0, it)
+                            }
+                        }
+                        if (result != null) send(result)
+                    }
+                    "file" -> if (recursionDepth < Config.MAX_LIST_RECURSION_DEPTH) {
+                        launch {
+                            val nested = slots.withPermit {
+                                dnsCache?.addHints(entry)
+                                loadFileList(entry)
+                            }
+                            if (nested != null) walk(nested, recursionDepth + 1)
+                        }
+                    }
+                    "remove" -> handleRemoveMethod(entry)
+                    else -> Logger.debug { "Skipping ${entry.method} entry: ${entry.url}" }
+                }
+            }
+        }
+
+        walk(urlManager.getURLs(), 0)
+    }.flowOn(Dispatchers.IO)
+
     // MARK: - Private Methods
 
+    private fun openSharedAnswer(): SharedAnswer? = try {
+        SharedAnswer.open(context)
+    } catch (e: Exception) {
+        Logger.warning { "Shared answer unavailable, detecting per process: ${e.message}" }
+        null
+    }
+
+    /**
+     * Wait until this caller leads detection (returns null) or the leader
+     * publishes an answer newer than the one current at the call (returns it).
+     * Callers in this process, across detectors, queue on the shared
+     * instance's turns, then one of them blocks on the cross-process lock on
+     * an IO thread; the leader publishes before it resigns, so the answer is
+     * there once the lock is free.
+     */
+    private suspend fun awaitLeadOrAnswer(shared: SharedAnswer): Map<String, Any>? {
+        val since = shared.read()?.version ?: 0
+        shared.turns.lock()
+        try {
+            runInterruptible(Dispatchers.IO) { shared.lead() }
+        } catch (e: Throwable) {
+            shared.turns.unlock()
+            throw e
+        }
+        val answer = shared.read()?.takeIf { it.version > since } ?: return null
+        resign(shared)
+        Logger.info("Using answer of the running detection")
+        return adopt(answer)
+    }
+
+    private fun resign(shared: SharedAnswer) {
+        shared.resign()
+        shared.turns.unlock()
+    }
+
+    private fun adopt(answer: SharedAnswer.Answer): Map<String, Any> {
+        val result = jsonObjectToMap(answer.result)
+        cachedResult = result
+        cachedURL = answer.url
+        sharedVersion = answer.version
+        return result
+    }
+
+    /**
+     * Cheap liveness check of a cached answer: a TCP connect to its domain
+     * within REVALIDATE_TIMEOUT. Answers without a domain are trusted.
+     */
+    private fun isReachable(cached: Map<String, Any>): Boolean {
+        if (!Config.REVALIDATE_CACHE) return true
+        val domain = cached["domain"] as? String ?: return true
+        return networkClient.canConnect(domain, Config.REVALIDATE_TIMEOUT)
+    }
+
+    /**
+     * Move the URL that produced the cached answer to the front
+     */
+    private fun cachedURLFirst(urls: List<URLEntry>): List<URLEntry> {
+        val index = urls.indexOfFirst { it.url == cachedURL }
+        if (index <= 0) return urls
+        return listOf(urls[index]) + urls.filterIndexed { i, _ -> i != index }
+    }
+
     /**
      * Check URLs sequentially
      */
     private suspend fun checkURLsSequentially(
         entries: List<URLEntry>,
-        customData: String?,
+        payloads: PayloadPipeline<PreparedPayload>,
         recursionDepth: Int
     ): Map<String, Any>? {
         for (entry in entries) {
-            Logger.debug("Checking URL: ${entry.url} (method: ${entry.method}, depth: $recursionDepth)")
+            Logger.debug { "Checking URL: ${entry.url} (method: ${entry.method}, depth: $recursionDepth)" }
 
-            val result = checkURLEntry(entry, customData, recursionDepth)
+            val result = checkURLEntry(entry, payloads, recursionDepth)
             if (result != null) {
                 Logger.info("Found available server")
+                if (recursionDepth == 0) {
+                    cachedURL = entry.url
+                }
                 return result
             }
 
@@ -107,12 +314,13 @@ class FirewallDetector(private val context: Context) {
      */
     private suspend fun checkURLEntry(
         entry: URLEntry,
-        customData: String?,
+        payloads: PayloadPipeline<PreparedPayload>,
         recursionDepth: Int
     ): Map<String, Any>? {
+        dnsCache?.addHints(entry)
         return when (entry.method) {
-            "api" -> checkAPIMethod(entry, customData)
-            "file" -> checkFileMethod(entry, customData, recursionDepth)
+            "api" -> checkAPIMethod(entry, payloads)
+            "file" -> checkFileMethod(entry, payloads, recursionDepth)
             "navigate" -> {
                 handleNavigateMethod(entry)
                 // Navigate 执行后算成功，返回表示已引导用户
@@ -124,7 +332,7 @@ class FirewallDetector(private val context: Context) {
                 null
             }
             else -> {
-                Logger.warning("Unknown method: ${entry.method}")
+                Logger.warning { "Unknown method: ${entry.method}" }
                 null
             }
         }
@@ -133,7 +341,18 @@ class FirewallDetector(private val context: Context) {
     /**
      * Check API method
      */
-    private suspend fun checkAPIMethod(entry: URLEntry, customData: String?): Map<String, Any>? {
+    private suspend fun checkAPIMethod(entry: URLEntry, payloads: PayloadPipeline<PreparedPayload>): Map<String, Any>? {
+        val start = DiagnosticTrace.now()
+        val result = probeAPI(entry, payloads)
+        DiagnosticTrace.span("api", start, mapOf("url" to entry.url, "ok" to (result != null)))
+        return result
+    }
+
+    /**
+     * Build and encrypt a probe payload with a fresh nonce; runs ahead of the
+     * probe that uses it (see PayloadPipeline)
+     */
+    private fun preparePayload(customData: String?): PreparedPayload? {
         // Generate random nonce
         val nonceData = cryptoHelper.generateRandom(Config.NONCE_SIZE)
         val randomBase64 = Base64.encodeToString(nonceData, Base64.NO_WRAP)
@@ -149,6 +368,7 @@ class FirewallDetector(private val context: Context) {
             put("os", "android")
             put("app", context.packageName)
             put("data", customData ?: clientData.toString())
+            put("cid", clientId)
         }
 
         val payloadBytes = payload.toString().toByteArray()
@@ -160,19 +380,71 @@ class FirewallDetector(private val context: Context) {
             return null
         }
 
+        // Tag the request with a probe ID the server echoes back
+        val probeId = cryptoHelper.generateRandom(Config.PROBE_ID_SIZE)
+            .joinToString("") { "%02x".format(it) }
+        return PreparedPayload(nonceData, encryptedData, probeId)
+    }
+
+    private suspend fun probeAPI(entry: URLEntry, payloads: PayloadPipeline<PreparedPayload>): Map<String, Any>? {
+        val prepared = payloads.take() ?: return null
+        val probeId = prepared.probeId
+
         // Send request
-        val response = networkClient.postBytes(entry.url, encryptedData)
+        val requestStart = DiagnosticTrace.now()
+        val sent = budget.now()
+        val response = networkClient.postBytes(entry.url, prepared.encrypted, probeId)
+        budget.record(sent, (prepared.encrypted.size + response.body.length).toLong())
+        DiagnosticTrace.span("request", requestStart, mapOf(
+            "url" to entry.url,
+            "probe_id" to probeId,
+            "status" to response.statusCode,
+            "server_ms" to response.timing?.serverMs
+        ))
+
+        response.timing?.let { timing ->
+            lastProbeTiming = timing
+            Logger.debug {
+                "Probe ${timing.probeId}: total=${"%.1f".format(timing.totalMs)}ms " +
+                    "server=${timing.serverMs?.let { "%.1f".format(it) } ?: "-"}ms " +
+                    "network=${timing.networkMs?.let { "%.1f".format(it) } ?: "-"}ms"
+            }
+        }
 
         if (!response.success) {
-            Logger.warning("API request failed: ${response.error}")
+            Logger.warning { "API request failed: ${response.error}" }
             return null
         }
 
+        // Verify on the CPU pool, off the I/O threads waiting on other probes
+        val verified = withContext(Dispatchers.Default) {
+            verifyResponse(response.body, prepared.nonce)
+        } ?: return null
+
+        Logger.info { "API check succeeded for ${entry.url}" }
+
+        // Handle store flag
+        if (entry.store) {
+            urlManager.addURL(entry)
+            Logger.debug { "Store URL ${entry.url}" }
+        }
+
+        // Handle dynamic URLs from response
+        verified.urls?.let { handleDynamicURLs(it) }
+
+        // Return parsed data
+        return verified.data
+    }
+
+    /**
+     * Check the nonce and signature of an API response and parse its data
+     */
+    private fun verifyResponse(body: String, nonceData: ByteArray): VerifiedResponse? {
         // Parse response
         val responseJSON = try {
-            JSONObject(response.body)
+            JSONObject(body)
         } catch (e: Exception) {
-            Logger.error("Failed to parse response JSON: ${e.message}")
+            Logger.error { "Failed to parse response JSON: ${e.message}" }
             return null
         }
 
@@ -217,31 +489,18 @@ class FirewallDetector(private val context: Context) {
             return null
         }
 
-        Logger.info("API check succeeded for ${entry.url}")
-
         // Parse data JSON
         val parsedData = try {
             val dataString = String(dataBytes)
             val dataObj = JSONObject(dataString)
             jsonObjectToMap(dataObj)
         } catch (e: Exception) {
-            Logger.error("Failed to parse data JSON: ${e.message}")
+            Logger.error { "Failed to parse data JSON: ${e.message}" }
             return null
         }
 
-        // Handle store flag
-        if (entry.store) {
-            urlManager.addURL(entry)
-            Logger.debug("Store URL ${entry.url}")
-        }
-
-        // Handle dynamic URLs from response
-        if (responseJSON.has("urls")) {
-            handleDynamicURLs(responseJSON.getJSONArray("urls"))
-        }
-
-        // Return parsed data
-        return parsedData
+        val urls = if (responseJSON.has("urls")) responseJSON.getJSONArray("urls") else null
+        return VerifiedResponse(parsedData, urls)
     }
 
     /**
@@ -249,7 +508,7 @@ class FirewallDetector(private val context: Context) {
      */
     private suspend fun checkFileMethod(
         entry: URLEntry,
-        customData: String?,
+        payloads: PayloadPipeline<PreparedPayload>,
         recursionDepth: Int
     ): Map<String, Any>? {
         // Check recursion depth
@@ -258,11 +517,25 @@ class FirewallDetector(private val context: Context) {
             return null
         }
 
+        val urls = loadFileList(entry) ?: return null
+
+        // Check nested URLs
+        return checkURLsSequentially(urls, payloads, recursionDepth + 1)
+    }
+
+    /**
+     * Fetch and parse a file list, storing its URL when requested
+     */
+    private fun loadFileList(entry: URLEntry): List<URLEntry>? {
         // Fetch file
+        val start = DiagnosticTrace.now()
+        val sent = budget.now()
         val response = networkClient.get(entry.url)
+        budget.record(sent, response.body.length.toLong())
+        DiagnosticTrace.span("file", start, mapOf("url" to entry.url, "status" to response.statusCode))
 
         if (!response.success) {
-            Logger.warning("File request failed: ${response.error}")
+            Logger.warning { "File request failed: ${response.error}" }
             return null
         }
 
@@ -273,29 +546,27 @@ class FirewallDetector(private val context: Context) {
             return null
         }
 
-        Logger.info("File method: loaded ${urls.size} URLs from ${entry.url}")
+        Logger.info { "File method: loaded ${urls.size} URLs from ${entry.url}" }
 
         // Handle store flag
         if (entry.store) {
             urlManager.addURL(entry)
-            Logger.debug("Store file URL ${entry.url}")
+            Logger.debug { "Store file URL ${entry.url}" }
         }
-
-        // Check nested URLs
-        return checkURLsSequentially(urls, customData, recursionDepth + 1)
+        return urls
     }
 
     /**
      * Handle navigate method
      */
     private fun handleNavigateMethod(entry: URLEntry) {
-        Logger.info("Navigate method: opening ${entry.url}")
+        Logger.info { "Navigate method: opening ${entry.url}" }
         try {
             val intent = Intent(Intent.ACTION_VIEW, Uri.parse(entry.url))
             intent.flags = Intent.FLAG_ACTIVITY_NEW_TASK
             context.startActivity(intent)
         } catch (e: Exception) {
-            Logger.error("Failed to open URL: ${e.message}")
+            Logger.error { "Failed to open URL: ${e.message}" }
         }
     }
 
@@ -303,9 +574,9 @@ class FirewallDetector(private val context: Context) {
      * Handle remove method
      */
     private fun handleRemoveMethod(entry: URLEntry) {
-        Logger.info("Remove method: removing ${entry.url}")
+        Logger.info { "Remove method: removing ${entry.url}" }
         urlManager.removeURL(entry.url)
-        Logger.debug("Remove URL ${entry.url}")
+        Logger.debug { "Remove URL ${entry.url}" }
     }
 
     /**
@@ -320,25 +591,41 @@ class FirewallDetector(private val context: Context) {
             if (method.isEmpty() || url.isEmpty()) continue
 
             val store = urlObj.optBoolean("store", false)
-            val entry = URLEntry(method, url, store)
+            val entry = URLEntry(method, url, store, parseAddrs(urlObj), urlObj.optLong("addrs_expires", 0))
 
             when (method) {
                 "remove" -> {
                     urlManager.removeURL(url)
-                    Logger.debug("Dynamic remove: $url")
+                    Logger.debug { "Dynamic remove: $url" }
                 }
                 "api", "file" -> {
                     if (store) {
                         urlManager.addURL(entry)
-                        Logger.debug("Dynamic store: $url")
+                        Logger.debug { "Dynamic store: $url" }
                     }
                 }
                 "navigate" -> handleNavigateMethod(entry)
-                else -> Logger.warning("Unknown dynamic method: $method")
+                else -> Logger.warning { "Unknown dynamic method: $method" }
             }
         }
     }
 
+    /**
+     * Load the persisted client ID, generating one on first use
+     */
+    private fun loadOrCreateClientId(): String {
+        storage.load(CLIENT_ID_KEY)?.let { return it }
+
+        val id = Base64.encodeToString(
+            cryptoHelper.generateRandom(Config.CLIENT_ID_SIZE),
+            Base64.URL_SAFE or Base64.NO_WRAP or Base64.NO_PADDING
+        )
+        if (!storage.save(id, CLIENT_ID_KEY)) {
+            Logger.warning("Failed to persist client ID")
+        }
+        return id
+    }
+
     /**
      * Parse URL list from text
      */
@@ -419,12 +706,20 @@ class FirewallDetector(private val context: Context) {
             val url = obj.optString("url")
             if (method.isNotEmpty() && url.isNotEmpty()) {
                 val store = obj.optBoolean("store", false)
-                entries.add(URLEntry(method, url, store))
+                entries.add(URLEntry(method, url, store, parseAddrs(obj), obj.optLong("addrs_expires", 0)))
             }
         }
         return entries
     }
 
+    /**
+     * Parse the optional IP hints of a URL entry
+     */
+    private fun parseAddrs(obj: JSONObject): List<String>? {
+        val addrs = obj.optJSONArray("addrs") ?: return null
+        return (0 until addrs.length()).map { addrs.optString(it) }.filter { it.isNotEmpty() }
+    }
+
     /**
      * Convert JSONObject to Map
      */
@@ -14,12 +14,34 @@ enum class LogLevel(val value: Int) {
 
 /**
  * Logger for PassGFW
+ *
+ * The lambda overloads build their message only when the level is logged
+ * (or, for warnings and errors, traced); being inline, they allocate nothing
+ * when it is not. Use them for any message that interpolates.
  */
 object Logger {
     private const val TAG = "PassGFW"
     
     var isEnabled = true
     var minLevel = LogLevel.DEBUG
+
+    fun isLoggable(level: LogLevel): Boolean = isEnabled && level >= minLevel
+
+    inline fun debug(message: () -> String) {
+        if (isLoggable(LogLevel.DEBUG)) log(message(), LogLevel.DEBUG)
+    }
+
+    inline fun info(message: () -> String) {
+        if (isLoggable(LogLevel.INFO)) log(message(), LogLevel.INFO)
+    }
+
+    inline fun warning(message: () -> String) {
+        if (isLoggable(LogLevel.WARNING) || DiagnosticTrace.ENABLED) log(message(), LogLevel.WARNING)
+    }
+
+    inline fun error(message: () -> String) {
+        if (isLoggable(LogLevel.ERROR) || DiagnosticTrace.ENABLED) log(message(), LogLevel.ERROR)
+    }
     
     fun debug(message: String) {
         log(message, LogLevel.DEBUG)
@@ -37,8 +59,13 @@ object Logger {
         log(message, LogLevel.ERROR)
     }
     
-    private fun log(message: String, level: LogLevel) {
-        if (!isEnabled || level < minLevel) return
+    @PublishedApi
+    internal fun log(message: String, level: LogLevel) {
+        // Warnings and errors are the failure reasons of a diagnostic trace
+        if (level >= LogLevel.WARNING) {
+            DiagnosticTrace.instant(level.name.lowercase(), mapOf("message" to message))
+        }
+        if (!isLoggable(level)) return
         
         when (level) {
             LogLevel.DEBUG -> Log.d(TAG, message)
@@ -1,10 +1,26 @@
 package com.passgfw
 
+import okhttp3.Call
+import okhttp3.Dns
+import okhttp3.EventListener
 import okhttp3.MediaType.Companion.toMediaType
 import okhttp3.OkHttpClient
+import okhttp3.Protocol
 import okhttp3.Request
 import okhttp3.RequestBody.Companion.toRequestBody
+import java.io.IOException
+import java.net.InetAddress
+import java.net.InetSocketAddress
+import java.net.Proxy
+import java.net.Socket
+import java.net.URI
+import java.util.concurrent.CountDownLatch
+import java.util.concurrent.Semaphore
 import java.util.concurrent.TimeUnit
+import java.util.concurrent.atomic.AtomicBoolean
+import java.util.concurrent.atomic.AtomicInteger
+import java.util.concurrent.atomic.AtomicReference
+import kotlin.concurrent.thread
 
 /**
  * HTTP Response
@@ -13,40 +29,207 @@ data class HTTPResponse(
     val success: Boolean,
     val statusCode: Int,
     val body: String,
-    val error: String?
+    val error: String?,
+    val timing: ProbeTiming? = null
 )
 
+/**
+ * Probe timing: client-observed latency split into server and network time
+ * using the server's Server-Timing header
+ */
+data class ProbeTiming(
+    val url: String,
+    val probeId: String,
+    val totalMs: Double,
+    val serverStages: Map<String, Double>
+) {
+    /** Server-side time, or null when the server sent no Server-Timing */
+    val serverMs: Double?
+        get() = serverStages["total"]
+
+    /** Client-observed time not spent in the server */
+    val networkMs: Double?
+        get() = serverMs?.let { (totalMs - it).coerceAtLeast(0.0) }
+
+    companion object {
+        /**
+         * Parse a Server-Timing header value ("decrypt;dur=1.2, sign;dur=0.8")
+         */
+        fun parseServerTiming(header: String?): Map<String, Double> {
+            if (header.isNullOrEmpty()) return emptyMap()
+            val stages = mutableMapOf<String, Double>()
+            for (metric in header.split(",")) {
+                val parts = metric.split(";").map { it.trim() }
+                val name = parts.firstOrNull()?.takeIf { it.isNotEmpty() } ?: continue
+                val dur = parts.drop(1)
+                    .firstOrNull { it.startsWith("dur=") }
+                    ?.substring(4)?.toDoubleOrNull() ?: continue
+                stages[name] = dur
+            }
+            return stages
+        }
+    }
+}
+
 /**
  * Network Client for HTTP requests
+ * @param dns Optional resolver cache; each request first races its host's addresses
  */
-class NetworkClient(private val timeout: Long = Config.REQUEST_TIMEOUT) {
+class NetworkClient(
+    private val timeout: Long = Config.REQUEST_TIMEOUT,
+    private val dns: DnsCache? = null
+) {
     private val client = OkHttpClient.Builder()
         .connectTimeout(timeout, TimeUnit.MILLISECONDS)
         .readTimeout(timeout, TimeUnit.MILLISECONDS)
         .writeTimeout(timeout, TimeUnit.MILLISECONDS)
+        .apply { if (Config.TCP_FAST_OPEN) socketFactory(FastOpenSocketFactory) }
+        .addInterceptor { chain ->
+            // Runs first, so URLs on an open host cost neither a race nor a timeout
+            val host = chain.request().url.host
+            if (!CircuitBreaker.allow(host)) {
+                throw IOException("Circuit open for $host")
+            }
+            val response = try {
+                chain.proceed(chain.request())
+            } catch (e: Exception) {
+                CircuitBreaker.recordFailure(host)
+                throw e
+            }
+            CircuitBreaker.recordSuccess(host)
+            response
+        }
+        .apply {
+            val cache = dns ?: return@apply
+            dns(cache)
+            addInterceptor { chain ->
+                val url = chain.request().url
+                cache.race(url.host, url.port)
+                chain.proceed(chain.request())
+            }
+            eventListener(object : EventListener() {
+                override fun connectFailed(
+                    call: Call, inetSocketAddress: InetSocketAddress, proxy: Proxy,
+                    protocol: Protocol?, ioe: IOException
+                ) {
+                    cache.reportFailure(call.request().url.host, inetSocketAddress.address)
+                }
+            })
+        }
         .build()
 
+    /**
+     * Whether a TCP connection to a domain ("host", "host:port" or a URL;
+     * port 443 by default) succeeds within timeoutMs, resolution included
+     */
+    fun canConnect(domain: String, timeoutMs: Long): Boolean {
+        val deadline = System.currentTimeMillis() + timeoutMs
+        return try {
+            val uri = URI(if ("://" in domain) domain else "//$domain")
+            val host = uri.host?.removeSurrounding("[", "]") ?: return false
+            val port = if (uri.port > 0) uri.port else if (uri.scheme == "http") 80 else 443
+            val addresses = lookupBefore(host, deadline) ?: return false
+            connectAny(addresses, port, deadline)
+        } catch (e: Exception) {
+            Logger.debug { "Connect check for $domain failed: ${e.message}" }
+            false
+        }
+    }
+
+    /**
+     * Resolve host on a helper thread, giving up at deadline; a resolver
+     * stuck on a poisoned name then costs no more than the check's budget
+     */
+    private fun lookupBefore(host: String, deadline: Long): List<InetAddress>? {
+        val result = AtomicReference<List<InetAddress>>()
+        val done = CountDownLatch(1)
+        thread(isDaemon = true, name = "passgfw-lookup") {
+            try {
+                result.set((dns ?: Dns.SYSTEM).lookup(host))
+            } catch (e: Exception) {
+                Logger.debug { "Lookup of $host failed: ${e.message}" }
+            }
+            done.countDown()
+        }
+        val remaining = deadline - System.currentTimeMillis()
+        if (remaining <= 0 || !done.await(remaining, TimeUnit.MILLISECONDS)) {
+            Logger.debug { "Lookup of $host did not finish before the deadline" }
+            return null
+        }
+        return result.get()
+    }
+
+    /**
+     * Race connections to addresses, starting the next every
+     * CONNECTION_ATTEMPT_DELAY or as soon as one fails, until one connects
+     * or deadline passes
+     */
+    private fun connectAny(addresses: List<InetAddress>, port: Int, deadline: Long): Boolean {
+        val connected = AtomicBoolean()
+        val finished = Semaphore(0)
+        val failures = AtomicInteger()
+        val sockets = mutableListOf<Socket>()
+        var started = 0
+        try {
+            for (address in addresses) {
+                val remaining = deadline - System.currentTimeMillis()
+                if (connected.get() || remaining <= 0) break
+                val socket = Socket()
+                synchronized(sockets) { sockets += socket }
+                started++
+                thread(isDaemon = true, name = "passgfw-connect") {
+                    try {
+                        socket.connect(InetSocketAddress(address, port), remaining.toInt())
+                        connected.set(true)
+                    } catch (e: IOException) {
+                        failures.incrementAndGet()
+                        Logger.debug { "Connect to ${address.hostAddress}:$port failed: ${e.message}" }
+                    }
+                    finished.release()
+                }
+                finished.tryAcquire(minOf(Config.CONNECTION_ATTEMPT_DELAY, remaining), TimeUnit.MILLISECONDS)
+            }
+            while (!connected.get() && failures.get() < started) {
+                val remaining = deadline - System.currentTimeMillis()
+                if (remaining <= 0 || !finished.tryAcquire(remaining, TimeUnit.MILLISECONDS)) break
+            }
+            return connected.get()
+        } finally {
+            synchronized(sockets) { sockets.forEach { runCatching { it.close() } } }
+        }
+    }
+
     private val jsonMediaType = "application/json; charset=utf-8".toMediaType()
     private val octetStreamMediaType = "application/octet-stream".toMediaType()
 
     /**
      * POST request with raw binary data
+     * @param probeId Optional probe ID, echoed by the server for correlation
      */
-    fun postBytes(url: String, body: ByteArray): HTTPResponse {
+    fun postBytes(url: String, body: ByteArray, probeId: String? = null): HTTPResponse {
         return try {
-            val request = Request.Builder()
+            val builder = Request.Builder()
                 .url(url)
                 .post(body.toRequestBody(octetStreamMediaType))
                 .addHeader("Content-Type", "application/octet-stream")
                 .addHeader("User-Agent", "PassGFW/2.2 Kotlin")
-                .build()
+            if (probeId != null) {
+                builder.addHeader(Config.PROBE_ID_HEADER, probeId)
+            }
+            val request = builder.build()
 
+            val start = System.nanoTime()
             client.newCall(request).execute().use { response ->
+                val responseBody = response.body?.string() ?: ""
+                val totalMs = (System.nanoTime() - start) / 1_000_000.0
                 HTTPResponse(
                     success = response.isSuccessful,
                     statusCode = response.code,
-                    body = response.body?.string() ?: "",
-                    error = if (response.isSuccessful) null else "HTTP ${response.code}"
+                    body = responseBody,
+                    error = if (response.isSuccessful) null else "HTTP ${response.code}",
+                    timing = probeId?.let {
+                        ProbeTiming(url, it, totalMs, ProbeTiming.parseServerTiming(response.header("Server-Timing")))
+                    }
                 )
             }
         } catch (e: Exception) {
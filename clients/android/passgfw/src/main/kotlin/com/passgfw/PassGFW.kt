@@ -2,7 +2,12 @@ package com.passgfw
 
 import android.content.Context
 import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.flow.Flow
+import kotlinx.coroutines.flow.firstOrNull
+import kotlinx.coroutines.flow.take
+import kotlinx.coroutines.flow.toList
 import kotlinx.coroutines.withContext
+import kotlinx.coroutines.withTimeoutOrNull
 
 /**
  * PassGFW - Firewall Detection Library (Android)
@@ -22,6 +27,37 @@ class PassGFW(context: Context) {
         detector.getDomains(retry, customData)
     }
 
+    /**
+     * Probe every URL once, emitting each verified answer with its latency as
+     * probes complete. Unlike getDomains this does not retry or use the cache.
+     * @param customData Optional custom data to send with requests
+     */
+    fun results(customData: String? = null): Flow<DetectionResult> {
+        return detector.results(customData)
+    }
+
+    /**
+     * First verified answer of one pass over the URL list
+     * @return The answer, or null if every URL failed
+     */
+    suspend fun first(customData: String? = null): DetectionResult? {
+        return results(customData).firstOrNull()
+    }
+
+    /**
+     * Collect up to n verified answers for at most within milliseconds; the
+     * remaining probes are cancelled
+     * @return Answers sorted by latency, fastest first, to fail over in order
+     */
+    suspend fun bestOf(n: Int, within: Long, customData: String? = null): List<DetectionResult> {
+        if (n <= 0) return emptyList()
+        val answers = mutableListOf<DetectionResult>()
+        withTimeoutOrNull(within) {
+            results(customData).take(n).toList(answers)
+        }
+        return answers.sortedBy { it.latencyMs }
+    }
+
     /**
      * Get the last error message
      * @return Last error message, or null if no error
@@ -30,6 +66,33 @@ class PassGFW(context: Context) {
         return detector.getLastError()
     }
 
+    /**
+     * Get timing of the most recent API probe
+     * @return Client latency split into server and network time, or null if no probe ran
+     */
+    fun getLastProbeTiming(): ProbeTiming? {
+        return detector.getLastProbeTiming()
+    }
+
+    /**
+     * Get the radio and data budget of the retry loop
+     * @return Requests, bytes and radio wake-ups over the last BUDGET_WINDOW,
+     *         the limits for the current network and app state, and the wait
+     *         before the next detection round
+     */
+    fun getBudgetState(): BudgetState {
+        return detector.getBudgetState()
+    }
+
+    /**
+     * Export recent detection events (probes, phase timings, failure reasons,
+     * URL list changes) as Chrome trace-event JSON, to attach to a bug report
+     * and open in chrome://tracing or ui.perfetto.dev
+     */
+    fun exportTrace(): String {
+        return DiagnosticTrace.export()
+    }
+
     /**
      * Enable or disable logging
      * @param enabled Whether to enable logging
@@ -0,0 +1,39 @@
+package com.passgfw
+
+import kotlinx.coroutines.CoroutineScope
+import kotlinx.coroutines.Deferred
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.async
+
+/**
+ * Probe payloads prepared ahead of use
+ *
+ * take() hands out the oldest payload and keeps PAYLOAD_PREFETCH more in
+ * preparation on Dispatchers.Default, so nonce generation and encryption for
+ * the next probes run while earlier probes wait on the network. A pipeline
+ * serves one detection round and every payload is used at most once;
+ * close() drops the ones the round did not need.
+ */
+internal class PayloadPipeline<T : Any>(
+    private val scope: CoroutineScope,
+    private val prepare: () -> T?
+) {
+    private val ahead = ArrayDeque<Deferred<T?>>()
+
+    suspend fun take(): T? {
+        val next = synchronized(ahead) {
+            while (ahead.size <= Config.PAYLOAD_PREFETCH) {
+                ahead.addLast(scope.async(Dispatchers.Default) { prepare() })
+            }
+            ahead.removeFirst()
+        }
+        return next.await()
+    }
+
+    fun close() {
+        synchronized(ahead) {
+            ahead.forEach { it.cancel() }
+            ahead.clear()
+        }
+    }
+}
@@ -38,7 +38,7 @@ class EncryptedStorage(context: Context) : SecureStorage {
             sharedPreferences.edit().putString(key, value).apply()
             true
         } catch (e: Exception) {
-            Logger.error("Failed to save to encrypted storage: ${e.message}")
+            Logger.error { "Failed to save to encrypted storage: ${e.message}" }
             false
         }
     }
@@ -47,7 +47,7 @@ class EncryptedStorage(context: Context) : SecureStorage {
         return try {
             sharedPreferences.getString(key, null)
         } catch (e: Exception) {
-            Logger.error("Failed to load from encrypted storage: ${e.message}")
+            Logger.error { "Failed to load from encrypted storage: ${e.message}" }
             null
         }
     }
@@ -57,7 +57,7 @@ class EncryptedStorage(context: Context) : SecureStorage {
             sharedPreferences.edit().remove(key).apply()
             true
         } catch (e: Exception) {
-            Logger.error("Failed to delete from encrypted storage: ${e.message}")
+            Logger.error { "Failed to delete from encrypted storage: ${e.message}" }
             false
         }
     }
@@ -0,0 +1,172 @@
+package com.passgfw
+
+import android.content.Context
+import kotlinx.coroutines.sync.Mutex
+import org.json.JSONObject
+import java.io.File
+import java.io.IOException
+import java.io.RandomAccessFile
+import java.nio.MappedByteBuffer
+import java.nio.channels.FileChannel
+import java.nio.channels.FileLock
+import java.nio.channels.FileLockInterruptionException
+import java.nio.channels.OverlappingFileLockException
+import java.util.zip.CRC32
+
+/**
+ * Verified answer shared by every process of the app
+ *
+ * The answer lives in a memory-mapped file in noBackupFilesDir, so each
+ * process reads the latest one without IPC. Layout:
+ *
+ *     0  magic    int
+ *     4  seq      int    odd while a write is in progress
+ *     8  version  long   bumped on every publish
+ *    16  length   int
+ *    20  crc      int    CRC32 of the payload
+ *    24  payload  UTF-8 JSON {"result": {...}, "url": "..."}
+ *
+ * Writes are seqlock-style: seq turns odd, payload and header are written,
+ * seq turns even. A reader retries while seq is odd or changes under it.
+ * Mapped memory has no ordering guarantees on the JVM, so the CRC must match
+ * as well before a read is accepted.
+ *
+ * Detection is single-flight across processes: lead() blocks on an exclusive
+ * lock on a side file and only the leader publishes. The kernel drops the
+ * lock when its process dies, so a waiter takes over from a crashed leader
+ * without polling. File locks belong to the whole process, so there is one
+ * instance per file in a process (see [open]) and its callers take turns on
+ * [turns] before calling lead().
+ */
+internal class SharedAnswer private constructor(dir: File) {
+    class Answer(val version: Long, val result: JSONObject, val url: String?)
+
+    companion object {
+        private const val FILE_NAME = "passgfw.answer"
+        private const val MAGIC = 0x50474657  // "PGFW"
+        private const val SEQ = 4
+        private const val VERSION = 8
+        private const val LENGTH = 16
+        private const val CRC = 20
+        private const val HEADER_SIZE = 24
+        private const val READ_ATTEMPTS = 100
+
+        private val instances = HashMap<String, SharedAnswer>()
+
+        /** The instance of this process for the app's answer file */
+        fun open(context: Context): SharedAnswer {
+            val dir = context.noBackupFilesDir
+            synchronized(instances) {
+                return instances.getOrPut(dir.canonicalPath) { SharedAnswer(dir) }
+            }
+        }
+    }
+
+    /** Held by the caller in this process that is waiting on or holding the lock */
+    val turns = Mutex()
+
+    private val buffer: MappedByteBuffer
+    private val lockFile: File
+    private var lockChannel: FileChannel
+    private var lock: FileLock? = null
+
+    init {
+        // The mapping outlives the channel it was created from
+        buffer = RandomAccessFile(File(dir, FILE_NAME), "rw").use {
+            it.channel.map(FileChannel.MapMode.READ_WRITE, 0, Config.SHARED_ANSWER_SIZE.toLong())
+        }
+        lockFile = File(dir, "$FILE_NAME.lock")
+        lockChannel = RandomAccessFile(lockFile, "rw").channel
+    }
+
+    /**
+     * Latest published answer, or null when none was published or no
+     * consistent copy could be read
+     */
+    fun read(): Answer? {
+        for (attempt in 0 until READ_ATTEMPTS) {
+            val seq = buffer.getInt(SEQ)
+            if (seq and 1 != 0) {
+                Thread.yield()
+                continue
+            }
+            if (buffer.getInt(0) != MAGIC) return null
+            val version = buffer.getLong(VERSION)
+            val length = buffer.getInt(LENGTH)
+            val crc = buffer.getInt(CRC)
+            if (length < 0 || length > buffer.capacity() - HEADER_SIZE) continue
+            val bytes = ByteArray(length)
+            buffer.duplicate().apply { position(HEADER_SIZE) }.get(bytes)
+            if (buffer.getInt(SEQ) != seq || checksum(bytes) != crc) continue
+
+            return try {
+                val payload = JSONObject(String(bytes))
+                Answer(version, payload.getJSONObject("result"), payload.optString("url").takeIf { it.isNotEmpty() })
+            } catch (e: Exception) {
+                Logger.warning { "Shared answer unreadable: ${e.message}" }
+                null
+            }
+        }
+        return null
+    }
+
+    /**
+     * Block until this process runs detection. Callers must hold [turns].
+     * Interrupting the wait closes the lock channel; it is reopened on the
+     * next call.
+     */
+    fun lead() {
+        val channel = synchronized(this) {
+            if (!lockChannel.isOpen) lockChannel = RandomAccessFile(lockFile, "rw").channel
+            lockChannel
+        }
+        val acquired = try {
+            channel.lock()
+        } catch (e: FileLockInterruptionException) {
+            throw e
+        } catch (e: IOException) {
+            // Detect without coordination rather than wait forever
+            Logger.warning { "Answer lock unavailable: ${e.message}" }
+            null
+        } catch (e: OverlappingFileLockException) {
+            // Another caller in this process holds it despite [turns]
+            Logger.warning { "Answer lock already held in this process" }
+            null
+        }
+        synchronized(this) { lock = acquired }
+    }
+
+    @Synchronized
+    fun resign() {
+        runCatching { lock?.release() }
+        lock = null
+    }
+
+    /**
+     * Publish an answer to every process; only the leader calls this.
+     * Returns the new version, or null when the answer does not fit.
+     */
+    @Synchronized
+    fun publish(result: Map<String, Any>, url: String?): Long? {
+        val payload = JSONObject().put("result", JSONObject(result)).put("url", url ?: "")
+        val bytes = payload.toString().toByteArray()
+        if (bytes.size > buffer.capacity() - HEADER_SIZE) {
+            Logger.warning { "Answer too large to share (${bytes.size} bytes)" }
+            return null
+        }
+
+        // A writer that died mid-write leaves seq odd; continue from there
+        val begin = buffer.getInt(SEQ) or 1
+        val version = if (buffer.getInt(0) == MAGIC) buffer.getLong(VERSION) + 1 else 1
+        buffer.putInt(SEQ, begin)
+        buffer.duplicate().apply { position(HEADER_SIZE) }.put(bytes)
+        buffer.putLong(VERSION, version)
+        buffer.putInt(LENGTH, bytes.size)
+        buffer.putInt(CRC, checksum(bytes))
+        buffer.putInt(0, MAGIC)
+        buffer.putInt(SEQ, begin + 1)
+        return version
+    }
+
+    private fun checksum(bytes: ByteArray): Int = CRC32().apply { update(bytes) }.value.toInt()
+}
@@ -53,6 +53,7 @@ class URLManager(private val context: Context) {
 
         // 添加新 URL
         urls.add(entry)
+        DiagnosticTrace.instant("store", mapOf("url" to entry.url, "method" to entry.method))
         return saveURLs(urls)
     }
 
@@ -64,6 +65,7 @@ class URLManager(private val context: Context) {
     fun removeURL(url: String): Boolean {
         val urls = (loadURLs() ?: return false).toMutableList()
         urls.removeAll { it.url == url }
+        DiagnosticTrace.instant("remove", mapOf("url" to url))
         return saveURLs(urls)
     }
 
@@ -86,7 +88,7 @@ class URLManager(private val context: Context) {
             val type = object : TypeToken<List<URLEntry>>() {}.type
             gson.fromJson<List<URLEntry>>(json, type)
         } catch (e: Exception) {
-            Logger.error("Failed to decode URLs: ${e.message}")
+            Logger.error { "Failed to decode URLs: ${e.message}" }
             null
         }
     }
@@ -96,7 +98,7 @@ class URLManager(private val context: Context) {
             val json = gson.toJson(urls)
             storage.save(STORAGE_KEY, json.toByteArray())
         } catch (e: Exception) {
-            Logger.error("Failed to encode URLs: ${e.message}")
+            Logger.error { "Failed to encode URLs: ${e.message}" }
             false
         }
     }
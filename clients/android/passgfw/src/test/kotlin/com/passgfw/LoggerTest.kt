@@ -0,0 +1,58 @@
+package com.passgfw
+
+import org.junit.After
+import org.junit.Assert.assertTrue
+import org.junit.Test
+import java.lang.management.ManagementFactory
+
+/**
+ * The lambda overloads are inline, so a disabled level must cost neither the
+ * lambda nor the interpolated message. Measured with the per-thread
+ * allocation counter of HotSpot's ThreadMXBean.
+ */
+class LoggerTest {
+    private val threads = ManagementFactory.getThreadMXBean() as com.sun.management.ThreadMXBean
+
+    @After
+    fun restore() {
+        Logger.isEnabled = true
+        Logger.minLevel = LogLevel.DEBUG
+    }
+
+    @Test
+    fun disabledLevelAllocatesNothing() {
+        Logger.minLevel = LogLevel.WARNING
+        assertNoAllocation { i ->
+            Logger.debug { "attempt $i of ${CALLS}: ${listOf(i, i + 1)}" }
+            Logger.info { "attempt $i of ${CALLS}: ${listOf(i, i + 1)}" }
+        }
+    }
+
+    @Test
+    fun disabledLoggerAllocatesNothing() {
+        Logger.isEnabled = false
+        assertNoAllocation { i ->
+            Logger.debug { "attempt $i of ${CALLS}: ${listOf(i, i + 1)}" }
+            Logger.info { "attempt $i of ${CALLS}: ${listOf(i, i + 1)}" }
+        }
+    }
+
+    private inline fun assertNoAllocation(body: (Int) -> Unit) {
+        assertTrue("allocation counter unsupported", threads.isThreadAllocatedMemorySupported)
+        threads.isThreadAllocatedMemoryEnabled = true
+        val id = Thread.currentThread().id
+
+        for (i in 0 until CALLS) body(i)  // Warm up so class loading is not measured
+        val before = threads.getThreadAllocatedBytes(id)
+        for (i in 0 until CALLS) body(i)
+        val allocated = threads.getThreadAllocatedBytes(id) - before
+
+        // One message per call would be megabytes; allow for the counter itself
+        assertTrue("disabled log calls allocated $allocated bytes", allocated < SLACK_BYTES)
+    }
+
+    private companion object {
+        const val CALLS = 100_000
+        const val SLACK_BYTES = 1024L
+    }
+}
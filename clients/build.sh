@@ -19,6 +19,7 @@ set -e
 # Options:
 #   --config FILE       Use custom config file (default: build_config.json)
 #   --urls "url1,url2"  Override URLs temporarily
+#   --resolve-addrs H   Embed resolved IP hints (addrs) valid for H hours
 #   --clean             Clean before build
 #   --parallel          Build platforms in parallel (for 'all')
 #   --verify            Verify build after completion
@@ -52,6 +53,7 @@ CLEAN_BUILD=false
 CUSTOM_URLS=""
 PARALLEL_BUILD=false
 VERIFY_BUILD=false
+RESOLVE_ADDRS_HOURS=""
 
 # ============================================================================
 # Helper Functions
@@ -141,6 +143,10 @@ while [[ $# -gt 0 ]]; do
             CUSTOM_URLS="$2"
             shift 2
             ;;
+        --resolve-addrs)
+            RESOLVE_ADDRS_HOURS="$2"
+            shift 2
+            ;;
         --clean)
             CLEAN_BUILD=true
             shift
@@ -225,6 +231,42 @@ else
     PUBLIC_KEY_PATH="$DEFAULT_KEY_PATH"
 fi
 
+if [ -n "$RESOLVE_ADDRS_HOURS" ]; then
+    if ! command -v python3 &> /dev/null; then
+        log_error "--resolve-addrs requires python3"
+        exit 1
+    fi
+    # Resolve the hosts of api/file entries here, interleaving IPv6 and IPv4
+    URLS=$(echo "$URLS" | python3 -c "
+import json, socket, sys, time, ipaddress
+from urllib.parse import urlparse
+urls = json.load(sys.stdin)
+expires = int(time.time() + float('$RESOLVE_ADDRS_HOURS') * 3600)
+for e in urls:
+    e.pop('addrs', None); e.pop('addrs_expires', None)
+    host = urlparse(e.get('url', '')).hostname
+    if e.get('method', 'api') not in ('api', 'file') or not host:
+        continue
+    try:
+        ipaddress.ip_address(host)
+        continue
+    except ValueError:
+        pass
+    try:
+        infos = socket.getaddrinfo(host, None, proto=socket.IPPROTO_TCP)
+    except OSError as err:
+        print('   ' + host + ': ' + str(err), file=sys.stderr)
+        continue
+    v6 = list(dict.fromkeys(i[4][0] for i in infos if i[0] == socket.AF_INET6 and '%' not in i[4][0]))
+    v4 = list(dict.fromkeys(i[4][0] for i in infos if i[0] == socket.AF_INET))
+    addrs = [a for pair in zip(v6 + [None] * len(v4), v4 + [None] * len(v6)) for a in pair if a][:4]
+    if addrs:
+        e['addrs'], e['addrs_expires'] = addrs, expires
+print(json.dumps(urls))
+")
+    log_info "Resolved IP hints valid for ${RESOLVE_ADDRS_HOURS}h"
+fi
+
 echo "   URLs: $(echo "$URLS" | parse_json "$URLS" 'length') entries"
 echo "   Key:  $PUBLIC_KEY_PATH"
 
@@ -298,6 +340,26 @@ log_info "Public key loaded ($(echo "$PUBLIC_KEY" | wc -l | tr -d ' ') lines)"
 # Generate Config Code for Each Platform
 # ============================================================================
 
+# IP hints of URL entry $1 as "ip1,ip2|expires", empty when it has none
+entry_addrs() {
+    if command -v jq &> /dev/null; then
+        echo "$URLS" | jq -r ".[$1] | if ((.addrs // []) | length) > 0 then \"\\(.addrs | join(\",\"))|\\(.addrs_expires // 0)\" else \"\" end"
+    else
+        echo "$URLS" | python3 -c "import json,sys; e=json.load(sys.stdin)[$1]; a=e.get('addrs') or []; print(','.join(a) + '|' + str(e.get('addrs_expires', 0)) if a else '')"
+    fi
+}
+
+# Constructor arguments for the hints: addrs_args <hints> <swift|kotlin>
+addrs_args() {
+    [ -z "$1" ] && return
+    local list=$(echo "${1%|*}" | sed 's/[^,]*/"&"/g; s/,/, /g')
+    if [ "$2" == "swift" ]; then
+        echo ", addrs: [$list], addrsExpires: ${1#*|}"
+    else
+        echo ", addrs = listOf($list), addrsExpires = ${1#*|}L"
+    fi
+}
+
 generate_swift_config() {
     local urls_array=""
 
@@ -307,11 +369,12 @@ generate_swift_config() {
             local method=$(echo "$URLS" | jq -r ".[$i].method // \"api\"")
             local url=$(echo "$URLS" | jq -r ".[$i].url")
             local store=$(echo "$URLS" | jq -r ".[$i].store // false")
+            local addrs=$(addrs_args "$(entry_addrs $i)" swift)
 
             if [ "$store" == "true" ]; then
-                urls_array="$urls_array            URLEntry(method: \"$method\", url: \"$url\", store: true)"
+                urls_array="$urls_array            URLEntry(method: \"$method\", url: \"$url\", store: true$addrs)"
             else
-                urls_array="$urls_array            URLEntry(method: \"$method\", url: \"$url\")"
+                urls_array="$urls_array            URLEntry(method: \"$method\", url: \"$url\"$addrs)"
             fi
 
             if [ $i -lt $((url_count - 1)) ]; then
@@ -326,11 +389,12 @@ generate_swift_config() {
             local method=$(echo "$URLS" | python3 -c "import json,sys; print(json.load(sys.stdin)[$i].get('method', 'api'))")
             local url=$(echo "$URLS" | python3 -c "import json,sys; print(json.load(sys.stdin)[$i]['url'])")
             local store=$(echo "$URLS" | python3 -c "import json,sys; print(str(json.load(sys.stdin)[$i].get('store', False)).lower())")
+            local addrs=$(addrs_args "$(entry_addrs $i)" swift)
 
             if [ "$store" == "true" ]; then
-                urls_array="$urls_array            URLEntry(method: \"$method\", url: \"$url\", store: true)"
+                urls_array="$urls_array            URLEntry(method: \"$method\", url: \"$url\", store: true$addrs)"
             else
-                urls_array="$urls_array            URLEntry(method: \"$method\", url: \"$url\")"
+                urls_array="$urls_array            URLEntry(method: \"$method\", url: \"$url\"$addrs)"
             fi
 
             if [ $i -lt $((url_count - 1)) ]; then
@@ -414,11 +478,12 @@ generate_kotlin_config() {
             local method=$(echo "$URLS" | jq -r ".[$i].method // \"api\"")
             local url=$(echo "$URLS" | jq -r ".[$i].url")
             local store=$(echo "$URLS" | jq -r ".[$i].store // false")
+            local addrs=$(addrs_args "$(entry_addrs $i)" kotlin)
 
             if [ "$store" == "true" ]; then
-                urls_array="$urls_array            URLEntry(method = \"$method\", url = \"$url\", store = true)"
+                urls_array="$urls_array            URLEntry(method = \"$method\", url = \"$url\", store = true$addrs)"
             else
-                urls_array="$urls_array            URLEntry(method = \"$method\", url = \"$url\")"
+                urls_array="$urls_array            URLEntry(method = \"$method\", url = \"$url\"$addrs)"
             fi
 
             if [ $i -lt $((url_count - 1)) ]; then
@@ -432,11 +497,12 @@ generate_kotlin_config() {
             local method=$(echo "$URLS" | python3 -c "import json,sys; print(json.load(sys.stdin)[$i].get('method', 'api'))")
             local url=$(echo "$URLS" | python3 -c "import json,sys; print(json.load(sys.stdin)[$i]['url'])")
             local store=$(echo "$URLS" | python3 -c "import json,sys; print(str(json.load(sys.stdin)[$i].get('store', False)).lower())")
+            local addrs=$(addrs_args "$(entry_addrs $i)" kotlin)
 
             if [ "$store" == "true" ]; then
-                urls_array="$urls_array            URLEntry(method = \"$method\", url = \"$url\", store = true)"
+                urls_array="$urls_array            URLEntry(method = \"$method\", url = \"$url\", store = true$addrs)"
             else
-                urls_array="$urls_array            URLEntry(method = \"$method\", url = \"$url\")"
+                urls_array="$urls_array            URLEntry(method = \"$method\", url = \"$url\"$addrs)"
             fi
 
             if [ $i -lt $((url_count - 1)) ]; then
@@ -0,0 +1,71 @@
+import Foundation
+
+/// Per-host circuit breakers, shared by every URL and detection round in the
+/// process
+///
+/// A host opens after circuitFailureThreshold consecutive failed requests and
+/// its URLs are then skipped without a request. After circuitCooldown it turns
+/// half-open: a single trial request goes out, closing the breaker on success
+/// and reopening it for another cooldown on failure. Any HTTP status counts as
+/// success, since the host answered.
+final class CircuitBreaker {
+    static let shared = CircuitBreaker()
+
+    private enum State {
+        case closed, open, halfOpen
+    }
+
+    private struct Host {
+        var state = State.closed
+        var failures = 0
+        var openedAt = Date.distantPast
+    }
+
+    private let lock = NSLock()
+    private var hosts: [String: Host] = [:]  // Only hosts with failures
+
+    /// Whether a request to host may go out now. On a half-open host the first
+    /// caller gets the trial and later callers are refused until it ends.
+    func allow(host: String) -> Bool {
+        guard Config.circuitBreaker else { return true }
+        lock.lock()
+        defer { lock.unlock() }
+        guard var h = hosts[host] else { return true }
+        switch h.state {
+        case .closed:
+            return true
+        case .halfOpen:
+            return false
+        case .open:
+            guard Date().timeIntervalSince(h.openedAt) >= Config.circuitCooldown else { return false }
+            h.state = .halfOpen
+            hosts[host] = h
+            Logger.shared.debug("Circuit half-open, sending trial: \(host)")
+            return true
+        }
+    }
+
+    func recordSuccess(host: String) {
+        lock.lock()
+        defer { lock.unlock() }
+        if let h = hosts.removeValue(forKey: host), h.state != .closed {
+            Logger.shared.info("Circuit closed: \(host)")
+        }
+    }
+
+    func recordFailure(host: String) {
+        guard Config.circuitBreaker else { return }
+        lock.lock()
+        defer { lock.unlock() }
+        var h = hosts[host] ?? Host()
+        h.failures += 1
+        if h.state == .halfOpen || h.failures >= Config.circuitFailureThreshold {
+            if h.state != .open {
+                Logger.shared.warning("Circuit open for \(Config.circuitCooldown)s: \(host) (\(h.failures) failures)")
+            }
+            h.state = .open
+            h.openedAt = Date()
+        }
+        hosts[host] = h
+    }
+}
@@ -5,17 +5,29 @@ public struct URLEntry: Codable {
     public let method: String  // "api", "file", "navigate", or "remove"
     public let url: String
     public let store: Bool     // 是否持久化存储（只对 api 和 file 有效，默认 false）
+    public let addrs: [String]?   // IP 提示：先于 DNS 连接，同时并行解析（只对 api 有效）
+    public let addrsExpires: Int64  // IP 提示的过期时间（Unix 秒）
 
     enum CodingKeys: String, CodingKey {
         case method
         case url
         case store
+        case addrs
+        case addrsExpires = "addrs_expires"
     }
 
-    public init(method: String, url: String, store: Bool = false) {
+    public init(method: String, url: String, store: Bool = false, addrs: [String]? = nil, addrsExpires: Int64 = 0) {
         self.method = method
         self.url = url
         self.store = store
+        self.addrs = addrs
+        self.addrsExpires = addrsExpires
+    }
+
+    /// IP hints that have not expired
+    var validAddrs: [String] {
+        guard let addrs = addrs, Double(addrsExpires) > Date().timeIntervalSince1970 else { return [] }
+        return addrs
     }
 
     // 自定义解码，store 字段不存在时默认为 false
@@ -24,6 +36,8 @@ public struct URLEntry: Codable {
         method = try container.decode(String.self, forKey: .method)
         url = try container.decode(String.self, forKey: .url)
         store = try container.decodeIfPresent(Bool.self, forKey: .store) ?? false
+        addrs = try container.decodeIfPresent([String].self, forKey: .addrs)
+        addrsExpires = try container.decodeIfPresent(Int64.self, forKey: .addrsExpires) ?? 0
     }
 
     // 自定义编码，store 为 false 时不输出到 JSON
@@ -34,6 +48,10 @@ public struct URLEntry: Codable {
         if store {
             try container.encode(store, forKey: .store)
         }
+        if let addrs = addrs, !addrs.isEmpty {
+            try container.encode(addrs, forKey: .addrs)
+            try container.encode(addrsExpires, forKey: .addrsExpires)
+        }
     }
 }
 
@@ -108,5 +126,77 @@ struct Config {
     /// Allow concurrent checking for File method (false recommended to avoid recursion explosion)
     static let fileMethodConcurrent = false
     // BUILD_CONFIG_END
+
+    // MARK: - Client Identity
+
+    /// Random bytes in the persisted client ID (used by the server for backend affinity)
+    static let clientIdSize = 16
+
+    // MARK: - Probe Correlation
+
+    /// Request header carrying the probe ID; the server echoes it with Server-Timing
+    static let probeIdHeader = "X-PassGFW-Probe"
+
+    /// Random bytes in a probe ID (hex encoded)
+    static let probeIdSize = 8
+
+    // MARK: - Transport
+
+    /// Send the first request to each host over a TCP Fast Open connection
+    static let tcpFastOpen = true
+
+    // MARK: - Cache Revalidation
+
+    /// Before getDomains(retry: false) returns the cached answer, check that a
+    /// TCP connection to its domain succeeds
+    static let revalidateCache = true
+
+    /// Budget of that check in seconds, resolution included
+    static let revalidateTimeout: TimeInterval = 0.8
+
+    // MARK: - Circuit Breaker
+
+    /// Skip every URL on a host after repeated failures; state is shared by all
+    /// URLs on the host and all detection rounds
+    static let circuitBreaker = true
+
+    /// Consecutive failed requests that open a host (HTTP error statuses do not count)
+    static let circuitFailureThreshold = 2
+
+    /// Seconds a host stays open before one trial request is let through
+    static let circuitCooldown: TimeInterval = 30
+
+    // MARK: - Pipelining
+
+    /// Probe payloads encrypted in the background while probes are in flight;
+    /// each carries a fresh nonce and is used once
+    static let payloadPrefetch = 2
+
+    // MARK: - Data Budget
+
+    /// Stretch the getDomains retry interval once requests, bytes or radio
+    /// wake-ups pass half of their limit over budgetWindow; once a limit is
+    /// reached, wait until old requests leave the window
+    static let dataBudget = true
+
+    /// Sliding window of the budget (seconds)
+    static let budgetWindow: TimeInterval = 3600
+
+    /// A request starting this long after the previous one ended counts as a radio wake-up (seconds)
+    static let budgetRadioTail: TimeInterval = 10
+
+    /// Bytes counted per request besides its bodies (headers, handshakes)
+    static let budgetRequestOverhead = 1024
+
+    /// Limits per budgetWindow by app state and network
+    static let budgetForegroundUnmetered = BudgetLimits(probes: 3600, bytes: 16_000_000, wakeups: 120)
+    static let budgetForegroundMetered = BudgetLimits(probes: 1200, bytes: 4_000_000, wakeups: 60)
+    static let budgetBackgroundUnmetered = BudgetLimits(probes: 600, bytes: 4_000_000, wakeups: 30)
+    static let budgetBackgroundMetered = BudgetLimits(probes: 120, bytes: 500_000, wakeups: 12)
+
+    // MARK: - Diagnostics
+
+    /// Detection events kept in memory for exportTrace(); 0 disables
+    static let traceBufferSize = 512
 }
 
@@ -0,0 +1,180 @@
+import Foundation
+import Network
+#if os(macOS)
+import AppKit
+#else
+import UIKit
+#endif
+
+/// Detection limits for one budgetWindow
+public struct BudgetLimits {
+    /// Requests (API probes and file lists)
+    public let probes: Int
+    /// Estimated bytes on the wire
+    public let bytes: Int
+    /// Requests that had to wake the radio
+    public let wakeups: Int
+}
+
+/// Detection usage over the last budgetWindow and the limits that apply now
+public struct BudgetState {
+    public let metered: Bool
+    public let foreground: Bool
+    public let probes: Int
+    public let bytes: Int
+    public let wakeups: Int
+    public let limits: BudgetLimits
+    /// Seconds getDomains waits before its next round
+    public let retryDelay: TimeInterval
+
+    public var exhausted: Bool {
+        return probes >= limits.probes || bytes >= limits.bytes || wakeups >= limits.wakeups
+    }
+}
+
+/// Radio and data budget of the detection retry loop
+///
+/// Every request is recorded with its estimated size. A request that starts
+/// more than budgetRadioTail after the previous one ended counts as a radio
+/// wake-up, since the radio has dropped out of its high-power state by then.
+/// Usage over the sliding budgetWindow is checked against the limits for the
+/// current network (expensive or constrained counts as metered) and app state.
+///
+/// retryDelay() is retryInterval while usage is below half of every limit,
+/// then stretches as usage grows; once a limit is reached it is the time until
+/// enough of the window has expired to get back under all limits.
+final class DataBudget {
+    private struct Request {
+        let at: Date
+        let bytes: Int
+        let wakeup: Bool
+    }
+
+    private let lock = NSLock()
+    private var requests: [Request] = []  // Oldest first, within budgetWindow
+    private var lastActivity = Date.distantPast
+    private var metered = false
+    private var foreground = true
+    private let monitor = NWPathMonitor()
+    private var observers: [NSObjectProtocol] = []
+
+    init() {
+        monitor.pathUpdateHandler = { [weak self] path in
+            self?.setMetered(path.isExpensive || path.isConstrained)
+        }
+        monitor.start(queue: DispatchQueue(label: "passgfw.budget"))
+
+        let center = NotificationCenter.default
+        #if os(macOS)
+        let (enter, leave) = (NSApplication.didBecomeActiveNotification, NSApplication.didResignActiveNotification)
+        #else
+        let (enter, leave) = (UIApplication.willEnterForegroundNotification, UIApplication.didEnterBackgroundNotification)
+        #endif
+        observers.append(center.addObserver(forName: enter, object: nil, queue: nil) { [weak self] _ in
+            self?.setForeground(true)
+        })
+        observers.append(center.addObserver(forName: leave, object: nil, queue: nil) { [weak self] _ in
+            self?.setForeground(false)
+        })
+        DispatchQueue.main.async { [weak self] in
+            #if os(macOS)
+            self?.setForeground(NSApplication.shared.isActive)
+            #else
+            self?.setForeground(UIApplication.shared.applicationState != .background)
+            #endif
+        }
+    }
+
+    deinit {
+        monitor.cancel()
+        observers.forEach { NotificationCenter.default.removeObserver($0) }
+    }
+
+    /// Record a request that started at startedAt and moved bodyBytes of
+    /// request and response bodies
+    func record(startedAt: Date, bodyBytes: Int) {
+        let now = Date()
+        lock.lock()
+        defer { lock.unlock() }
+        let wakeup = startedAt.timeIntervalSince(lastActivity) > Config.budgetRadioTail
+        lastActivity = now
+        requests.append(Request(at: now, bytes: bodyBytes + Config.budgetRequestOverhead, wakeup: wakeup))
+        prune(now)
+    }
+
+    func state() -> BudgetState {
+        let now = Date()
+        lock.lock()
+        defer { lock.unlock() }
+        prune(now)
+        let limits: BudgetLimits
+        switch (foreground, metered) {
+        case (true, true): limits = Config.budgetForegroundMetered
+        case (true, false): limits = Config.budgetForegroundUnmetered
+        case (false, true): limits = Config.budgetBackgroundMetered
+        case (false, false): limits = Config.budgetBackgroundUnmetered
+        }
+        let probes = requests.count
+        let bytes = requests.reduce(0) { $0 + $1.bytes }
+        let wakeups = requests.filter { $0.wakeup }.count
+        return BudgetState(
+            metered: metered, foreground: foreground,
+            probes: probes, bytes: bytes, wakeups: wakeups, limits: limits,
+            retryDelay: retryDelay(now: now, limits: limits, probes: probes, bytes: bytes, wakeups: wakeups)
+        )
+    }
+
+    /// Wait in seconds before the next detection round
+    func retryDelay() -> TimeInterval {
+        return Config.dataBudget ? state().retryDelay : Config.retryInterval
+    }
+
+    private func retryDelay(now: Date, limits: BudgetLimits, probes: Int, bytes: Int, wakeups: Int) -> TimeInterval {
+        let usage = max(
+            Double(probes) / Double(limits.probes),
+            Double(bytes) / Double(limits.bytes),
+            Double(wakeups) / Double(limits.wakeups)
+        )
+        if usage < 0.5 {
+            return Config.retryInterval
+        }
+        if usage < 1 {
+            return min(Config.retryInterval / (2 * (1 - usage)), Config.budgetWindow)
+        }
+
+        // Exhausted: wait for the oldest requests to leave the window
+        var (p, b, w) = (probes, bytes, wakeups)
+        for request in requests {
+            p -= 1
+            b -= request.bytes
+            if request.wakeup {
+                w -= 1
+            }
+            if p < limits.probes && b < limits.bytes && w < limits.wakeups {
+                let expires = request.at.addingTimeInterval(Config.budgetWindow).timeIntervalSince(now)
+                return max(expires, Config.retryInterval)
+            }
+        }
+        return Config.budgetWindow
+    }
+
+    private func prune(_ now: Date) {
+        if let index = requests.firstIndex(where: { now.timeIntervalSince($0.at) < Config.budgetWindow }) {
+            requests.removeFirst(index)
+        } else {
+            requests.removeAll()
+        }
+    }
+
+    private func setMetered(_ value: Bool) {
+        lock.lock()
+        metered = value
+        lock.unlock()
+    }
+
+    private func setForeground(_ value: Bool) {
+        lock.lock()
+        foreground = value
+        lock.unlock()
+    }
+}
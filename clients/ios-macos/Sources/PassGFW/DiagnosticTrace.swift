@@ -0,0 +1,105 @@
+import Foundation
+
+/// In-memory record of recent detection events, for "stuck connecting" reports
+///
+/// Events go into a fixed ring of traceBufferSize slots, overwriting the
+/// oldest. Swift has no atomics without a dependency, so a writer holds a lock
+/// for one slot store; building the event happens outside it. Warnings and
+/// errors are recorded even when logging is off, which makes them the failure
+/// reasons of the trace.
+///
+/// export() renders the ring as Chrome trace-event JSON for chrome://tracing
+/// or ui.perfetto.dev. Spans become async events, so concurrent probes get
+/// rows of their own.
+final class DiagnosticTrace {
+    static let shared = DiagnosticTrace()
+
+    static var isEnabled: Bool {
+        return Config.traceBufferSize > 0
+    }
+
+    private struct Event {
+        let seq: Int
+        let name: String
+        let startUs: UInt64
+        let durUs: UInt64?  // nil for an instant
+        let args: [String: Any]
+    }
+
+    private let lock = NSLock()
+    private var slots: [Event?] = Array(repeating: nil, count: max(Config.traceBufferSize, 0))
+    private var next = 0
+    private let epoch = Date()
+    private let epochNs = DispatchTime.now().uptimeNanoseconds
+
+    private init() {}
+
+    /// Monotonic microseconds since the SDK loaded; pass it to span() later
+    func now() -> UInt64 {
+        return (DispatchTime.now().uptimeNanoseconds - epochNs) / 1000
+    }
+
+    /// Record a span that began at startUs (from now()) and ends now
+    func span(_ name: String, start startUs: UInt64, args: [String: Any] = [:]) {
+        guard DiagnosticTrace.isEnabled else { return }
+        let end = now()
+        record(name: name, startUs: startUs, durUs: end > startUs ? end - startUs : 0, args: args)
+    }
+
+    func instant(_ name: String, args: [String: Any] = [:]) {
+        guard DiagnosticTrace.isEnabled else { return }
+        record(name: name, startUs: now(), durUs: nil, args: args)
+    }
+
+    private func record(name: String, startUs: UInt64, durUs: UInt64?, args: [String: Any]) {
+        lock.lock()
+        slots[next % slots.count] = Event(seq: next, name: name, startUs: startUs, durUs: durUs, args: args)
+        next += 1
+        lock.unlock()
+    }
+
+    /// The buffered events, oldest first, as Chrome trace-event JSON
+    func export() -> String {
+        lock.lock()
+        let end = next
+        let ordered = slots.isEmpty ? [] : (max(end - slots.count, 0)..<end).compactMap { slots[$0 % slots.count] }
+        lock.unlock()
+
+        var events: [[String: Any]] = []
+        for event in ordered {
+            // Only JSON-representable values; anything else is described
+            let args = event.args.mapValues { value -> Any in
+                JSONSerialization.isValidJSONObject([value]) ? value : String(describing: value)
+            }
+            func traceEvent(_ phase: String, _ ts: UInt64) -> [String: Any] {
+                return ["name": event.name, "cat": "passgfw", "ph": phase, "ts": ts, "pid": 1, "tid": 1]
+            }
+            if let durUs = event.durUs {
+                var begin = traceEvent("b", event.startUs)
+                begin["id"] = event.seq
+                begin["args"] = args
+                var finish = traceEvent("e", event.startUs + durUs)
+                finish["id"] = event.seq
+                events.append(begin)
+                events.append(finish)
+            } else {
+                var instant = traceEvent("i", event.startUs)
+                instant["s"] = "p"
+                instant["args"] = args
+                events.append(instant)
+            }
+        }
+
+        let trace: [String: Any] = [
+            "traceEvents": events,
+            "displayTimeUnit": "ms",
+            "otherData": [
+                "sdk": "swift",
+                "epoch_ms": Int(epoch.timeIntervalSince1970 * 1000),
+                "dropped": max(end - slots.count, 0)
+            ]
+        ]
+        guard let data = try? JSONSerialization.data(withJSONObject: trace) else { return "{}" }
+        return String(data: data, encoding: .utf8) ?? "{}"
+    }
+}
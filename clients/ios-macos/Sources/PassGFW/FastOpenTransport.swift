@@ -0,0 +1,260 @@
+import Foundation
+import Network
+
+/// Parsed HTTP/1.1 response from FastOpenTransport
+struct FastOpenResponse {
+    let statusCode: Int
+    let headers: [String: String]  // Lowercased names
+    let body: Data
+
+    /// Parse a buffered response; nil until it is complete
+    static func parse(_ data: Data, complete: Bool) -> FastOpenResponse? {
+        guard let separator = data.range(of: Data("\r\n\r\n".utf8)),
+              let head = String(data: data[..<separator.lowerBound], encoding: .utf8) else {
+            return nil
+        }
+        var lines = head.components(separatedBy: "\r\n")
+        let status = lines.removeFirst().split(separator: " ")
+        guard status.count >= 2, let statusCode = Int(status[1]) else { return nil }
+
+        var headers: [String: String] = [:]
+        for line in lines {
+            guard let colon = line.firstIndex(of: ":") else { continue }
+            let name = line[..<colon].trimmingCharacters(in: .whitespaces).lowercased()
+            headers[name] = line[line.index(after: colon)...].trimmingCharacters(in: .whitespaces)
+        }
+
+        let body = Data(data[separator.upperBound...])
+        if let length = headers["content-length"].flatMap({ Int($0) }) {
+            guard body.count >= length else { return nil }
+            return FastOpenResponse(statusCode: statusCode, headers: headers, body: body.prefix(length))
+        }
+        guard complete else { return nil }
+        if headers["transfer-encoding"]?.lowercased().contains("chunked") == true {
+            guard let decoded = dechunk(body) else { return nil }
+            return FastOpenResponse(statusCode: statusCode, headers: headers, body: decoded)
+        }
+        return FastOpenResponse(statusCode: statusCode, headers: headers, body: body)
+    }
+
+    private static func dechunk(_ data: Data) -> Data? {
+        var out = Data()
+        var rest = data
+        let crlf = Data("\r\n".utf8)
+        while let lineEnd = rest.range(of: crlf) {
+            let sizeLine = String(decoding: rest[rest.startIndex..<lineEnd.lowerBound], as: UTF8.self)
+            let sizeField = sizeLine.split(separator: ";").first.map(String.init) ?? ""
+            guard let size = Int(sizeField.trimmingCharacters(in: .whitespaces), radix: 16) else { return nil }
+            if size == 0 { return out }
+            let start = lineEnd.upperBound
+            guard rest.endIndex - start >= size + 2 else { return nil }
+            out.append(rest[start..<start + size])
+            rest = rest[(start + size + 2)...]
+        }
+        return nil
+    }
+}
+
+/// One-shot HTTP/1.1 POST over a Network.framework connection with TCP Fast
+/// Open. URLSession offers no TFO control, so the first probe to each host
+/// goes through here; later requests use URLSession's pooled connections.
+///
+/// With a TFO cookie from an earlier connection the request (or, for HTTPS,
+/// the ClientHello) rides in the SYN, saving one round trip.
+///
+/// Given IP hints, it also dials each hint directly (SNI, certificate name and
+/// Host stay the hostname) while a connection to the hostname resolves in
+/// parallel, and sends the request on whichever connects first.
+final class FastOpenTransport {
+    static let shared = FastOpenTransport()
+
+    private let lock = NSLock()
+    private var seenHosts = Set<String>()
+    private let queue = DispatchQueue(label: "com.passgfw.fastopen")
+
+    /// True the first time a scheme/host/port is seen
+    func claimFirstRequest(to url: URL) -> Bool {
+        let key = "\(url.scheme ?? "")://\(url.host ?? ""):\(url.port ?? 0)"
+        lock.lock()
+        defer { lock.unlock() }
+        return seenHosts.insert(key).inserted
+    }
+
+    /// Send a POST and read the whole response. Returns nil on any transport
+    /// failure so the caller can retry with URLSession.
+    func post(url: URL, body: Data, headers: [String: String], timeout: TimeInterval,
+              addrs: [String] = []) async -> FastOpenResponse? {
+        guard let host = url.host, let scheme = url.scheme?.lowercased(),
+              scheme == "http" || scheme == "https" else {
+            return nil
+        }
+        let secure = scheme == "https"
+        guard let port = NWEndpoint.Port(rawValue: UInt16(url.port ?? (secure ? 443 : 80))) else { return nil }
+
+        func parameters() -> NWParameters {
+            let tcp = NWProtocolTCP.Options()
+            tcp.enableFastOpen = true
+            tcp.noDelay = true
+            var tls: NWProtocolTLS.Options?
+            if secure {
+                tls = NWProtocolTLS.Options()
+                sec_protocol_options_set_tls_server_name(tls!.securityProtocolOptions, host)
+            }
+            let parameters = NWParameters(tls: tls, tcp: tcp)
+            parameters.allowFastOpen = true
+            return parameters
+        }
+
+        let components = URLComponents(url: url, resolvingAgainstBaseURL: false)
+        var target = components?.percentEncodedPath ?? "/"
+        if target.isEmpty { target = "/" }
+        if let query = components?.percentEncodedQuery { target += "?" + query }
+        let hostHeader = url.port.map { "\(host):\($0)" } ?? host
+
+        var head = "POST \(target) HTTP/1.1\r\nHost: \(hostHeader)\r\nContent-Length: \(body.count)\r\nConnection: close\r\n"
+        for (name, value) in headers {
+            head += "\(name): \(value)\r\n"
+        }
+        head += "\r\n"
+        var request = Data(head.utf8)
+        request.append(body)
+
+        var connections = addrs.compactMap { addr -> NWConnection? in
+            guard IPv4Address(addr) != nil || IPv6Address(addr) != nil else { return nil }
+            return NWConnection(host: NWEndpoint.Host(addr), port: port, using: parameters())
+        }
+        connections.append(NWConnection(host: NWEndpoint.Host(host), port: port, using: parameters()))
+        return await withCheckedContinuation { continuation in
+            Exchange(connections: connections, continuation: continuation)
+                .start(request: request, secure: secure, timeout: timeout, queue: queue)
+        }
+    }
+
+    /// Whether a TCP connection to a domain ("host", "host:port" or a URL;
+    /// port 443 by default) is established within timeout, resolution included
+    func canConnect(domain: String, timeout: TimeInterval) async -> Bool {
+        let components = URLComponents(string: domain.contains("://") ? domain : "//" + domain)
+        guard let host = components?.host, !host.isEmpty,
+              let port = NWEndpoint.Port(rawValue: UInt16(components?.port ?? (components?.scheme == "http" ? 80 : 443))) else {
+            return false
+        }
+        let connection = NWConnection(host: NWEndpoint.Host(host), port: port, using: .tcp)
+        return await withCheckedContinuation { continuation in
+            var done = false
+            // Every callback runs on queue, so done needs no lock
+            func finish(_ reachable: Bool) {
+                guard !done else { return }
+                done = true
+                connection.stateUpdateHandler = nil
+                connection.cancel()
+                continuation.resume(returning: reachable)
+            }
+            connection.stateUpdateHandler = { state in
+                switch state {
+                case .ready:
+                    finish(true)
+                case .failed, .waiting:
+                    finish(false)
+                default:
+                    break
+                }
+            }
+            connection.start(queue: queue)
+            queue.asyncAfter(deadline: .now() + timeout) { finish(false) }
+        }
+    }
+}
+
+/// State of one request/response exchange; every callback runs on the
+/// transport's serial queue
+private final class Exchange {
+    private var pending: [NWConnection]  // Still racing
+    private var winner: NWConnection?
+    private let continuation: CheckedContinuation<FastOpenResponse?, Never>
+    private var received = Data()
+    private var finished = false
+
+    init(connections: [NWConnection], continuation: CheckedContinuation<FastOpenResponse?, Never>) {
+        self.pending = connections
+        self.continuation = continuation
+    }
+
+    func start(request: Data, secure: Bool, timeout: TimeInterval, queue: DispatchQueue) {
+        // A lone plain-HTTP connection queues the request before start() so it
+        // rides in the SYN; raced connections must not all send it
+        let early = !secure && pending.count == 1
+        for connection in pending {
+            connection.stateUpdateHandler = { state in
+                switch state {
+                case .ready:
+                    self.won(connection, request: early ? nil : request)
+                case .waiting, .failed, .cancelled:
+                    self.lost(connection)
+                default:
+                    break
+                }
+            }
+            if early {
+                // Idempotent data queued before start() is carried in the SYN
+                connection.send(content: request, contentContext: .defaultMessage, isComplete: false, completion: .idempotent)
+            }
+            connection.start(queue: queue)
+        }
+        queue.asyncAfter(deadline: .now() + timeout) { self.finish(nil) }
+    }
+
+    private func won(_ connection: NWConnection, request: Data?) {
+        guard winner == nil, !finished else { return }
+        winner = connection
+        for other in pending where other !== connection {
+            other.stateUpdateHandler = nil
+            other.cancel()
+        }
+        pending = []
+        if let request = request {
+            connection.send(content: request, completion: .contentProcessed { error in
+                if error != nil { self.finish(nil) }
+            })
+        }
+        receive()
+    }
+
+    private func lost(_ connection: NWConnection) {
+        if connection === winner {
+            finish(nil)
+            return
+        }
+        connection.stateUpdateHandler = nil
+        connection.cancel()
+        pending.removeAll { $0 === connection }
+        if pending.isEmpty && winner == nil {
+            finish(nil)
+        }
+    }
+
+    private func receive() {
+        winner?.receive(minimumIncompleteLength: 1, maximumLength: 65536) { data, _, isComplete, error in
+            if let data = data {
+                self.received.append(data)
+            }
+            let done = isComplete || error != nil
+            if let response = FastOpenResponse.parse(self.received, complete: done) {
+                self.finish(response)
+            } else if done {
+                self.finish(nil)
+            } else {
+                self.receive()
+            }
+        }
+    }
+
+    private func finish(_ response: FastOpenResponse?) {
+        guard !finished else { return }
+        finished = true
+        for connection in pending + [winner].compactMap({ $0 }) {
+            connection.stateUpdateHandler = nil
+            connection.cancel()
+        }
+        continuation.resume(returning: response)
+    }
+}
@@ -5,16 +5,43 @@ import AppKit
 import UIKit
 #endif
 
+/// A verified answer from one API URL
+public struct DetectionResult {
+    public let url: String
+    /// Time from sending the probe to a verified answer
+    public let latencyMs: Double
+    public let data: [String: Any]
+}
+
+/// An encrypted probe payload and the nonce the response must echo
+struct PreparedPayload {
+    let nonce: Data
+    let encrypted: Data
+    let probeId: String
+}
+
 /// Firewall Detector - Core detection logic
 class FirewallDetector {
     private let networkClient: NetworkClient
     private let cryptoHelper: CryptoHelper
     private let urlManager: URLManager
+    private let storage: SecureStorage
+    private let budget = DataBudget()
+
+    private static let clientIdKey = "passgfw.client_id"
+
+    // 稳定的安装标识，服务器据此把客户端固定到同一后端
+    private lazy var clientId: String = loadOrCreateClientId()
 
     // 缓存最后成功的结果
     private var cachedResult: [String: Any]?
+    // 得到缓存结果的顶层 URL，重新检测时最先尝试
+    private var cachedURL: String?
     private var lastError: String?
 
+    // 最近一次 API 探测的耗时拆分
+    private var lastProbeTiming: ProbeTiming?
+
     init() {
         self.networkClient = NetworkClient(timeout: Config.requestTimeout)
         self.cryptoHelper = CryptoHelper()
@@ -27,6 +54,7 @@ class FirewallDetector {
 
         // Initialize URL Manager
         let storage = KeychainStorage()
+        self.storage = storage
         self.urlManager = URLManager(storage: storage)
 
         Task {
@@ -45,31 +73,49 @@ class FirewallDetector {
     ///   - customData: Optional custom data to send with requests
     /// - Returns: Dictionary containing server response data, or nil if all attempts fail
     func getDomains(retry: Bool, customData: String?) async -> [String: Any]? {
-        // If not retry and cache exists, return cache
+        // If not retry and cache exists, return cache while its domain is reachable
         if !retry, let cached = cachedResult {
-            Logger.shared.info("Returning cached result")
-            return cached
+            let start = DiagnosticTrace.shared.now()
+            let reachable = await isReachable(cached)
+            DiagnosticTrace.shared.span("revalidate", start: start, args: ["domain": cached["domain"] ?? "", "ok": reachable])
+            if reachable {
+                Logger.shared.info("Returning cached result")
+                return cached
+            }
+            Logger.shared.warning("Cached domain unreachable, re-detecting")
         }
 
         // Perform detection
         Logger.shared.info("Starting detection (retry=\(retry))")
 
         // Infinite retry loop until success
+        var round = 0
         while true {
-            let urls = await urlManager.getURLs()
+            let urls = cachedURLFirst(await urlManager.getURLs())
             Logger.shared.debug("Checking \(urls.count) URLs")
 
-            if let result = await checkURLsSequentially(entries: urls, customData: customData, recursionDepth: 0) {
+            round += 1
+            let start = DiagnosticTrace.shared.now()
+            let payloads = makePayloads(customData: customData)
+            let result = await checkURLsSequentially(entries: urls, payloads: payloads, recursionDepth: 0)
+            payloads.cancel()
+            DiagnosticTrace.shared.span("detect", start: start, args: ["round": round, "urls": urls.count, "ok": result != nil])
+            if let result = result {
                 // Success - cache and return
                 cachedResult = result
                 Logger.shared.info("Detection succeeded")
                 return result
             }
 
-            // All failed, wait and retry
+            // All failed, wait and retry, slower as the data budget runs out
             lastError = "All URLs failed, retrying..."
             Logger.shared.warning(lastError!)
-            try? await Task.sleep(nanoseconds: UInt64(Config.retryInterval * 1_000_000_000))
+            let wait = budget.retryDelay()
+            if wait > Config.retryInterval {
+                Logger.shared.info("Data budget low, next round in \(Int(wait))s")
+                DiagnosticTrace.shared.instant("budget", args: ["wait_ms": Int(wait * 1000)])
+            }
+            try? await Task.sleep(nanoseconds: UInt64(wait * 1_000_000_000))
         }
     }
 
@@ -78,15 +124,66 @@ class FirewallDetector {
         return lastError
     }
 
+    /// Get detection data usage and the limits that apply now
+    func getBudgetState() -> BudgetState {
+        return budget.state()
+    }
+
+    /// Get timing of the most recent API probe
+    func getLastProbeTiming() -> ProbeTiming? {
+        return lastProbeTiming
+    }
+
+    /// Probe every URL once and yield each verified answer as its probe
+    /// completes, so answers arrive roughly fastest first. File lists are
+    /// expanded as they load, with at most concurrentCheckCount requests in
+    /// flight. Navigate entries are skipped and remove entries applied.
+    /// Ending the iteration cancels the remaining probes.
+    func results(customData: String?) -> AsyncStream<DetectionResult> {
+        return AsyncStream { continuation in
+            let task = Task {
+                let state = ResultsState(slots: Config.concurrentCheckCount)
+                let payloads = makePayloads(customData: customData)
+                let urls = await urlManager.getURLs()
+                await streamURLs(entries: urls, payloads: payloads, recursionDepth: 0, state: state, continuation: continuation)
+                payloads.cancel()
+                continuation.finish()
+            }
+            continuation.onTermination = { _ in task.cancel() }
+        }
+    }
+
     // MARK: - Private Methods
 
+    /// Cheap liveness check of a cached answer: a TCP connect to its domain
+    /// within revalidateTimeout. Answers without a domain are trusted.
+    private func isReachable(_ cached: [String: Any]) async -> Bool {
+        guard Config.revalidateCache, let domain = cached["domain"] as? String else {
+            return true
+        }
+        return await networkClient.canConnect(domain: domain, timeout: Config.revalidateTimeout)
+    }
+
+    /// Move the URL that produced the cached answer to the front
+    private func cachedURLFirst(_ urls: [URLEntry]) -> [URLEntry] {
+        guard let index = urls.firstIndex(where: { $0.url == cachedURL }), index > 0 else {
+            return urls
+        }
+        var ordered = urls
+        ordered.insert(ordered.remove(at: index), at: 0)
+        return ordered
+    }
+
     /// Check URLs sequentially
-    private func checkURLsSequentially(entries: [URLEntry], customData: String?, recursionDepth: Int) async -> [String: Any]? {
+    private func checkURLsSequentially(entries: [URLEntry], payloads: PayloadPipeline<PreparedPayload>, recursionDepth: Int) async -> [String: Any]? {
         for entry in entries {
             Logger.shared.debug("Checking URL: \(entry.url) (method: \(entry.method), depth: \(recursionDepth))")
 
-            if let result = await checkURLEntry(entry, customData: customData, recursionDepth: recursionDepth) {
+            if let result = await checkURLEntry(entry, payloads: payloads, recursionDepth: recursionDepth) {
                 Logger.shared.info("Found available server")
+                if recursionDepth == 0 {
+                    cachedURL = entry.url
+                }
                 return result
             }
 
@@ -96,13 +193,54 @@ class FirewallDetector {
         return nil
     }
 
+    /// Probe entries concurrently for results(), returning when every nested
+    /// list has been walked
+    private func streamURLs(entries: [URLEntry], payloads: PayloadPipeline<PreparedPayload>, recursionDepth: Int,
+                            state: ResultsState, continuation: AsyncStream<DetectionResult>.Continuation) async {
+        await withTaskGroup(of: Void.self) { group in
+            for entry in entries {
+                if entry.method != "remove", !(await state.insert("\(entry.method) \(entry.url)")) {
+                    continue
+                }
+                switch entry.method {
+                case "api":
+                    group.addTask {
+                        guard await state.acquire() else { return }
+                        let start = Date()
+                        let data = await self.checkAPIMethod(entry: entry, payloads: payloads)
+                        await state.release()
+                        if let data = data {
+                            let latencyMs = Date().timeIntervalSince(start) * 1000
+                            continuation.yield(DetectionResult(url: entry.url, latencyMs: latencyMs, data: data))
+                        }
+                    }
+                case "file":
+                    guard recursionDepth < Config.maxListRecursionDepth else { continue }
+                    group.addTask {
+                        guard await state.acquire() else { return }
+                        let urls = await self.loadFileList(entry: entry)
+                        await state.release()
+                        if let urls = urls {
+                            await self.streamURLs(entries: urls, payloads: payloads, recursionDepth: recursionDepth + 1,
+                                                  state: state, continuation: continuation)
+                        }
+                    }
+                case "remove":
+                    await handleRemoveMethod(entry: entry)
+                default:
+                    Logger.shared.debug("Skipping \(entry.method) entry: \(entry.url)")
+                }
+            }
+        }
+    }
+
     /// Check single URL entry
-    private func checkURLEntry(_ entry: URLEntry, customData: String?, recursionDepth: Int) async -> [String: Any]? {
+    private func checkURLEntry(_ entry: URLEntry, payloads: PayloadPipeline<PreparedPayload>, recursionDepth: Int) async -> [String: Any]? {
         switch entry.method {
         case "api":
-            return await checkAPIMethod(entry: entry, customData: customData)
+            return await checkAPIMethod(entry: entry, payloads: payloads)
         case "file":
-            return await checkFileMethod(entry: entry, customData: customData, recursionDepth: recursionDepth)
+            return await checkFileMethod(entry: entry, payloads: payloads, recursionDepth: recursionDepth)
         case "navigate":
             handleNavigateMethod(entry: entry)
             // Navigate 执行后算成功，返回表示已引导用户
@@ -118,7 +256,25 @@ class FirewallDetector {
     }
 
     /// Check API method
-    private func checkAPIMethod(entry: URLEntry, customData: String?) async -> [String: Any]? {
+    private func checkAPIMethod(entry: URLEntry, payloads: PayloadPipeline<PreparedPayload>) async -> [String: Any]? {
+        let start = DiagnosticTrace.shared.now()
+        let result = await probeAPI(entry: entry, payloads: payloads)
+        DiagnosticTrace.shared.span("api", start: start, args: ["url": entry.url, "ok": result != nil])
+        return result
+    }
+
+    /// Payload pipeline for one round. clientId is read here, since payloads
+    /// are prepared off the caller's task.
+    private func makePayloads(customData: String?) -> PayloadPipeline<PreparedPayload> {
+        let clientId = self.clientId
+        return PayloadPipeline { [weak self] in
+            self?.preparePayload(customData: customData, clientId: clientId)
+        }
+    }
+
+    /// Build and encrypt a probe payload with a fresh nonce; runs ahead of the
+    /// probe that uses it (see PayloadPipeline)
+    private func preparePayload(customData: String?, clientId: String) -> PreparedPayload? {
         // Generate random nonce
         guard let nonceData = cryptoHelper.generateRandom(length: Config.nonceSize) else {
             Logger.shared.error("Failed to generate random nonce")
@@ -149,7 +305,8 @@ class FirewallDetector {
             "nonce": randomBase64,
             "os": osName,
             "app": appId,
-            "data": customData ?? clientDataStr
+            "data": customData ?? clientDataStr,
+            "cid": clientId
         ]
 
         guard let payloadBytes = try? JSONSerialization.data(withJSONObject: payload) else {
@@ -163,8 +320,38 @@ class FirewallDetector {
             return nil
         }
 
+        // Tag the request with a probe ID the server echoes back
+        let probeId = (cryptoHelper.generateRandom(length: Config.probeIdSize) ?? Data(UUID().uuidString.utf8))
+            .map { String(format: "%02x", $0) }
+            .joined()
+        return PreparedPayload(nonce: nonceData, encrypted: encryptedData, probeId: probeId)
+    }
+
+    private func probeAPI(entry: URLEntry, payloads: PayloadPipeline<PreparedPayload>) async -> [String: Any]? {
+        guard let prepared = await payloads.take() else {
+            return nil
+        }
+        let nonceData = prepared.nonce
+        let probeId = prepared.probeId
+
         // Send request
-        let response = await networkClient.post(url: entry.url, body: encryptedData)
+        let requestStart = DiagnosticTrace.shared.now()
+        let sent = Date()
+        let response = await networkClient.post(url: entry.url, body: prepared.encrypted, probeId: probeId, addrs: entry.validAddrs)
+        budget.record(startedAt: sent, bodyBytes: prepared.encrypted.count + response.body.utf8.count)
+        var requestArgs: [String: Any] = ["url": entry.url, "probe_id": probeId, "status": response.statusCode]
+        requestArgs["server_ms"] = response.timing?.serverMs
+        DiagnosticTrace.shared.span("request", start: requestStart, args: requestArgs)
+
+        if let timing = response.timing {
+            lastProbeTiming = timing
+            Logger.shared.debug(String(
+                format: "Probe %@: total=%.1fms server=%@ms network=%@ms",
+                timing.probeId, timing.totalMs,
+                timing.serverMs.map { String(format: "%.1f", $0) } ?? "-",
+                timing.networkMs.map { String(format: "%.1f", $0) } ?? "-"
+            ))
+        }
 
         if !response.success {
             Logger.shared.warning("API request failed: \(response.error ?? "unknown error")")
@@ -248,15 +435,29 @@ class FirewallDetector {
     }
 
     /// Check file method
-    private func checkFileMethod(entry: URLEntry, customData: String?, recursionDepth: Int) async -> [String: Any]? {
+    private func checkFileMethod(entry: URLEntry, payloads: PayloadPipeline<PreparedPayload>, recursionDepth: Int) async -> [String: Any]? {
         // Check recursion depth
         if recursionDepth >= Config.maxListRecursionDepth {
             Logger.shared.warning("Max recursion depth reached")
             return nil
         }
 
+        guard let urls = await loadFileList(entry: entry) else {
+            return nil
+        }
+
+        // Check nested URLs
+        return await checkURLsSequentially(entries: urls, payloads: payloads, recursionDepth: recursionDepth + 1)
+    }
+
+    /// Fetch and parse a file list, storing its URL when requested
+    private func loadFileList(entry: URLEntry) async -> [URLEntry]? {
         // Fetch file
+        let start = DiagnosticTrace.shared.now()
+        let sent = Date()
         let response = await networkClient.get(url: entry.url)
+        budget.record(startedAt: sent, bodyBytes: response.body.utf8.count)
+        DiagnosticTrace.shared.span("file", start: start, args: ["url": entry.url, "status": response.statusCode])
 
         if !response.success {
             Logger.shared.warning("File request failed: \(response.error ?? "unknown error")")
@@ -276,9 +477,7 @@ class FirewallDetector {
             let success = await urlManager.addURL(entry)
             Logger.shared.debug("Store file URL \(entry.url): \(success)")
         }
-
-        // Check nested URLs
-        return await checkURLsSequentially(entries: urls, customData: customData, recursionDepth: recursionDepth + 1)
+        return urls
     }
 
     /// Handle navigate method
@@ -309,7 +508,8 @@ class FirewallDetector {
             }
 
             let store = urlObj["store"] as? Bool ?? false
-            let entry = URLEntry(method: method, url: url, store: store)
+            let entry = URLEntry(method: method, url: url, store: store,
+                                 addrs: urlObj["addrs"] as? [String], addrsExpires: (urlObj["addrs_expires"] as? NSNumber)?.int64Value ?? 0)
 
             switch method {
             case "remove":
@@ -328,6 +528,24 @@ class FirewallDetector {
         }
     }
 
+    /// Load the persisted client ID, generating one on first use
+    private func loadOrCreateClientId() -> String {
+        if let data = storage.load(key: Self.clientIdKey),
+           let id = String(data: data, encoding: .utf8) {
+            return id
+        }
+
+        let random = cryptoHelper.generateRandom(length: Config.clientIdSize) ?? Data(UUID().uuidString.utf8)
+        let id = random.base64EncodedString()
+            .replacingOccurrences(of: "+", with: "-")
+            .replacingOccurrences(of: "/", with: "_")
+            .replacingOccurrences(of: "=", with: "")
+        if !storage.save(Data(id.utf8), forKey: Self.clientIdKey) {
+            Logger.shared.warning("Failed to persist client ID")
+        }
+        return id
+    }
+
     /// Parse URL list from text
     private func parseURLList(_ text: String) -> [URLEntry]? {
         // Try *PGFW* format first
@@ -354,7 +572,8 @@ class FirewallDetector {
                     continue
                 }
                 let store = urlObj["store"] as? Bool ?? false
-                entries.append(URLEntry(method: method, url: url, store: store))
+                entries.append(URLEntry(method: method, url: url, store: store,
+                                        addrs: urlObj["addrs"] as? [String], addrsExpires: (urlObj["addrs_expires"] as? NSNumber)?.int64Value ?? 0))
             }
             return entries
         }
@@ -394,3 +613,41 @@ class FirewallDetector {
         return decodedString
     }
 }
+
+/// Request slots and visited URLs shared by one results() pass
+private actor ResultsState {
+    private var available: Int
+    private var waiters: [CheckedContinuation<Void, Never>] = []
+    private var seen = Set<String>()
+
+    init(slots: Int) {
+        self.available = max(slots, 1)
+    }
+
+    /// Mark a URL visited, returning false if it already was
+    func insert(_ key: String) -> Bool {
+        return seen.insert(key).inserted
+    }
+
+    /// Wait for a request slot; returns false once the pass is cancelled
+    func acquire() async -> Bool {
+        if available > 0 {
+            available -= 1
+        } else {
+            await withCheckedContinuation { waiters.append($0) }
+        }
+        if Task.isCancelled {
+            release()
+            return false
+        }
+        return true
+    }
+
+    func release() {
+        if waiters.isEmpty {
+            available += 1
+        } else {
+            waiters.removeFirst().resume()
+        }
+    }
+}
@@ -14,6 +14,10 @@ public enum LogLevel: Int, Comparable {
 }
 
 /// Logger for PassGFW
+///
+/// Messages are autoclosures, so an interpolated message is only built when
+/// its level is logged (or, for warnings and errors, traced); a disabled
+/// level costs one comparison.
 class Logger {
     static let shared = Logger()
     
@@ -21,27 +25,40 @@ class Logger {
     var minLevel: LogLevel = .debug
     
     private let osLog = OSLog(subsystem: "com.passgfw", category: "PassGFW")
+    private let timestampFormatter = ISO8601DateFormatter()
     
     private init() {}
     
-    func debug(_ message: String) {
+    func isLoggable(_ level: LogLevel) -> Bool {
+        return isEnabled && level >= minLevel
+    }
+
+    func debug(_ message: @autoclosure () -> String) {
         log(message, level: .debug, osLogType: .debug)
     }
     
-    func info(_ message: String) {
+    func info(_ message: @autoclosure () -> String) {
         log(message, level: .info, osLogType: .info)
     }
     
-    func warning(_ message: String) {
+    func warning(_ message: @autoclosure () -> String) {
         log(message, level: .warning, osLogType: .default)
     }
     
-    func error(_ message: String) {
+    func error(_ message: @autoclosure () -> String) {
         log(message, level: .error, osLogType: .error)
     }
     
-    private func log(_ message: String, level: LogLevel, osLogType: OSLogType) {
-        guard isEnabled && level >= minLevel else { return }
+    private func log(_ message: () -> String, level: LogLevel, osLogType: OSLogType) {
+        let loggable = isLoggable(level)
+        // Warnings and errors are the failure reasons of a diagnostic trace
+        let traced = level >= .warning && DiagnosticTrace.isEnabled
+        guard loggable || traced else { return }
+        let text = message()
+        if traced {
+            DiagnosticTrace.shared.instant(level == .error ? "error" : "warning", args: ["message": text])
+        }
+        guard loggable else { return }
         
         let levelString: String
         switch level {
@@ -51,8 +68,8 @@ class Logger {
         case .error: levelString = "ERROR"
         }
         
-        let timestamp = ISO8601DateFormatter().string(from: Date())
-        let logMessage = "[\(timestamp)] [\(levelString)] \(message)"
+        let timestamp = timestampFormatter.string(from: Date())
+        let logMessage = "[\(timestamp)] [\(levelString)] \(text)"
         
         os_log("%{public}@", log: osLog, type: osLogType, logMessage)
         
@@ -6,6 +6,44 @@ struct HTTPResponse {
     let statusCode: Int
     let body: String
     let error: String?
+    var timing: ProbeTiming? = nil
+    var cancelled = false  // Ended by the caller, says nothing about the host
+}
+
+/// Probe timing: client-observed latency split into server and network time
+/// using the server's Server-Timing header
+public struct ProbeTiming {
+    public let url: String
+    public let probeId: String
+    public let totalMs: Double
+    public let serverStages: [String: Double]
+
+    /// Server-side time, or nil when the server sent no Server-Timing
+    public var serverMs: Double? {
+        return serverStages["total"]
+    }
+
+    /// Client-observed time not spent in the server
+    public var networkMs: Double? {
+        guard let serverMs = serverMs else { return nil }
+        return max(totalMs - serverMs, 0)
+    }
+
+    /// Parse a Server-Timing header value ("decrypt;dur=1.2, sign;dur=0.8")
+    static func parseServerTiming(_ header: String?) -> [String: Double] {
+        guard let header = header, !header.isEmpty else { return [:] }
+        var stages: [String: Double] = [:]
+        for metric in header.split(separator: ",") {
+            let parts = metric.split(separator: ";").map { $0.trimmingCharacters(in: .whitespaces) }
+            guard let name = parts.first, !name.isEmpty,
+                  let dur = parts.dropFirst().first(where: { $0.hasPrefix("dur=") }),
+                  let value = Double(dur.dropFirst(4)) else {
+                continue
+            }
+            stages[name] = value
+        }
+        return stages
+    }
 }
 
 /// Network Client for HTTP requests
@@ -16,40 +54,122 @@ class NetworkClient {
         self.timeout = timeout
     }
     
+    /// Whether a TCP connection to a domain is established within timeout
+    func canConnect(domain: String, timeout: TimeInterval) async -> Bool {
+        return await FastOpenTransport.shared.canConnect(domain: domain, timeout: timeout)
+    }
+
     /// POST request with raw binary data
-    func post(url: String, body: Data) async -> HTTPResponse {
+    /// - Parameter probeId: Optional probe ID, echoed by the server for correlation
+    /// - Parameter addrs: IP hints raced against the hostname's own resolution
+    func post(url: String, body: Data, probeId: String? = nil, addrs: [String] = []) async -> HTTPResponse {
         guard let requestURL = URL(string: url) else {
             return HTTPResponse(success: false, statusCode: 0, body: "", error: "Invalid URL")
         }
+        return await guarded(requestURL) {
+            await sendPost(url: url, requestURL: requestURL, body: body, probeId: probeId, addrs: addrs)
+        }
+    }
+
+    /// Run a request through its host's circuit breaker; a response with any
+    /// HTTP status means the host answered, and a cancelled one is not counted
+    private func guarded(_ requestURL: URL, _ send: () async -> HTTPResponse) async -> HTTPResponse {
+        let host = requestURL.host ?? ""
+        guard CircuitBreaker.shared.allow(host: host) else {
+            return HTTPResponse(success: false, statusCode: 0, body: "", error: "Circuit open for \(host)")
+        }
+        let response = await send()
+        if response.cancelled || Task.isCancelled {
+            return response
+        }
+        if response.statusCode != 0 {
+            CircuitBreaker.shared.recordSuccess(host: host)
+        } else {
+            CircuitBreaker.shared.recordFailure(host: host)
+        }
+        return response
+    }
+
+    private func sendPost(url: String, requestURL: URL, body: Data, probeId: String?, addrs: [String]) async -> HTTPResponse {
+
+        var headers = [
+            "Content-Type": "application/octet-stream",
+            "User-Agent": "PassGFW/2.2 Swift"
+        ]
+        if let probeId = probeId {
+            headers[Config.probeIdHeader] = probeId
+        }
+
+        // Both attempts share one deadline, so a fallback never restarts the clock
+        let deadline = DispatchTime.now().uptimeNanoseconds + UInt64(timeout * 1_000_000_000)
+
+        // URLSession has no TCP Fast Open control and cannot dial an address;
+        // the first request to a host, and every request with IP hints, goes
+        // over Network.framework, later ones reuse URLSession's pool
+        if !addrs.isEmpty || (Config.tcpFastOpen && FastOpenTransport.shared.claimFirstRequest(to: requestURL)) {
+            let start = DispatchTime.now().uptimeNanoseconds
+            if let response = await FastOpenTransport.shared.post(url: requestURL, body: body, headers: headers,
+                                                                  timeout: timeout, addrs: addrs) {
+                let totalMs = Double(DispatchTime.now().uptimeNanoseconds - start) / 1_000_000
+                return makeResponse(url: url, statusCode: response.statusCode, data: response.body,
+                                    serverTiming: response.headers["server-timing"], probeId: probeId, totalMs: totalMs)
+            }
+            Logger.shared.debug("Fast Open request failed, retrying with URLSession: \(url)")
+        }
+
+        let now = DispatchTime.now().uptimeNanoseconds
+        guard now < deadline else {
+            return HTTPResponse(success: false, statusCode: 0, body: "", error: "Request timed out")
+        }
 
         var request = URLRequest(url: requestURL)
         request.httpMethod = "POST"
-        request.setValue("application/octet-stream", forHTTPHeaderField: "Content-Type")
-        request.setValue("PassGFW/2.2 Swift", forHTTPHeaderField: "User-Agent")
-        request.timeoutInterval = timeout
+        for (name, value) in headers {
+            request.setValue(value, forHTTPHeaderField: name)
+        }
+        request.timeoutInterval = TimeInterval(deadline - now) / 1_000_000_000
         request.httpBody = body
 
         do {
+            let start = DispatchTime.now().uptimeNanoseconds
             let (data, response) = try await URLSession.shared.data(for: request)
+            let totalMs = Double(DispatchTime.now().uptimeNanoseconds - start) / 1_000_000
 
             guard let httpResponse = response as? HTTPURLResponse else {
                 return HTTPResponse(success: false, statusCode: 0, body: "", error: "Invalid response")
             }
 
-            let body = String(data: data, encoding: .utf8) ?? ""
-            let success = (200...299).contains(httpResponse.statusCode)
-
-            return HTTPResponse(
-                success: success,
-                statusCode: httpResponse.statusCode,
-                body: body,
-                error: success ? nil : "HTTP \(httpResponse.statusCode)"
-            )
+            return makeResponse(url: url, statusCode: httpResponse.statusCode, data: data,
+                                serverTiming: httpResponse.value(forHTTPHeaderField: "Server-Timing"), probeId: probeId, totalMs: totalMs)
         } catch {
-            return HTTPResponse(success: false, statusCode: 0, body: "", error: error.localizedDescription)
+            return HTTPResponse(success: false, statusCode: 0, body: "", error: error.localizedDescription,
+                                cancelled: NetworkClient.isCancellation(error))
         }
     }
 
+    private static func isCancellation(_ error: Error) -> Bool {
+        return error is CancellationError || (error as? URLError)?.code == .cancelled
+    }
+
+    private func makeResponse(url: String, statusCode: Int, data: Data, serverTiming: String?,
+                              probeId: String?, totalMs: Double) -> HTTPResponse {
+        let success = (200...299).contains(statusCode)
+        return HTTPResponse(
+            success: success,
+            statusCode: statusCode,
+            body: String(data: data, encoding: .utf8) ?? "",
+            error: success ? nil : "HTTP \(statusCode)",
+            timing: probeId.map {
+                ProbeTiming(
+                    url: url,
+                    probeId: $0,
+                    totalMs: totalMs,
+                    serverStages: ProbeTiming.parseServerTiming(serverTiming)
+                )
+            }
+        )
+    }
+
     /// POST request with JSON string (deprecated, use post(url:body:) instead)
     func post(url: String, jsonBody: String) async -> HTTPResponse {
         guard let bodyData = jsonBody.data(using: .utf8) else {
@@ -63,7 +183,12 @@ class NetworkClient {
         guard let requestURL = URL(string: url) else {
             return HTTPResponse(success: false, statusCode: 0, body: "", error: "Invalid URL")
         }
-        
+        return await guarded(requestURL) {
+            await sendGet(requestURL: requestURL)
+        }
+    }
+
+    private func sendGet(requestURL: URL) async -> HTTPResponse {
         var request = URLRequest(url: requestURL)
         request.httpMethod = "GET"
         request.setValue("PassGFW/1.0 Swift", forHTTPHeaderField: "User-Agent")
@@ -86,7 +211,8 @@ class NetworkClient {
                 error: success ? nil : "HTTP \(httpResponse.statusCode)"
             )
         } catch {
-            return HTTPResponse(success: false, statusCode: 0, body: "", error: error.localizedDescription)
+            return HTTPResponse(success: false, statusCode: 0, body: "", error: error.localizedDescription,
+                                cancelled: NetworkClient.isCancellation(error))
         }
     }
 }
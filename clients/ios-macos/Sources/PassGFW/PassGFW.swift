@@ -20,12 +20,84 @@ public class PassGFWClient {
         return await detector.getDomains(retry: retry, customData: customData)
     }
 
+    /// Probe every URL once, yielding each verified answer with its latency as
+    /// probes complete. Unlike getDomains this does not retry or use the cache.
+    /// - Parameter customData: Optional custom data to send with requests
+    /// - Returns: Answers in completion order; ending the iteration cancels the remaining probes
+    public func results(customData: String? = nil) -> AsyncStream<DetectionResult> {
+        return detector.results(customData: customData)
+    }
+
+    /// First verified answer of one pass over the URL list
+    /// - Parameter customData: Optional custom data to send with requests
+    /// - Returns: The answer, or nil if every URL failed
+    public func first(customData: String? = nil) async -> DetectionResult? {
+        for await result in results(customData: customData) {
+            return result
+        }
+        return nil
+    }
+
+    /// Collect up to n verified answers for at most `within` seconds; the remaining probes are cancelled
+    /// - Parameters:
+    ///   - n: Number of answers wanted
+    ///   - within: Time limit in seconds
+    ///   - customData: Optional custom data to send with requests
+    /// - Returns: Answers sorted by latency, fastest first, to fail over in order
+    public func bestOf(_ n: Int, within: TimeInterval, customData: String? = nil) async -> [DetectionResult] {
+        guard n > 0 else { return [] }
+        let stream = results(customData: customData)
+        let answers = await withTaskGroup(of: [DetectionResult]?.self) { group -> [DetectionResult] in
+            group.addTask {
+                var answers: [DetectionResult] = []
+                for await result in stream {
+                    answers.append(result)
+                    if answers.count >= n { break }
+                }
+                return answers
+            }
+            group.addTask {
+                try? await Task.sleep(nanoseconds: UInt64(within * 1_000_000_000))
+                return nil
+            }
+            // Whichever finishes first ends the pass
+            let first = await group.next() ?? nil
+            group.cancelAll()
+            if let answers = first {
+                return answers
+            }
+            let collected = await group.next()
+            return (collected ?? nil) ?? []
+        }
+        return answers.sorted { $0.latencyMs < $1.latencyMs }
+    }
+
     /// Get the last error message
     /// - Returns: Last error message, or nil if no error
     public func getLastError() -> String? {
         return detector.getLastError()
     }
 
+    /// Get timing of the most recent API probe
+    /// - Returns: Client latency split into server and network time, or nil if no probe ran
+    public func getLastProbeTiming() -> ProbeTiming? {
+        return detector.getLastProbeTiming()
+    }
+
+    /// Get the radio and data budget of the retry loop
+    /// - Returns: Requests, bytes and radio wake-ups over the last budgetWindow, the limits
+    ///   for the current network and app state, and the wait before the next detection round
+    public func getBudgetState() -> BudgetState {
+        return detector.getBudgetState()
+    }
+
+    /// Export recent detection events (probes, phase timings, failure reasons,
+    /// URL list changes) as Chrome trace-event JSON, to attach to a bug report
+    /// and open in chrome://tracing or ui.perfetto.dev
+    public func exportTrace() -> String {
+        return DiagnosticTrace.shared.export()
+    }
+
     /// Enable or disable logging
     /// - Parameter enabled: Whether to enable logging
     public func setLoggingEnabled(_ enabled: Bool) {
@@ -0,0 +1,36 @@
+import Foundation
+
+/// Probe payloads prepared ahead of use
+///
+/// take() hands out the oldest payload and keeps payloadPrefetch more in
+/// preparation on detached tasks, so nonce generation and encryption for the
+/// next probes run while earlier probes wait on the network. A pipeline serves
+/// one detection round and every payload is used at most once; cancel() drops
+/// the ones the round did not need.
+final class PayloadPipeline<T: Sendable> {
+    private let prepare: () -> T?
+    private let lock = NSLock()
+    private var ahead: [Task<T?, Never>] = []
+
+    init(prepare: @escaping () -> T?) {
+        self.prepare = prepare
+    }
+
+    func take() async -> T? {
+        lock.lock()
+        while ahead.count <= Config.payloadPrefetch {
+            let prepare = self.prepare
+            ahead.append(Task.detached { prepare() })
+        }
+        let next = ahead.removeFirst()
+        lock.unlock()
+        return await next.value
+    }
+
+    func cancel() {
+        lock.lock()
+        ahead.forEach { $0.cancel() }
+        ahead.removeAll()
+        lock.unlock()
+    }
+}
@@ -46,6 +46,7 @@ actor URLManager {
 
         // 添加新 URL
         urls.append(entry)
+        DiagnosticTrace.shared.instant("store", args: ["url": entry.url, "method": entry.method])
         return saveURLs(urls)
     }
 
@@ -56,6 +57,7 @@ actor URLManager {
         guard var urls = loadURLs() else { return false }
 
         urls.removeAll { $0.url == url }
+        DiagnosticTrace.shared.instant("remove", args: ["url": url])
         return saveURLs(urls)
     }
 
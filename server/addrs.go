@@ -0,0 +1,115 @@
+package main
+
+import (
+	"context"
+	"net"
+	"net/url"
+	"sync"
+	"time"
+)
+
+// Address hints. Entries may carry the IPs of their host so the SDKs can
+// connect without waiting on DNS, which on filtered networks is often slow
+// or polluted; the SDKs still resolve in parallel and keep SNI and Host on
+// the hostname. Hints come from the server's resolver, so hosts behind
+// GeoDNS should be left without them.
+
+const (
+	addrHintTTL     = 24 * time.Hour
+	addrHintMaxTTL  = 30 * 24 * time.Hour
+	addrHintTimeout = 5 * time.Second
+	addrHintMax     = 4 // Addresses kept per entry
+)
+
+type addrHintResult struct {
+	Host  string   `json:"host"`
+	Addrs []string `json:"addrs,omitempty"`
+	Error string   `json:"error,omitempty"`
+}
+
+// resolveAddrHints resolves the hosts of the api and file entries in
+// parallel and sets their hints; entries whose host fails keep none
+func resolveAddrHints(ctx context.Context, urls []URLEntry, ttlSeconds int) []addrHintResult {
+	ttl := addrHintTTL
+	if ttlSeconds > 0 {
+		ttl = min(time.Duration(ttlSeconds)*time.Second, addrHintMaxTTL)
+	}
+	expires := time.Now().Add(ttl).Unix()
+
+	var hosts []string
+	index := make(map[string]int)
+	for _, u := range urls {
+		host := hintHost(u)
+		if _, seen := index[host]; host != "" && !seen {
+			index[host] = len(hosts)
+			hosts = append(hosts, host)
+		}
+	}
+
+	results := make([]addrHintResult, len(hosts))
+	var wg sync.WaitGroup
+	for i, host := range hosts {
+		wg.Add(1)
+		go func(r *addrHintResult, host string) {
+			defer wg.Done()
+			r.Host = host
+			lookupCtx, cancel := context.WithTimeout(ctx, addrHintTimeout)
+			defer cancel()
+			ips, err := net.DefaultResolver.LookupIPAddr(lookupCtx, host)
+			if err != nil {
+				r.Error = err.Error()
+				return
+			}
+			r.Addrs = interleaveAddrs(ips)
+		}(&results[i], host)
+	}
+	wg.Wait()
+
+	for i := range urls {
+		urls[i].Addrs, urls[i].AddrsExpires = nil, 0
+		if host := hintHost(urls[i]); host != "" {
+			if addrs := results[index[host]].Addrs; len(addrs) > 0 {
+				urls[i].Addrs, urls[i].AddrsExpires = addrs, expires
+			}
+		}
+	}
+	return results
+}
+
+// hintHost is the hostname an entry would resolve, or "" when it has none
+func hintHost(u URLEntry) string {
+	if u.Method != "api" && u.Method != "file" {
+		return ""
+	}
+	parsed, err := url.Parse(u.URL)
+	if err != nil || (parsed.Scheme != "http" && parsed.Scheme != "https") {
+		return ""
+	}
+	host := parsed.Hostname()
+	if host == "" || net.ParseIP(host) != nil {
+		return ""
+	}
+	return host
+}
+
+// interleaveAddrs alternates IPv6 and IPv4 (RFC 8305) up to addrHintMax
+func interleaveAddrs(ips []net.IPAddr) []string {
+	var v6, v4 []string
+	for _, ip := range ips {
+		if ip.IP.To4() != nil {
+			v4 = append(v4, ip.IP.String())
+		} else if ip.Zone == "" {
+			v6 = append(v6, ip.IP.String())
+		}
+	}
+	var out []string
+	for i := 0; len(out) < addrHintMax && (i < len(v6) || i < len(v4)); i++ {
+		if i < len(v6) {
+			out = append(out, v6[i])
+		}
+		if i < len(v4) && len(out) < addrHintMax {
+			out = append(out, v4[i])
+		}
+	}
+	return out
+}
@@ -0,0 +1,355 @@
+package main
+
+import (
+	"bytes"
+	"compress/gzip"
+	"context"
+	"crypto/sha256"
+	"encoding/base64"
+	"encoding/hex"
+	"encoding/json"
+	"fmt"
+	"io"
+	"log"
+	"net/http"
+	"net/url"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"time"
+
+	"github.com/gin-gonic/gin"
+)
+
+// List aggregation. Clients walk nested file lists one round trip per level;
+// the server instead fetches the configured upstream lists periodically,
+// resolves their nesting, dedupes the entries and publishes a single flat
+// *PGFW* list with a precompressed gzip variant.
+
+var (
+	aggregateLists    string        // Comma-separated upstream list URLs (empty disables)
+	aggregateInterval time.Duration // Refresh interval
+	aggregateDepth    int           // Nesting levels resolved, like MAX_LIST_RECURSION_DEPTH
+	aggregatePath     string        // Public path of the flattened list
+)
+
+const (
+	aggregateFetchers = 8
+	aggregateMaxBody  = 1 << 20
+	urlEntryBytes     = 96 // Rough in-memory overhead of one URLEntry, for the memory governor
+)
+
+// aggregatedList is one published flattening, never modified once stored
+type aggregatedList struct {
+	Body    []byte // *PGFW* text
+	Gzip    []byte
+	ETag    string
+	Entries int
+}
+
+var aggregated atomic.Pointer[aggregatedList]
+
+type listAggregator struct {
+	upstreams []string
+	client    *http.Client
+
+	mu       sync.Mutex
+	lastGood map[string][]URLEntry // Served again when a refetch fails
+	held     atomic.Int64          // Size of lastGood plus the published gzip variant
+}
+
+func startAggregator() error {
+	if aggregateLists == "" {
+		return nil
+	}
+	a := &listAggregator{
+		client:   &http.Client{Timeout: 10 * time.Second},
+		lastGood: make(map[string][]URLEntry),
+	}
+	for _, raw := range strings.Split(aggregateLists, ",") {
+		raw = strings.TrimSpace(raw)
+		if u, err := url.Parse(raw); err != nil || (u.Scheme != "http" && u.Scheme != "https") || u.Host == "" {
+			return fmt.Errorf("invalid upstream list %q", raw)
+		}
+		a.upstreams = append(a.upstreams, raw)
+	}
+	if aggregateDepth < 1 {
+		return fmt.Errorf("-aggregate-depth must be at least 1")
+	}
+	governor.register("aggregate", a)
+
+	go func() {
+		for {
+			a.refresh(context.Background())
+			time.Sleep(aggregateInterval)
+		}
+	}()
+	return nil
+}
+
+func (a *listAggregator) refresh(ctx context.Context) {
+	start := time.Now()
+	lists, failed := a.fetchAll(ctx)
+
+	roots := make([]URLEntry, len(a.upstreams))
+	for i, u := range a.upstreams {
+		roots[i] = URLEntry{Method: "file", URL: u}
+	}
+	f := flattener{lists: lists, index: make(map[string]int), open: make(map[string]bool)}
+	f.walk(roots)
+
+	list, err := encodeAggregated(f.out)
+	if err != nil {
+		log.Printf("Aggregator: %v", err)
+		return
+	}
+	// A gzip variant dropped by Evict is restored on the next refresh
+	if prev := aggregated.Load(); prev == nil || prev.ETag != list.ETag || prev.Gzip == nil {
+		aggregated.Store(list)
+	}
+	a.account()
+	governor.grew()
+	log.Printf("Aggregator: %d entries from %d lists (%d failed) in %v",
+		list.Entries, len(lists), failed, time.Since(start).Round(time.Millisecond))
+}
+
+// fetchAll fetches the upstreams and the file lists they nest, one level at
+// a time with every list of a level in parallel, down to aggregateDepth
+func (a *listAggregator) fetchAll(ctx context.Context) (lists map[string][]URLEntry, failed int) {
+	lists = make(map[string][]URLEntry)
+	seen := make(map[string]bool)
+	frontier := a.upstreams
+	for _, u := range frontier {
+		seen[u] = true
+	}
+
+	for depth := 0; depth < aggregateDepth && len(frontier) > 0; depth++ {
+		fetched := make([][]URLEntry, len(frontier))
+		errs := make([]error, len(frontier))
+		slots := make(chan struct{}, aggregateFetchers)
+		var wg sync.WaitGroup
+		for i, u := range frontier {
+			wg.Add(1)
+			go func(i int, u string) {
+				defer wg.Done()
+				slots <- struct{}{}
+				defer func() { <-slots }()
+				fetched[i], errs[i] = a.fetch(ctx, u)
+			}(i, u)
+		}
+		wg.Wait()
+
+		var next []string
+		for i, u := range frontier {
+			entries := fetched[i]
+			if errs[i] != nil {
+				failed++
+				log.Printf("Aggregator: %s: %v", u, errs[i])
+				a.mu.Lock()
+				entries = a.lastGood[u]
+				a.mu.Unlock()
+				if entries == nil {
+					continue
+				}
+			} else {
+				a.mu.Lock()
+				a.lastGood[u] = entries
+				a.mu.Unlock()
+			}
+			lists[u] = entries
+			for _, e := range entries {
+				if e.Method == "file" && !seen[e.URL] {
+					seen[e.URL] = true
+					next = append(next, e.URL)
+				}
+			}
+		}
+		frontier = next
+	}
+
+	// Lists no longer reached from the upstreams are never served again
+	a.mu.Lock()
+	for u := range a.lastGood {
+		if !seen[u] {
+			delete(a.lastGood, u)
+		}
+	}
+	a.mu.Unlock()
+	return lists, failed
+}
+
+func entriesSize(entries []URLEntry) int64 {
+	size := int64(len(entries) * urlEntryBytes)
+	for _, e := range entries {
+		size += int64(len(e.Method) + len(e.URL))
+		for _, addr := range e.Addrs {
+			size += int64(len(addr))
+		}
+	}
+	return size
+}
+
+// account recomputes held after lastGood or the published list changed
+func (a *listAggregator) account() {
+	a.mu.Lock()
+	defer a.mu.Unlock()
+	var size int64
+	for _, entries := range a.lastGood {
+		size += entriesSize(entries)
+	}
+	if list := aggregated.Load(); list != nil {
+		size += int64(len(list.Gzip))
+	}
+	a.held.Store(size)
+}
+
+// MemoryUsage counts what Evict can give back; the published body itself
+// is always kept
+func (a *listAggregator) MemoryUsage() int64 {
+	return a.held.Load()
+}
+
+// Evict drops the gzip variant first (served uncompressed until the next
+// refresh), then fallback lists, which only matter if a refetch fails
+func (a *listAggregator) Evict(n int64) int64 {
+	var freed int64
+	if list := aggregated.Load(); list != nil && list.Gzip != nil {
+		stripped := *list
+		stripped.Gzip = nil
+		if aggregated.CompareAndSwap(list, &stripped) {
+			freed += int64(len(list.Gzip))
+		}
+	}
+	a.mu.Lock()
+	for u, entries := range a.lastGood {
+		if freed >= n {
+			break
+		}
+		freed += entriesSize(entries)
+		delete(a.lastGood, u)
+	}
+	a.mu.Unlock()
+	a.account()
+	return freed
+}
+
+func (a *listAggregator) fetch(ctx context.Context, u string) ([]URLEntry, error) {
+	req, err := http.NewRequestWithContext(ctx, http.MethodGet, u, nil)
+	if err != nil {
+		return nil, err
+	}
+	resp, err := a.client.Do(req)
+	if err != nil {
+		return nil, err
+	}
+	defer resp.Body.Close()
+	if resp.StatusCode != http.StatusOK {
+		return nil, fmt.Errorf("HTTP %d", resp.StatusCode)
+	}
+	raw, err := io.ReadAll(io.LimitReader(resp.Body, aggregateMaxBody))
+	if err != nil {
+		return nil, err
+	}
+	entries := parseURLList(string(raw))
+	if len(entries) == 0 {
+		return nil, fmt.Errorf("no URL list found")
+	}
+	return entries, nil
+}
+
+// flattener replaces each resolved file entry by its contents, in the order
+// a client would visit them, keeping the first of duplicate entries
+type flattener struct {
+	lists map[string][]URLEntry
+	out   []URLEntry
+	index map[string]int  // method + URL -> position in out
+	open  map[string]bool // Lists being expanded, guards against cycles
+}
+
+func (f *flattener) walk(entries []URLEntry) {
+	for _, e := range entries {
+		if sub, ok := f.lists[e.URL]; ok && e.Method == "file" {
+			if f.open[e.URL] {
+				continue // A cycle; its entries are already being emitted
+			}
+			f.open[e.URL] = true
+			f.walk(sub)
+			delete(f.open, e.URL)
+			// The client only stores a file URL after fetching it, so a stored
+			// list stays in the output, reached once its contents all failed
+			if !e.Store {
+				continue
+			}
+		}
+		f.add(e)
+	}
+}
+
+func (f *flattener) add(e URLEntry) {
+	key := e.Method + " " + e.URL
+	if i, ok := f.index[key]; ok {
+		f.out[i].Store = f.out[i].Store || e.Store
+		return
+	}
+	f.index[key] = len(f.out)
+	f.out = append(f.out, e)
+}
+
+func encodeAggregated(entries []URLEntry) (*aggregatedList, error) {
+	if entries == nil {
+		entries = []URLEntry{}
+	}
+	jsonData, err := json.Marshal(entries)
+	if err != nil {
+		return nil, err
+	}
+	body := []byte("*PGFW*" + base64.StdEncoding.EncodeToString(jsonData) + "*PGFW*")
+
+	var gz bytes.Buffer
+	w, _ := gzip.NewWriterLevel(&gz, gzip.BestCompression)
+	w.Write(body)
+	if err := w.Close(); err != nil {
+		return nil, err
+	}
+	sum := sha256.Sum256(body)
+	return &aggregatedList{
+		Body:    body,
+		Gzip:    gz.Bytes(),
+		ETag:    `W/"` + hex.EncodeToString(sum[:8]) + `"`,
+		Entries: len(entries),
+	}, nil
+}
+
+// Serve the flattened list, gzip-encoded when the client accepts it
+func handleAggregatedList(c *gin.Context) {
+	list := aggregated.Load()
+	if list == nil {
+		c.JSON(http.StatusServiceUnavailable, ErrorResponse{Error: "List not ready"})
+		return
+	}
+	c.Header("ETag", list.ETag)
+	c.Header("Vary", "Accept-Encoding")
+	c.Header("Cache-Control", fmt.Sprintf("public, max-age=%d", int(aggregateInterval.Seconds())))
+	if c.GetHeader("If-None-Match") == list.ETag {
+		c.Status(http.StatusNotModified)
+		return
+	}
+	body := list.Body
+	if list.Gzip != nil && acceptsGzip(c.GetHeader("Accept-Encoding")) {
+		c.Header("Content-Encoding", "gzip")
+		body = list.Gzip
+	}
+	c.Data(http.StatusOK, "text/plain; charset=utf-8", body)
+}
+
+func acceptsGzip(header string) bool {
+	for _, part := range strings.Split(header, ",") {
+		coding, params, _ := strings.Cut(strings.TrimSpace(part), ";")
+		if coding != "gzip" && coding != "*" {
+			continue
+		}
+		q := strings.ReplaceAll(params, " ", "")
+		return q != "q=0" && q != "q=0.0" && q != "q=0.00" && q != "q=0.000"
+	}
+	return false
+}
@@ -0,0 +1,8 @@
+//go:build !unix
+
+package main
+
+// setListenBacklog is a no-op: the accept queue cannot be resized after listen here
+func setListenBacklog(fd uintptr, n int) error {
+	return nil
+}
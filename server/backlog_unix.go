@@ -0,0 +1,10 @@
+//go:build unix
+
+package main
+
+import "syscall"
+
+// setListenBacklog calls listen(2) again on a listening socket to resize its accept queue
+func setListenBacklog(fd uintptr, n int) error {
+	return syscall.Listen(int(fd), n)
+}
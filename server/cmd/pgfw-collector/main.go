@@ -0,0 +1,169 @@
+// pgfw-collector is a file-backed stand-in for an OpenTelemetry collector.
+// It accepts OTLP/JSON trace exports on POST /v1/traces and appends one
+// flattened JSON line per span to a file, so passgfw-server tracing can be
+// exercised without any external service.
+//
+// Usage:
+//
+//	pgfw-collector [-listen 127.0.0.1:4318] [-out traces.jsonl]
+//	passgfw-server -otlp-endpoint=http://127.0.0.1:4318 -trace-sample=1
+package main
+
+import (
+	"bufio"
+	"encoding/json"
+	"flag"
+	"io"
+	"log"
+	"net/http"
+	"os"
+	"strconv"
+	"strings"
+	"sync"
+)
+
+// Subset of the OTLP/JSON trace request that the server emits
+type exportRequest struct {
+	ResourceSpans []struct {
+		Resource struct {
+			Attributes []attribute `json:"attributes"`
+		} `json:"resource"`
+		ScopeSpans []struct {
+			Spans []struct {
+				TraceID      string      `json:"traceId"`
+				SpanID       string      `json:"spanId"`
+				ParentSpanID string      `json:"parentSpanId"`
+				Name         string      `json:"name"`
+				Start        string      `json:"startTimeUnixNano"`
+				End          string      `json:"endTimeUnixNano"`
+				Attributes   []attribute `json:"attributes"`
+				Status       struct {
+					Code    int    `json:"code"`
+					Message string `json:"message"`
+				} `json:"status"`
+			} `json:"spans"`
+		} `json:"scopeSpans"`
+	} `json:"resourceSpans"`
+}
+
+type attribute struct {
+	Key   string `json:"key"`
+	Value struct {
+		String *string  `json:"stringValue"`
+		Int    *string  `json:"intValue"`
+		Double *float64 `json:"doubleValue"`
+		Bool   *bool    `json:"boolValue"`
+	} `json:"value"`
+}
+
+// spanLine is one line of the output file
+type spanLine struct {
+	Service    string         `json:"service"`
+	TraceID    string         `json:"trace_id"`
+	SpanID     string         `json:"span_id"`
+	ParentID   string         `json:"parent_id,omitempty"`
+	Name       string         `json:"name"`
+	Start      int64          `json:"start_unix_nano"`
+	DurationMs float64        `json:"duration_ms"`
+	Error      string         `json:"error,omitempty"`
+	Attributes map[string]any `json:"attributes,omitempty"`
+}
+
+func main() {
+	listen := flag.String("listen", "127.0.0.1:4318", "Listen address (OTLP/HTTP default port)")
+	out := flag.String("out", "traces.jsonl", "Output file, one span per line")
+	flag.Parse()
+
+	f, err := os.OpenFile(*out, os.O_CREATE|os.O_WRONLY|os.O_APPEND, 0o644)
+	if err != nil {
+		log.Fatalf("Open %s: %v", *out, err)
+	}
+	defer f.Close()
+
+	var mu sync.Mutex
+	w := bufio.NewWriter(f)
+
+	http.HandleFunc("/v1/traces", func(rw http.ResponseWriter, r *http.Request) {
+		if r.Method != http.MethodPost {
+			http.Error(rw, "POST only", http.StatusMethodNotAllowed)
+			return
+		}
+		if !strings.HasPrefix(r.Header.Get("Content-Type"), "application/json") {
+			http.Error(rw, "only OTLP/JSON is supported", http.StatusUnsupportedMediaType)
+			return
+		}
+
+		var req exportRequest
+		if err := json.NewDecoder(io.LimitReader(r.Body, 16<<20)).Decode(&req); err != nil {
+			http.Error(rw, err.Error(), http.StatusBadRequest)
+			return
+		}
+
+		mu.Lock()
+		defer mu.Unlock()
+		enc := json.NewEncoder(w)
+		spans := 0
+		for _, rs := range req.ResourceSpans {
+			service, _ := attributeMap(rs.Resource.Attributes)["service.name"].(string)
+			for _, ss := range rs.ScopeSpans {
+				for _, s := range ss.Spans {
+					start, _ := strconv.ParseInt(s.Start, 10, 64)
+					end, _ := strconv.ParseInt(s.End, 10, 64)
+					line := spanLine{
+						Service:    service,
+						TraceID:    s.TraceID,
+						SpanID:     s.SpanID,
+						ParentID:   s.ParentSpanID,
+						Name:       s.Name,
+						Start:      start,
+						DurationMs: float64(end-start) / 1e6,
+						Attributes: attributeMap(s.Attributes),
+					}
+					if s.Status.Code == 2 {
+						line.Error = s.Status.Message
+						if line.Error == "" {
+							line.Error = "error"
+						}
+					}
+					if err := enc.Encode(line); err != nil {
+						http.Error(rw, err.Error(), http.StatusInternalServerError)
+						return
+					}
+					spans++
+				}
+			}
+		}
+		if err := w.Flush(); err != nil {
+			http.Error(rw, err.Error(), http.StatusInternalServerError)
+			return
+		}
+
+		log.Printf("Received %d spans", spans)
+		rw.Header().Set("Content-Type", "application/json")
+		rw.Write([]byte("{}"))
+	})
+
+	log.Printf("Collector: %s -> %s", *listen, *out)
+	log.Fatal(http.ListenAndServe(*listen, nil))
+}
+
+func attributeMap(attrs []attribute) map[string]any {
+	if len(attrs) == 0 {
+		return nil
+	}
+	m := make(map[string]any, len(attrs))
+	for _, a := range attrs {
+		switch v := a.Value; {
+		case v.String != nil:
+			m[a.Key] = *v.String
+		case v.Int != nil:
+			n, _ := strconv.ParseInt(*v.Int, 10, 64)
+			m[a.Key] = n
+		case v.Double != nil:
+			m[a.Key] = *v.Double
+		case v.Bool != nil:
+			m[a.Key] = *v.Bool
+		}
+	}
+	return m
+}
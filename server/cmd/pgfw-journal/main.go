@@ -0,0 +1,281 @@
+// pgfw-journal scans request journal segments written by passgfw-server
+// (-journal-dir) and prints latency percentiles, result and OS breakdowns,
+// top-N apps and a per-interval time series.
+//
+// Usage:
+//
+//	pgfw-journal -dir ./journal [-since 1h] [-bucket 1m] [-top 10]
+package main
+
+import (
+	"bytes"
+	"encoding/binary"
+	"flag"
+	"fmt"
+	"log"
+	"math"
+	"math/bits"
+	"os"
+	"path/filepath"
+	"sort"
+	"time"
+)
+
+// Record layout, see server/journal.go
+const (
+	magic      = "PGFWJRN1"
+	recordSize = 128
+)
+
+var resultNames = []string{"ok", "bad_body", "decrypt", "bad_payload", "shed", "internal"}
+var osNames = []string{"unknown", "android", "ios", "macos", "harmonyos", "other"}
+
+// histogram is a log-linear latency histogram over microseconds:
+// 8 sub-buckets per power of two, so percentiles are within ~12%.
+type histogram struct {
+	counts [64 * 8]uint64
+	total  uint64
+}
+
+func (h *histogram) add(us uint32) {
+	v := uint64(us) + 1
+	exp := 63 - bits.LeadingZeros64(v)
+	sub := 0
+	if exp >= 3 {
+		sub = int(v>>(exp-3)) & 7
+	} else {
+		sub = int(v<<(3-exp)) & 7
+	}
+	h.counts[exp*8+sub]++
+	h.total++
+}
+
+func (h *histogram) quantile(q float64) float64 {
+	if h.total == 0 {
+		return 0
+	}
+	rank := uint64(math.Ceil(q * float64(h.total)))
+	var seen uint64
+	for i, n := range h.counts {
+		seen += n
+		if seen >= rank {
+			exp, sub := i/8, i%8
+			upper := float64(uint64(8+sub+1)<<exp) / 8
+			return (upper - 1) / 1000 // ms
+		}
+	}
+	return 0
+}
+
+type bucket struct {
+	count uint64
+	errs  uint64
+	total histogram
+}
+
+type stats struct {
+	records uint64
+	first   int64
+	last    int64
+	total   histogram
+	queue   histogram
+	decrypt histogram
+	route   histogram
+	sign    histogram
+	results [8]uint64
+	oses    [8]uint64
+	apps    map[string]uint64
+	domains map[string]uint64
+	series  map[int64]*bucket
+}
+
+func main() {
+	dir := flag.String("dir", "journal", "Journal directory")
+	since := flag.Duration("since", 0, "Only records newer than this (0 = all)")
+	interval := flag.Duration("bucket", time.Minute, "Time series bucket width (0 disables)")
+	top := flag.Int("top", 10, "Number of apps/domains to list")
+	flag.Parse()
+
+	segments, err := filepath.Glob(filepath.Join(*dir, "journal-*.seg"))
+	if err != nil || len(segments) == 0 {
+		log.Fatalf("No segments in %s", *dir)
+	}
+	sort.Strings(segments)
+
+	var cutoff int64
+	if *since > 0 {
+		cutoff = time.Now().Add(-*since).UnixNano()
+	}
+
+	s := &stats{apps: map[string]uint64{}, domains: map[string]uint64{}, series: map[int64]*bucket{}}
+	started := time.Now()
+	var scanned int64
+	for _, path := range segments {
+		n, err := scanSegment(path, cutoff, int64(*interval), s)
+		if err != nil {
+			log.Printf("%s: %v", path, err)
+		}
+		scanned += n
+	}
+	elapsed := time.Since(started)
+
+	report(s, *top, *interval)
+	fmt.Printf("\nScanned %d segments, %.1f MiB in %v (%.0f MiB/s)\n",
+		len(segments), float64(scanned)/(1<<20), elapsed.Round(time.Millisecond),
+		float64(scanned)/(1<<20)/elapsed.Seconds())
+}
+
+// scanSegment maps one segment read-only and folds its records into s
+func scanSegment(path string, cutoff, interval int64, s *stats) (int64, error) {
+	f, err := os.Open(path)
+	if err != nil {
+		return 0, err
+	}
+	defer f.Close()
+
+	info, err := f.Stat()
+	if err != nil {
+		return 0, err
+	}
+	size := int(info.Size())
+	if size < recordSize {
+		return 0, fmt.Errorf("truncated segment")
+	}
+	data, err := mapSegment(f, size)
+	if err != nil {
+		return 0, err
+	}
+	defer unmapSegment(data)
+
+	if string(data[:8]) != magic || binary.LittleEndian.Uint32(data[8:]) != recordSize {
+		return 0, fmt.Errorf("not a journal segment")
+	}
+
+	le := binary.LittleEndian
+	for off := recordSize; off+recordSize <= size; off += recordSize {
+		rec := data[off : off+recordSize]
+		ts := int64(le.Uint64(rec[0:]))
+		if ts == 0 {
+			break // Unwritten tail
+		}
+		if ts < cutoff {
+			continue
+		}
+
+		totalUs := le.Uint32(rec[8:])
+		result := rec[26]
+
+		s.records++
+		if s.first == 0 || ts < s.first {
+			s.first = ts
+		}
+		if ts > s.last {
+			s.last = ts
+		}
+		s.total.add(totalUs)
+		s.results[result&7]++
+		s.oses[rec[27]&7]++
+		if result == 0 {
+			s.queue.add(le.Uint32(rec[28:]))
+			s.decrypt.add(le.Uint32(rec[12:]))
+			s.route.add(le.Uint32(rec[16:]))
+			s.sign.add(le.Uint32(rec[20:]))
+			s.apps[cstring(rec[32:64])]++
+			s.domains[cstring(rec[80:128])]++
+		}
+
+		if interval > 0 {
+			key := ts / interval
+			b := s.series[key]
+			if b == nil {
+				b = &bucket{}
+				s.series[key] = b
+			}
+			b.count++
+			if result != 0 {
+				b.errs++
+			}
+			b.total.add(totalUs)
+		}
+	}
+	return int64(size), nil
+}
+
+func cstring(b []byte) string {
+	if i := bytes.IndexByte(b, 0); i >= 0 {
+		b = b[:i]
+	}
+	return string(b)
+}
+
+func report(s *stats, top int, interval time.Duration) {
+	if s.records == 0 {
+		fmt.Println("No records")
+		return
+	}
+	span := time.Duration(s.last - s.first)
+	fmt.Printf("Records: %d  (%s .. %s, %v)\n", s.records,
+		time.Unix(0, s.first).Format(time.RFC3339), time.Unix(0, s.last).Format(time.RFC3339), span.Round(time.Second))
+
+	fmt.Printf("\n%-8s %9s %9s %9s %9s\n", "stage", "p50 ms", "p90 ms", "p99 ms", "p99.9 ms")
+	for _, row := range []struct {
+		name string
+		h    *histogram
+	}{{"total", &s.total}, {"queue", &s.queue}, {"decrypt", &s.decrypt}, {"route", &s.route}, {"sign", &s.sign}} {
+		fmt.Printf("%-8s %9.2f %9.2f %9.2f %9.2f\n", row.name,
+			row.h.quantile(0.5), row.h.quantile(0.9), row.h.quantile(0.99), row.h.quantile(0.999))
+	}
+
+	fmt.Println("\nResults:")
+	for i, n := range s.results {
+		if n > 0 && i < len(resultNames) {
+			fmt.Printf("  %-12s %10d  %5.1f%%\n", resultNames[i], n, 100*float64(n)/float64(s.records))
+		}
+	}
+	fmt.Println("\nOS:")
+	for i, n := range s.oses {
+		if n > 0 && i < len(osNames) {
+			fmt.Printf("  %-12s %10d  %5.1f%%\n", osNames[i], n, 100*float64(n)/float64(s.records))
+		}
+	}
+
+	printTop("Top apps", s.apps, top)
+	printTop("Top domains", s.domains, top)
+
+	if interval > 0 && len(s.series) > 0 {
+		keys := make([]int64, 0, len(s.series))
+		for k := range s.series {
+			keys = append(keys, k)
+		}
+		sort.Slice(keys, func(a, b int) bool { return keys[a] < keys[b] })
+
+		fmt.Printf("\nTime series (%v buckets):\n", interval)
+		fmt.Printf("  %-20s %10s %8s %9s %9s\n", "start", "requests", "errors", "p50 ms", "p99 ms")
+		for _, k := range keys {
+			b := s.series[k]
+			fmt.Printf("  %-20s %10d %8d %9.2f %9.2f\n",
+				time.Unix(0, k*int64(interval)).Format("2006-01-02 15:04:05"),
+				b.count, b.errs, b.total.quantile(0.5), b.total.quantile(0.99))
+		}
+	}
+}
+
+func printTop(title string, counts map[string]uint64, n int) {
+	type kv struct {
+		key   string
+		count uint64
+	}
+	list := make([]kv, 0, len(counts))
+	for k, v := range counts {
+		list = append(list, kv{k, v})
+	}
+	sort.Slice(list, func(a, b int) bool { return list[a].count > list[b].count })
+	if len(list) > n {
+		list = list[:n]
+	}
+
+	fmt.Printf("\n%s:\n", title)
+	for _, e := range list {
+		fmt.Printf("  %-40s %10d\n", e.key, e.count)
+	}
+}
@@ -0,0 +1,217 @@
+// pgfw-loadgen drives POST /passgfw with valid encrypted payloads to compare
+// the gin port with the epoll fast path (-fastpath-port) under many
+// connections. Payloads are encrypted once up front with the server's public
+// key so the generator itself stays cheap.
+//
+// Usage:
+//
+//	pgfw-loadgen -url http://127.0.0.1:8080/passgfw -public-key public_key.pem \
+//	    [-conns 64] [-idle 0] [-duration 10s] [-keepalive=true] [-tfo] [-pid <server pid>]
+//
+// -idle opens that many extra connections first and keeps them silent for
+// the whole run, which is where per-connection server cost shows up. With
+// -pid the server's RSS, thread count and open FDs are sampled at the end.
+// -tfo dials with TCP Fast Open; combine it with -keepalive=false to measure
+// the per-probe handshake saving against a server run with -tcp-fastopen.
+package main
+
+import (
+	"bytes"
+	"crypto/rand"
+	"crypto/rsa"
+	"crypto/sha256"
+	"crypto/x509"
+	"encoding/base64"
+	"encoding/json"
+	"encoding/pem"
+	"flag"
+	"fmt"
+	"io"
+	"log"
+	"net"
+	"net/http"
+	"net/url"
+	"os"
+	"sort"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"time"
+)
+
+func main() {
+	target := flag.String("url", "http://127.0.0.1:8080/passgfw", "Endpoint URL")
+	keyPath := flag.String("public-key", "", "Server public key (PEM)")
+	conns := flag.Int("conns", 64, "Concurrent request loops")
+	idle := flag.Int("idle", 0, "Extra idle connections held open during the run")
+	duration := flag.Duration("duration", 10*time.Second, "Run length")
+	keepAlive := flag.Bool("keepalive", true, "Reuse connections between requests")
+	tfo := flag.Bool("tfo", false, "Dial with TCP Fast Open")
+	payloads := flag.Int("payloads", 256, "Distinct encrypted payloads to cycle through")
+	pid := flag.Int("pid", 0, "Server pid to sample RSS/FDs from (local runs)")
+	flag.Parse()
+
+	if *keyPath == "" {
+		log.Fatal("-public-key is required")
+	}
+	pub, err := loadPublicKey(*keyPath)
+	if err != nil {
+		log.Fatal(err)
+	}
+	bodies := make([][]byte, *payloads)
+	for i := range bodies {
+		if bodies[i], err = encryptPayload(pub, i); err != nil {
+			log.Fatal(err)
+		}
+	}
+
+	u, err := url.Parse(*target)
+	if err != nil {
+		log.Fatal(err)
+	}
+	held := holdIdle(u.Host, *idle)
+	defer func() {
+		for _, c := range held {
+			c.Close()
+		}
+	}()
+
+	dialer := &net.Dialer{Timeout: 5 * time.Second}
+	if *tfo {
+		dialer.Control = fastOpenControl
+	}
+	client := &http.Client{
+		Timeout: 30 * time.Second,
+		Transport: &http.Transport{
+			DialContext:         dialer.DialContext,
+			MaxIdleConnsPerHost: *conns,
+			DisableKeepAlives:   !*keepAlive,
+		},
+	}
+
+	var (
+		mu        sync.Mutex
+		latencies []time.Duration
+		errs      atomic.Uint64
+		wg        sync.WaitGroup
+	)
+	deadline := time.Now().Add(*duration)
+	start := time.Now()
+	for w := 0; w < *conns; w++ {
+		wg.Add(1)
+		go func(w int) {
+			defer wg.Done()
+			local := make([]time.Duration, 0, 4096)
+			for i := w; time.Now().Before(deadline); i += *conns {
+				t := time.Now()
+				if err := post(client, *target, bodies[i%len(bodies)]); err != nil {
+					errs.Add(1)
+					continue
+				}
+				local = append(local, time.Since(t))
+			}
+			mu.Lock()
+			latencies = append(latencies, local...)
+			mu.Unlock()
+		}(w)
+	}
+	wg.Wait()
+	elapsed := time.Since(start)
+
+	sort.Slice(latencies, func(i, j int) bool { return latencies[i] < latencies[j] })
+	fmt.Printf("url=%s conns=%d idle=%d keepalive=%v tfo=%v duration=%v\n", *target, *conns, len(held), *keepAlive, *tfo, elapsed.Round(time.Millisecond))
+	fmt.Printf("ok=%d errors=%d rps=%.0f\n", len(latencies), errs.Load(), float64(len(latencies))/elapsed.Seconds())
+	fmt.Printf("latency p50=%v p90=%v p99=%v max=%v\n",
+		quantile(latencies, 0.50), quantile(latencies, 0.90), quantile(latencies, 0.99), quantile(latencies, 1))
+	if *pid != 0 {
+		fmt.Println(processStats(*pid))
+	}
+}
+
+func post(client *http.Client, target string, body []byte) error {
+	resp, err := client.Post(target, "application/octet-stream", bytes.NewReader(body))
+	if err != nil {
+		return err
+	}
+	defer resp.Body.Close()
+	if _, err := io.Copy(io.Discard, resp.Body); err != nil {
+		return err
+	}
+	if resp.StatusCode != http.StatusOK {
+		return fmt.Errorf("HTTP %d", resp.StatusCode)
+	}
+	return nil
+}
+
+// holdIdle opens n connections that never send a byte
+func holdIdle(host string, n int) []net.Conn {
+	held := make([]net.Conn, 0, n)
+	for i := 0; i < n; i++ {
+		c, err := net.DialTimeout("tcp", host, 5*time.Second)
+		if err != nil {
+			log.Printf("idle connection %d: %v", i, err)
+			break
+		}
+		held = append(held, c)
+	}
+	return held
+}
+
+func loadPublicKey(path string) (*rsa.PublicKey, error) {
+	raw, err := os.ReadFile(path)
+	if err != nil {
+		return nil, err
+	}
+	block, _ := pem.Decode(raw)
+	if block == nil {
+		return nil, fmt.Errorf("%s: no PEM block", path)
+	}
+	key, err := x509.ParsePKIXPublicKey(block.Bytes)
+	if err != nil {
+		return nil, err
+	}
+	pub, ok := key.(*rsa.PublicKey)
+	if !ok {
+		return nil, fmt.Errorf("%s: not an RSA public key", path)
+	}
+	return pub, nil
+}
+
+// encryptPayload builds the same payload the client SDKs send
+func encryptPayload(pub *rsa.PublicKey, i int) ([]byte, error) {
+	nonce := make([]byte, 32)
+	rand.Read(nonce)
+	payload, _ := json.Marshal(map[string]string{
+		"nonce": base64.StdEncoding.EncodeToString(nonce),
+		"os":    "loadgen",
+		"app":   "pgfw-loadgen",
+		"data":  fmt.Sprintf("client-%d", i),
+	})
+	return rsa.EncryptOAEP(sha256.New(), rand.Reader, pub, payload, nil)
+}
+
+func quantile(sorted []time.Duration, q float64) time.Duration {
+	if len(sorted) == 0 {
+		return 0
+	}
+	i := int(q * float64(len(sorted)-1))
+	return sorted[i].Round(time.Microsecond)
+}
+
+// processStats reads RSS, threads and open FDs of a local process from /proc
+func processStats(pid int) string {
+	status, err := os.ReadFile(fmt.Sprintf("/proc/%d/status", pid))
+	if err != nil {
+		return fmt.Sprintf("server pid %d: %v", pid, err)
+	}
+	var rss, threads string
+	for _, line := range strings.Split(string(status), "\n") {
+		if v, ok := strings.CutPrefix(line, "VmRSS:"); ok {
+			rss = strings.TrimSpace(v)
+		} else if v, ok := strings.CutPrefix(line, "Threads:"); ok {
+			threads = strings.TrimSpace(v)
+		}
+	}
+	fds, _ := os.ReadDir(fmt.Sprintf("/proc/%d/fd", pid))
+	return fmt.Sprintf("server rss=%s threads=%s fds=%d", rss, threads, len(fds))
+}
@@ -0,0 +1,19 @@
+//go:build linux
+
+package main
+
+import "syscall"
+
+const tcpFastOpenConnect = 0x1e // TCP_FASTOPEN_CONNECT (Linux 4.11+)
+
+// fastOpenControl makes connect(2) defer the SYN until the first write, so
+// the request rides in the SYN once the client holds a cookie for the server
+func fastOpenControl(network, address string, c syscall.RawConn) error {
+	var err error
+	if cerr := c.Control(func(fd uintptr) {
+		err = syscall.SetsockoptInt(int(fd), syscall.IPPROTO_TCP, tcpFastOpenConnect, 1)
+	}); cerr != nil {
+		return cerr
+	}
+	return err
+}
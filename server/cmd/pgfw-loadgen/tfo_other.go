@@ -0,0 +1,12 @@
+//go:build !linux
+
+package main
+
+import (
+	"errors"
+	"syscall"
+)
+
+func fastOpenControl(network, address string, c syscall.RawConn) error {
+	return errors.New("-tfo requires linux")
+}
@@ -0,0 +1,317 @@
+//go:build linux
+
+package main
+
+import (
+	"log"
+	"os"
+	"sync"
+	"syscall"
+	"time"
+)
+
+const (
+	holderTick       = 100 * time.Millisecond
+	ipBindAddrNoPort = 0x18 // IP_BIND_ADDRESS_NO_PORT: pick the port at connect, per destination
+)
+
+var (
+	partialHead = []byte("POST /passgfw HTTP/1.1\r\nHost: soak\r\n") // No terminating blank line
+	trickleHead = []byte("POST /passgfw HTTP/1.1\r\nHost: soak\r\nContent-Length: 65536\r\n\r\n")
+)
+
+type heldConn struct {
+	fd        int
+	mode      mode
+	connected bool
+	sent      int       // Trickled bytes
+	due       time.Time // Next trickled byte or the reset
+}
+
+// holder owns every held connection from a single epoll loop
+type holder struct {
+	opts  options
+	epfd  int
+	wait  syscall.RawConn // epfd parked in the runtime poller
+	tick  [2]int          // Pipe written every holderTick to wake the loop
+	conns map[int]*heldConn
+	timed map[int]*heldConn // trickle and rst connections
+	next  int               // Round-robin index into opts.sources
+	retry []time.Time       // Slots closed by the server, refilled after -reconnect-after
+
+	counts holderStats // Loop-owned
+
+	mu   sync.Mutex
+	want int
+	snap holderStats
+}
+
+func startHolder(opts options) (*holder, error) {
+	epfd, err := syscall.EpollCreate1(syscall.EPOLL_CLOEXEC)
+	if err != nil {
+		return nil, err
+	}
+	h := &holder{opts: opts, epfd: epfd, conns: make(map[int]*heldConn), timed: make(map[int]*heldConn)}
+	if err := syscall.Pipe2(h.tick[:], syscall.O_NONBLOCK|syscall.O_CLOEXEC); err != nil {
+		return nil, err
+	}
+	if err := syscall.EpollCtl(epfd, syscall.EPOLL_CTL_ADD, h.tick[0],
+		&syscall.EpollEvent{Events: syscall.EPOLLIN, Fd: int32(h.tick[0])}); err != nil {
+		return nil, err
+	}
+	// Blocking in epoll_wait would hold a P and skew the latency of the
+	// valid requests, so wait on the epoll fd through the runtime poller
+	if err := syscall.SetNonblock(epfd, true); err != nil {
+		return nil, err
+	}
+	if h.wait, err = os.NewFile(uintptr(epfd), "epoll").SyscallConn(); err != nil {
+		return nil, err
+	}
+
+	go func() {
+		for range time.Tick(holderTick) {
+			syscall.Write(h.tick[1], []byte{0})
+		}
+	}()
+	go h.run()
+	return h, nil
+}
+
+func (h *holder) setWant(n int) {
+	h.mu.Lock()
+	h.want = n
+	h.mu.Unlock()
+}
+
+func (h *holder) stats() holderStats {
+	h.mu.Lock()
+	defer h.mu.Unlock()
+	return h.snap
+}
+
+func (h *holder) run() {
+	events := make([]syscall.EpollEvent, 1024)
+	buf := make([]byte, 4096)
+	for {
+		var n int
+		var werr error
+		if err := h.wait.Read(func(uintptr) bool {
+			n, werr = syscall.EpollWait(h.epfd, events, 0)
+			return n > 0 || (werr != nil && werr != syscall.EINTR)
+		}); err != nil || werr != nil {
+			log.Fatalf("epoll_wait: %v", firstErr(err, werr))
+		}
+
+		ticked := false
+		for i := 0; i < n; i++ {
+			fd, ev := int(events[i].Fd), events[i].Events
+			if fd == h.tick[0] {
+				for {
+					if r, _ := syscall.Read(fd, buf); r <= 0 {
+						break
+					}
+				}
+				ticked = true
+				continue
+			}
+			c := h.conns[fd]
+			if c == nil {
+				continue
+			}
+			if !c.connected {
+				soErr, _ := syscall.GetsockoptInt(fd, syscall.SOL_SOCKET, syscall.SO_ERROR)
+				if soErr != 0 || ev&(syscall.EPOLLERR|syscall.EPOLLHUP) != 0 {
+					h.counts.connectErrors++
+					h.drop(c)
+				} else if ev&syscall.EPOLLOUT != 0 {
+					h.established(c, time.Now())
+				}
+				continue
+			}
+			// Discard anything the server sends; EOF or an error means it closed us
+			for {
+				r, err := syscall.Read(fd, buf)
+				if r > 0 {
+					continue
+				}
+				if err == syscall.EAGAIN {
+					break
+				}
+				if err == syscall.EINTR {
+					continue
+				}
+				h.serverClosed(c)
+				break
+			}
+		}
+		if ticked {
+			h.onTick(time.Now())
+		}
+
+		h.mu.Lock()
+		h.snap = h.counts
+		h.mu.Unlock()
+	}
+}
+
+func (h *holder) onTick(now time.Time) {
+	for _, c := range h.timed {
+		if !c.connected || now.Before(c.due) {
+			continue
+		}
+		switch c.mode {
+		case modeTrickle:
+			b := byte('x')
+			if c.sent < len(trickleHead) {
+				b = trickleHead[c.sent]
+			}
+			if _, err := syscall.Write(c.fd, []byte{b}); err != nil && err != syscall.EAGAIN {
+				h.serverClosed(c)
+				continue
+			}
+			c.sent++
+			c.due = now.Add(h.opts.trickleEvery)
+			h.counts.trickled++
+		case modeRST:
+			syscall.SetsockoptLinger(c.fd, syscall.SOL_SOCKET, syscall.SO_LINGER, &syscall.Linger{Onoff: 1, Linger: 0})
+			h.counts.resets++
+			h.drop(c)
+		}
+	}
+
+	for len(h.retry) > 0 && !now.Before(h.retry[0]) {
+		h.retry = h.retry[1:]
+	}
+	h.mu.Lock()
+	want := h.want - len(h.retry)
+	h.mu.Unlock()
+	budget := max(h.opts.openRate*int(holderTick)/int(time.Second), 1)
+	for len(h.conns) < want && budget > 0 {
+		h.open(now)
+		budget--
+	}
+}
+
+// open starts a non-blocking connect for the behaviour furthest below its share
+func (h *holder) open(now time.Time) {
+	m := h.nextMode()
+	fd, err := syscall.Socket(syscall.AF_INET, syscall.SOCK_STREAM|syscall.SOCK_NONBLOCK|syscall.SOCK_CLOEXEC, 0)
+	if err != nil {
+		h.counts.connectErrors++ // Typically EMFILE
+		return
+	}
+	if len(h.opts.sources) > 0 {
+		src := &syscall.SockaddrInet4{}
+		copy(src.Addr[:], h.opts.sources[h.next%len(h.opts.sources)])
+		h.next++
+		syscall.SetsockoptInt(fd, syscall.IPPROTO_IP, ipBindAddrNoPort, 1)
+		if err := syscall.Bind(fd, src); err != nil {
+			syscall.Close(fd)
+			h.counts.connectErrors++
+			return
+		}
+	}
+	dst := &syscall.SockaddrInet4{Port: h.opts.target.Port}
+	copy(dst.Addr[:], h.opts.target.IP.To4())
+	err = syscall.Connect(fd, dst)
+	if err != nil && err != syscall.EINPROGRESS {
+		syscall.Close(fd)
+		h.counts.connectErrors++
+		return
+	}
+	if err := syscall.EpollCtl(h.epfd, syscall.EPOLL_CTL_ADD, fd,
+		&syscall.EpollEvent{Events: syscall.EPOLLIN | syscall.EPOLLOUT | syscall.EPOLLRDHUP, Fd: int32(fd)}); err != nil {
+		syscall.Close(fd)
+		h.counts.connectErrors++
+		return
+	}
+	c := &heldConn{fd: fd, mode: m}
+	h.conns[fd] = c
+	h.counts.byMode[m]++
+	if err == nil {
+		h.established(c, now)
+	}
+}
+
+func (h *holder) established(c *heldConn, now time.Time) {
+	c.connected = true
+	h.counts.held++
+	syscall.EpollCtl(h.epfd, syscall.EPOLL_CTL_MOD, c.fd,
+		&syscall.EpollEvent{Events: syscall.EPOLLIN | syscall.EPOLLRDHUP, Fd: int32(c.fd)})
+
+	switch c.mode {
+	case modeTrickle:
+		c.due = now
+		h.timed[c.fd] = c
+	case modeHalfOpen:
+		syscall.Write(c.fd, partialHead)
+		syscall.Shutdown(c.fd, syscall.SHUT_WR)
+	case modeRST:
+		syscall.Write(c.fd, partialHead)
+		c.due = now.Add(h.opts.rstAfter)
+		h.timed[c.fd] = c
+	}
+}
+
+// serverClosed drops a connection the server closed; like a client backing
+// off, its slot is only refilled after -reconnect-after
+func (h *holder) serverClosed(c *heldConn) {
+	h.counts.serverClosed++
+	h.counts.closedByMode[c.mode]++
+	h.drop(c)
+	h.retry = append(h.retry, time.Now().Add(h.opts.reconnectAfter))
+}
+
+func (h *holder) drop(c *heldConn) {
+	syscall.Close(c.fd)
+	delete(h.conns, c.fd)
+	delete(h.timed, c.fd)
+	h.counts.byMode[c.mode]--
+	if c.connected {
+		h.counts.held--
+	}
+}
+
+// nextMode keeps the live mix at the -mix weights as connections churn
+func (h *holder) nextMode() mode {
+	total := 0
+	for _, w := range h.opts.mix {
+		total += w
+	}
+	best, bestDeficit := modeIdle, -1.0
+	n := float64(len(h.conns) + 1)
+	for m := mode(0); m < modeCount; m++ {
+		if h.opts.mix[m] == 0 {
+			continue
+		}
+		deficit := n*float64(h.opts.mix[m])/float64(total) - float64(h.counts.byMode[m])
+		if deficit > bestDeficit {
+			best, bestDeficit = m, deficit
+		}
+	}
+	return best
+}
+
+// raiseFileLimit lifts RLIMIT_NOFILE to n, including the hard limit when
+// running as root
+func raiseFileLimit(n int) error {
+	var lim syscall.Rlimit
+	if err := syscall.Getrlimit(syscall.RLIMIT_NOFILE, &lim); err != nil {
+		return err
+	}
+	if lim.Cur >= uint64(n) {
+		return nil
+	}
+	lim.Cur = uint64(n)
+	lim.Max = max(lim.Max, lim.Cur)
+	return syscall.Setrlimit(syscall.RLIMIT_NOFILE, &lim)
+}
+
+func firstErr(errs ...error) error {
+	for _, err := range errs {
+		if err != nil {
+			return err
+		}
+	}
+	return nil
+}
@@ -0,0 +1,16 @@
+//go:build !linux
+
+package main
+
+import "errors"
+
+type holder struct{}
+
+func startHolder(opts options) (*holder, error) {
+	return nil, errors.New("pgfw-soak requires linux")
+}
+
+func (h *holder) setWant(n int)      {}
+func (h *holder) stats() holderStats { return holderStats{} }
+
+func raiseFileLimit(n int) error { return nil }
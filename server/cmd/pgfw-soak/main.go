@@ -0,0 +1,355 @@
+// pgfw-soak holds very large numbers of connections open against a server
+// while sending valid POST /passgfw requests alongside, and reports how the
+// server's RSS, FD count and request latency change as connections scale.
+// It targets the failure mode throughput benchmarks miss: idle or slow
+// mobile clients exhausting file descriptors and memory.
+//
+// Held connections live in one epoll loop (no goroutine per connection) and
+// are split across behaviours by -mix:
+//
+//	idle      connect and never send
+//	trickle   send a request one byte every -trickle-every, never finishing
+//	halfopen  send part of the headers, then shutdown(SHUT_WR) and keep reading
+//	rst       send part of the headers, then abort with RST after -rst-after
+//	          (reconnected immediately, so this mode also churns connections)
+//
+// Connections the server closes are replaced after -reconnect-after.
+//
+// Usage:
+//
+//	pgfw-soak -addr 127.0.0.1:8080 -public-key public_key.pem \
+//	    -conns 100000 -step 10000 -source 127.0.0.1-127.0.0.8 -pid $(pgrep -x passgfw-server)
+//
+// One source address gives at most ip_local_port_range connections to one
+// server port; use -source with several loopback addresses beyond ~28k.
+// The tool raises its own RLIMIT_NOFILE; the server needs the same.
+package main
+
+import (
+	"bytes"
+	"crypto/rand"
+	"crypto/rsa"
+	"crypto/sha256"
+	"crypto/x509"
+	"encoding/base64"
+	"encoding/binary"
+	"encoding/json"
+	"encoding/pem"
+	"flag"
+	"fmt"
+	"io"
+	"log"
+	"net"
+	"net/http"
+	"os"
+	"sort"
+	"strconv"
+	"strings"
+	"sync"
+	"time"
+)
+
+type mode uint8
+
+const (
+	modeIdle mode = iota
+	modeTrickle
+	modeHalfOpen
+	modeRST
+	modeCount
+)
+
+var modeNames = [modeCount]string{"idle", "trickle", "halfopen", "rst"}
+
+type holderStats struct {
+	held          int // Established connections
+	connectErrors int
+	serverClosed  int // Held connections the server closed
+	resets        int // RSTs sent by rst connections
+	trickled      int64
+	byMode        [modeCount]int // Established or connecting
+	closedByMode  [modeCount]int
+}
+
+type options struct {
+	target         *net.TCPAddr
+	sources        []net.IP
+	mix            [modeCount]int
+	trickleEvery   time.Duration
+	rstAfter       time.Duration
+	reconnectAfter time.Duration
+	openRate       int // New connections per second while ramping
+}
+
+func main() {
+	addr := flag.String("addr", "127.0.0.1:8080", "Server address")
+	path := flag.String("path", "/passgfw", "Endpoint for valid requests")
+	keyPath := flag.String("public-key", "", "Server public key (PEM)")
+	conns := flag.Int("conns", 100000, "Held connections at the last step")
+	step := flag.Int("step", 10000, "Connections added per step")
+	dwell := flag.Duration("dwell", 10*time.Second, "Measurement time per step")
+	mixSpec := flag.String("mix", "idle=70,trickle=10,halfopen=10,rst=10", "Share of each held-connection behaviour")
+	trickleEvery := flag.Duration("trickle-every", time.Second, "Interval between trickled bytes")
+	rstAfter := flag.Duration("rst-after", 5*time.Second, "Lifetime of rst connections before the reset")
+	reconnectAfter := flag.Duration("reconnect-after", time.Second, "Delay before replacing a connection the server closed")
+	openRate := flag.Int("open-rate", 20000, "New connections per second while ramping")
+	sourceSpec := flag.String("source", "", "Local addresses to bind (a.b.c.d-a.b.c.e or comma list)")
+	rate := flag.Float64("rate", 20, "Valid requests per second")
+	keepAlive := flag.Bool("valid-keepalive", false, "Reuse connections for valid requests (default: a new one each, like a probe)")
+	pid := flag.Int("pid", 0, "Server pid to sample RSS/FDs from (local runs)")
+	flag.Parse()
+
+	if *keyPath == "" {
+		log.Fatal("-public-key is required")
+	}
+	target, err := net.ResolveTCPAddr("tcp4", *addr)
+	if err != nil {
+		log.Fatal(err)
+	}
+	opts := options{target: target, trickleEvery: *trickleEvery, rstAfter: *rstAfter, reconnectAfter: *reconnectAfter, openRate: *openRate}
+	if opts.mix, err = parseMix(*mixSpec); err != nil {
+		log.Fatal(err)
+	}
+	if opts.sources, err = parseSources(*sourceSpec); err != nil {
+		log.Fatal(err)
+	}
+	if err := raiseFileLimit(*conns + 4096); err != nil {
+		log.Printf("raising RLIMIT_NOFILE: %v", err)
+	}
+
+	pub, err := loadPublicKey(*keyPath)
+	if err != nil {
+		log.Fatal(err)
+	}
+	bodies := make([][]byte, 64)
+	for i := range bodies {
+		if bodies[i], err = encryptPayload(pub, i); err != nil {
+			log.Fatal(err)
+		}
+	}
+
+	h, err := startHolder(opts)
+	if err != nil {
+		log.Fatal(err)
+	}
+	v := startValid("http://"+*addr+*path, bodies, *rate, *keepAlive)
+
+	fmt.Printf("%8s %8s %7s %7s %7s %7s %6s %6s %9s %9s %10s %8s\n",
+		"target", "held", "conn_er", "closed", "resets", "ok", "err", "err%", "p50", "p99", "rss", "fds")
+	for level := min(*step, *conns); ; level = min(level+*step, *conns) {
+		h.setWant(level)
+		ramp := time.Now()
+		for h.stats().held < level && time.Since(ramp) < *dwell {
+			time.Sleep(100 * time.Millisecond)
+		}
+
+		before := h.stats()
+		v.reset()
+		time.Sleep(*dwell)
+		after := h.stats()
+		ok, failed, lat := v.reset()
+
+		errPct := 0.0
+		if ok+failed > 0 {
+			errPct = 100 * float64(failed) / float64(ok+failed)
+		}
+		rss, fds := "-", "-"
+		if *pid != 0 {
+			rss, fds = processStats(*pid)
+		}
+		fmt.Printf("%8d %8d %7d %7d %7d %7d %6d %5.1f%% %9v %9v %10s %8s\n",
+			level, after.held, after.connectErrors-before.connectErrors, after.serverClosed-before.serverClosed,
+			after.resets-before.resets, ok, failed, errPct, quantile(lat, 0.5), quantile(lat, 0.99), rss, fds)
+
+		if level == *conns {
+			break
+		}
+	}
+	s := h.stats()
+	fmt.Printf("held by mode:")
+	for m := mode(0); m < modeCount; m++ {
+		fmt.Printf(" %s=%d", modeNames[m], s.byMode[m])
+	}
+	fmt.Printf(" | closed by server:")
+	for m := mode(0); m < modeCount; m++ {
+		fmt.Printf(" %s=%d", modeNames[m], s.closedByMode[m])
+	}
+	fmt.Printf(" | trickled bytes=%d\n", s.trickled)
+}
+
+// valid sends well-formed requests at a fixed rate and collects latencies
+type valid struct {
+	mu        sync.Mutex
+	ok        int
+	failed    int
+	latencies []time.Duration
+}
+
+func startValid(url string, bodies [][]byte, rate float64, keepAlive bool) *valid {
+	v := &valid{}
+	if rate <= 0 {
+		return v
+	}
+	client := &http.Client{
+		Timeout:   10 * time.Second,
+		Transport: &http.Transport{DisableKeepAlives: !keepAlive, MaxIdleConnsPerHost: 64},
+	}
+	go func() {
+		ticker := time.NewTicker(time.Duration(float64(time.Second) / rate))
+		defer ticker.Stop()
+		for i := 0; ; i++ {
+			<-ticker.C
+			go func(body []byte) {
+				start := time.Now()
+				err := post(client, url, body)
+				v.mu.Lock()
+				defer v.mu.Unlock()
+				if err != nil {
+					v.failed++
+					return
+				}
+				v.ok++
+				v.latencies = append(v.latencies, time.Since(start))
+			}(bodies[i%len(bodies)])
+		}
+	}()
+	return v
+}
+
+// reset returns the results since the previous call, latencies sorted
+func (v *valid) reset() (ok, failed int, latencies []time.Duration) {
+	v.mu.Lock()
+	ok, failed, latencies = v.ok, v.failed, v.latencies
+	v.ok, v.failed, v.latencies = 0, 0, nil
+	v.mu.Unlock()
+	sort.Slice(latencies, func(i, j int) bool { return latencies[i] < latencies[j] })
+	return ok, failed, latencies
+}
+
+func post(client *http.Client, url string, body []byte) error {
+	resp, err := client.Post(url, "application/octet-stream", bytes.NewReader(body))
+	if err != nil {
+		return err
+	}
+	defer resp.Body.Close()
+	if _, err := io.Copy(io.Discard, resp.Body); err != nil {
+		return err
+	}
+	if resp.StatusCode != http.StatusOK {
+		return fmt.Errorf("HTTP %d", resp.StatusCode)
+	}
+	return nil
+}
+
+func parseMix(spec string) (mix [modeCount]int, err error) {
+	total := 0
+	for _, part := range strings.Split(spec, ",") {
+		name, value, _ := strings.Cut(strings.TrimSpace(part), "=")
+		n, err := strconv.Atoi(value)
+		if err != nil || n < 0 {
+			return mix, fmt.Errorf("invalid -mix entry %q", part)
+		}
+		found := false
+		for m := mode(0); m < modeCount; m++ {
+			if modeNames[m] == name {
+				mix[m], found = n, true
+			}
+		}
+		if !found {
+			return mix, fmt.Errorf("unknown -mix behaviour %q", name)
+		}
+		total += n
+	}
+	if total == 0 {
+		return mix, fmt.Errorf("-mix has no weight")
+	}
+	return mix, nil
+}
+
+func parseSources(spec string) ([]net.IP, error) {
+	if spec == "" {
+		return nil, nil
+	}
+	var out []net.IP
+	for _, part := range strings.Split(spec, ",") {
+		first, last, isRange := strings.Cut(strings.TrimSpace(part), "-")
+		a := net.ParseIP(first).To4()
+		if a == nil {
+			return nil, fmt.Errorf("invalid source address %q", first)
+		}
+		if !isRange {
+			out = append(out, a)
+			continue
+		}
+		b := net.ParseIP(last).To4()
+		if b == nil {
+			return nil, fmt.Errorf("invalid source address %q", last)
+		}
+		from, to := binary.BigEndian.Uint32(a), binary.BigEndian.Uint32(b)
+		for n := from; n <= to && n >= from; n++ {
+			ip := make(net.IP, 4)
+			binary.BigEndian.PutUint32(ip, n)
+			out = append(out, ip)
+		}
+	}
+	return out, nil
+}
+
+func loadPublicKey(path string) (*rsa.PublicKey, error) {
+	raw, err := os.ReadFile(path)
+	if err != nil {
+		return nil, err
+	}
+	block, _ := pem.Decode(raw)
+	if block == nil {
+		return nil, fmt.Errorf("%s: no PEM block", path)
+	}
+	key, err := x509.ParsePKIXPublicKey(block.Bytes)
+	if err != nil {
+		return nil, err
+	}
+	pub, ok := key.(*rsa.PublicKey)
+	if !ok {
+		return nil, fmt.Errorf("%s: not an RSA public key", path)
+	}
+	return pub, nil
+}
+
+// encryptPayload builds the same payload the client SDKs send
+func encryptPayload(pub *rsa.PublicKey, i int) ([]byte, error) {
+	nonce := make([]byte, 32)
+	rand.Read(nonce)
+	payload, _ := json.Marshal(map[string]string{
+		"nonce": base64.StdEncoding.EncodeToString(nonce),
+		"os":    "soak",
+		"app":   "pgfw-soak",
+		"data":  fmt.Sprintf("client-%d", i),
+	})
+	return rsa.EncryptOAEP(sha256.New(), rand.Reader, pub, payload, nil)
+}
+
+func quantile(sorted []time.Duration, q float64) time.Duration {
+	if len(sorted) == 0 {
+		return 0
+	}
+	return sorted[int(q*float64(len(sorted)-1))].Round(time.Microsecond)
+}
+
+// processStats reads RSS and open FDs of a local process from /proc
+func processStats(pid int) (rss, fds string) {
+	status, err := os.ReadFile(fmt.Sprintf("/proc/%d/status", pid))
+	if err != nil {
+		return "gone", "-"
+	}
+	for _, line := range strings.Split(string(status), "\n") {
+		if v, ok := strings.CutPrefix(line, "VmRSS:"); ok {
+			kb, _ := strconv.Atoi(strings.TrimSuffix(strings.TrimSpace(v), " kB"))
+			rss = fmt.Sprintf("%.1fMB", float64(kb)/1024)
+		}
+	}
+	entries, err := os.ReadDir(fmt.Sprintf("/proc/%d/fd", pid))
+	if err != nil {
+		return rss, "-"
+	}
+	return rss, strconv.Itoa(len(entries))
+}
@@ -0,0 +1,225 @@
+package main
+
+import (
+	"crypto/aes"
+	"crypto/cipher"
+	"crypto/rsa"
+	"crypto/sha256"
+	"crypto/x509"
+	"encoding/json"
+	"encoding/pem"
+	"fmt"
+	"os"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"time"
+)
+
+// runtimeConfig is everything the request path reads. A value is never
+// modified after it is published; changes build a new one and swap the
+// pointer, so a request always sees one complete configuration.
+type runtimeConfig struct {
+	Version    uint64
+	PrivateKey *rsa.PrivateKey
+	Domain     string               // Real server domain (configured, not from client)
+	Backends   []Backend            // Pool for rendezvous affinity
+	Pools      map[string][]Backend // Named pools that routes can target as "@name"
+	Routes     map[string]string    // Client data -> domain or "@pool" overrides
+	URLs       []URLEntry           // Dynamic URLs returned with every answer
+	routes     map[string]route     // Compiled Routes, set by prepare
+	urlsHash   string               // Hash of URLs for subscribers, set by prepare
+	urlsJSON   []byte               // URLs as sent in subscription deltas
+	tokenAEAD  cipher.AEAD          // Seals subscription tokens, keyed from PrivateKey
+}
+
+var active atomic.Pointer[runtimeConfig]
+
+// configChange is closed and replaced whenever a new config is stored, so
+// waiters (subscription long-polls) wake without registering anywhere
+var configChange struct {
+	sync.Mutex
+	ch chan struct{}
+}
+
+// storeConfig publishes cfg to the request path and wakes waiters
+func storeConfig(cfg *runtimeConfig) {
+	active.Store(cfg)
+	configChange.Lock()
+	if configChange.ch != nil {
+		close(configChange.ch)
+		configChange.ch = nil
+	}
+	configChange.Unlock()
+}
+
+// configChanged returns a channel closed by the next storeConfig. Take it
+// before reading currentConfig so a change in between is not missed.
+func configChanged() <-chan struct{} {
+	configChange.Lock()
+	defer configChange.Unlock()
+	if configChange.ch == nil {
+		configChange.ch = make(chan struct{})
+	}
+	return configChange.ch
+}
+
+// Built-in custom routing examples, used until a snapshot provides routes
+var defaultRoutes = map[string]string{
+	"cdn":    "cdn.example.com:443",
+	"mobile": "mobile.example.com:443",
+}
+
+func currentConfig() *runtimeConfig {
+	return active.Load()
+}
+
+// nextVersion returns a version above the active config's. Versions are
+// wall-clock milliseconds so they keep increasing across restarts.
+func nextVersion(now time.Time) uint64 {
+	version := uint64(now.UnixMilli())
+	if prev := currentConfig(); prev != nil && version <= prev.Version {
+		version = prev.Version + 1
+	}
+	return version
+}
+
+// prepare validates a new config and compiles its routes
+func (c *runtimeConfig) prepare() error {
+	if err := c.validate(); err != nil {
+		return err
+	}
+	c.routes = make(map[string]route, len(c.Routes))
+	for data, target := range c.Routes {
+		if name, ok := strings.CutPrefix(target, poolPrefix); ok {
+			c.routes[data] = route{pool: c.pool(name)}
+		} else {
+			c.routes[data] = route{domain: target}
+		}
+	}
+	var err error
+	if c.urlsJSON, err = json.Marshal(c.URLs); err != nil {
+		return err
+	}
+	if c.URLs == nil {
+		c.urlsJSON = []byte("[]")
+	}
+	c.urlsHash = shortHash(c.urlsJSON)
+	key := sha256.Sum256(append([]byte("passgfw-subscribe\x00"), x509.MarshalPKCS1PrivateKey(c.PrivateKey)...))
+	block, err := aes.NewCipher(key[:])
+	if err != nil {
+		return err
+	}
+	c.tokenAEAD, err = cipher.NewGCM(block)
+	return err
+}
+
+func (c *runtimeConfig) validate() error {
+	if c.PrivateKey == nil {
+		return fmt.Errorf("missing private key")
+	}
+	if err := validatePool(c.Backends); err != nil {
+		return err
+	}
+	for name, pool := range c.Pools {
+		if !validDomain(name) || name == defaultPool {
+			return fmt.Errorf("invalid pool name %q", name)
+		}
+		if len(pool) == 0 {
+			return fmt.Errorf("pool %q is empty", name)
+		}
+		if err := validatePool(pool); err != nil {
+			return fmt.Errorf("pool %q: %w", name, err)
+		}
+	}
+	for data, target := range c.Routes {
+		if data == "" {
+			return fmt.Errorf("invalid route %q -> %q", data, target)
+		}
+		if name, ok := strings.CutPrefix(target, poolPrefix); ok {
+			if len(c.pool(name)) == 0 {
+				return fmt.Errorf("route %q targets unknown or empty pool %q", data, name)
+			}
+		} else if !validDomain(target) {
+			return fmt.Errorf("invalid route %q -> %q", data, target)
+		}
+	}
+	for _, u := range c.URLs {
+		switch u.Method {
+		case "api", "file", "navigate", "remove":
+		default:
+			return fmt.Errorf("invalid URL method %q", u.Method)
+		}
+		if u.URL == "" {
+			return fmt.Errorf("empty URL for method %q", u.Method)
+		}
+	}
+	return nil
+}
+
+// pool returns a named pool; "default" is the affinity pool in Backends
+func (c *runtimeConfig) pool(name string) []Backend {
+	if name == defaultPool {
+		return c.Backends
+	}
+	return c.Pools[name]
+}
+
+func validatePool(pool []Backend) error {
+	for _, b := range pool {
+		if !validDomain(b.Domain) || b.Weight <= 0 {
+			return fmt.Errorf("invalid backend %q (weight %v)", b.Domain, b.Weight)
+		}
+	}
+	return nil
+}
+
+// loadPrivateKey reads the RSA key from path, or the built-in key when empty
+func loadPrivateKey(path string) (*rsa.PrivateKey, error) {
+	data := []byte(builtinPrivateKey)
+	if path != "" {
+		var err error
+		data, err = os.ReadFile(path)
+		if err != nil {
+			return nil, err
+		}
+	}
+	return parsePrivateKey(data)
+}
+
+func parsePrivateKey(data []byte) (*rsa.PrivateKey, error) {
+	block, _ := pem.Decode(data)
+	if block == nil {
+		return nil, fmt.Errorf("invalid PEM")
+	}
+
+	key, err := x509.ParsePKCS1PrivateKey(block.Bytes)
+	if err != nil {
+		parsed, err := x509.ParsePKCS8PrivateKey(block.Bytes)
+		if err != nil {
+			return nil, err
+		}
+		rsaKey, ok := parsed.(*rsa.PrivateKey)
+		if !ok {
+			return nil, fmt.Errorf("not an RSA key")
+		}
+		key = rsaKey
+	}
+	return key, nil
+}
+
+// loadURLs reads a JSON array of URLEntry (empty path means none)
+func loadURLs(path string) ([]URLEntry, error) {
+	if path == "" {
+		return nil, nil
+	}
+	data, err := os.ReadFile(path)
+	if err != nil {
+		return nil, err
+	}
+	var urls []URLEntry
+	if err := json.Unmarshal(data, &urls); err != nil {
+		return nil, err
+	}
+	return urls, nil
+}
@@ -0,0 +1,268 @@
+package main
+
+import (
+	"bytes"
+	"encoding/json"
+	"errors"
+	"fmt"
+	"net"
+	"net/http"
+	"strconv"
+	"strings"
+)
+
+// Fast path: an optional second listener (-fastpath-port) that serves only
+// POST /passgfw and /subscribe from epoll event loops (see fastpath_linux.go).
+// Requests are a few hundred bytes, so instead of a goroutine, bufio
+// reader/writer and a gin context per connection, each loop owns one read
+// buffer and parses just enough HTTP/1.1 for these endpoints. Everything else
+// stays on the gin port.
+
+const (
+	fastMaxHeader = 8 << 10
+	fastMaxBody   = 64 << 10
+)
+
+var (
+	fastpathPort   string // Empty disables the fast path
+	fastpathLoops  int    // Event loops, each with its own SO_REUSEPORT listener
+	trustedProxies string // Comma-separated IPs/CIDRs whose X-Forwarded-For is honored
+
+	proxyCIDRs  []string // Parsed -trusted-proxies, also handed to gin
+	proxyRanges []*net.IPNet
+)
+
+const (
+	fastRoutePassGFW   = iota // POST /passgfw
+	fastRouteRegister         // POST /subscribe
+	fastRouteSubscribe        // GET /subscribe
+)
+
+// fastRequest is one parsed request; slices point into the connection buffer
+type fastRequest struct {
+	Route       int
+	Query       []byte
+	Body        []byte
+	Host        []byte
+	ProbeID     []byte
+	Traceparent []byte
+	Forwarded   []byte // X-Forwarded-For, honored only from a trusted proxy
+	KeepAlive   bool
+}
+
+// fastError is a request the fast path answers itself and then closes
+type fastError struct {
+	status int
+	msg    string
+}
+
+func (e *fastError) Error() string { return e.msg }
+
+var errFastIncomplete = errors.New("incomplete request")
+
+var (
+	crlf       = []byte("\r\n")
+	headersEnd = []byte("\r\n\r\n")
+)
+
+// parseFastRequest parses one request from the front of buf and returns the
+// number of bytes it used. errFastIncomplete means more input is needed.
+func parseFastRequest(buf []byte) (req fastRequest, n int, err error) {
+	end := bytes.Index(buf, headersEnd)
+	if end < 0 {
+		if len(buf) > fastMaxHeader {
+			return req, 0, &fastError{http.StatusRequestHeaderFieldsTooLarge, "Headers too large"}
+		}
+		return req, 0, errFastIncomplete
+	}
+
+	head := buf[:end]
+	line, rest, _ := bytes.Cut(head, crlf)
+	method, line, _ := bytes.Cut(line, []byte(" "))
+	path, version, _ := bytes.Cut(line, []byte(" "))
+	path, req.Query, _ = bytes.Cut(path, []byte("?"))
+	if string(version) != "HTTP/1.1" && string(version) != "HTTP/1.0" {
+		return req, 0, &fastError{http.StatusHTTPVersionNotSupported, "HTTP/1.x only"}
+	}
+	switch {
+	case string(path) == "/passgfw" && string(method) == http.MethodPost:
+		req.Route = fastRoutePassGFW
+	case string(path) == "/subscribe" && string(method) == http.MethodPost:
+		req.Route = fastRouteRegister
+	case string(path) == "/subscribe" && string(method) == http.MethodGet:
+		req.Route = fastRouteSubscribe
+	case string(path) != "/passgfw" && string(path) != "/subscribe":
+		return req, 0, &fastError{http.StatusNotFound, "Not found"}
+	default:
+		return req, 0, &fastError{http.StatusMethodNotAllowed, "Method not allowed"}
+	}
+
+	req.KeepAlive = string(version) == "HTTP/1.1"
+	length := -1
+	for len(rest) > 0 {
+		var field []byte
+		field, rest, _ = bytes.Cut(rest, crlf)
+		name, value, ok := bytes.Cut(field, []byte(":"))
+		if !ok {
+			return req, 0, &fastError{http.StatusBadRequest, "Malformed header"}
+		}
+		// A lone CR or LF would otherwise end up inside a header value
+		if bytes.ContainsAny(field, "\r\n") {
+			return req, 0, &fastError{http.StatusBadRequest, "Malformed header"}
+		}
+		value = bytes.TrimSpace(value)
+		switch {
+		case asciiEqualFold(name, "Content-Length"):
+			// Proxies disagree on which of several wins; refuse to guess
+			if length >= 0 {
+				return req, 0, &fastError{http.StatusBadRequest, "Duplicate Content-Length"}
+			}
+			v, err := strconv.Atoi(string(value))
+			if err != nil || v < 0 {
+				return req, 0, &fastError{http.StatusBadRequest, "Invalid Content-Length"}
+			}
+			length = v
+		case asciiEqualFold(name, "Transfer-Encoding"):
+			return req, 0, &fastError{http.StatusLengthRequired, "Content-Length required"}
+		case asciiEqualFold(name, "Connection"):
+			if asciiEqualFold(value, "close") {
+				req.KeepAlive = false
+			} else if asciiEqualFold(value, "keep-alive") {
+				req.KeepAlive = true
+			}
+		case asciiEqualFold(name, "Host"):
+			req.Host = value
+		case asciiEqualFold(name, probeIDHeader):
+			req.ProbeID = value
+		case asciiEqualFold(name, "traceparent"):
+			req.Traceparent = value
+		case asciiEqualFold(name, "X-Forwarded-For"):
+			req.Forwarded = value
+		}
+	}
+	if length < 0 && req.Route == fastRouteSubscribe {
+		length = 0
+	}
+	if length < 0 {
+		return req, 0, &fastError{http.StatusLengthRequired, "Content-Length required"}
+	}
+	if length > fastMaxBody {
+		return req, 0, &fastError{http.StatusRequestEntityTooLarge, "Body too large"}
+	}
+
+	total := end + len(headersEnd) + length
+	if len(buf) < total {
+		return req, 0, errFastIncomplete
+	}
+	req.Body = buf[end+len(headersEnd) : total]
+	return req, total, nil
+}
+
+// setupTrustedProxies parses -trusted-proxies; a bare IP is a single-host range
+func setupTrustedProxies() error {
+	for _, item := range strings.Split(trustedProxies, ",") {
+		item = strings.TrimSpace(item)
+		if item == "" {
+			continue
+		}
+		if !strings.Contains(item, "/") {
+			ip := net.ParseIP(item)
+			if ip == nil {
+				return fmt.Errorf("bad address %q", item)
+			}
+			bits := 128
+			if ip.To4() != nil {
+				bits = 32
+			}
+			item = fmt.Sprintf("%s/%d", item, bits)
+		}
+		_, ipnet, err := net.ParseCIDR(item)
+		if err != nil {
+			return err
+		}
+		proxyCIDRs = append(proxyCIDRs, item)
+		proxyRanges = append(proxyRanges, ipnet)
+	}
+	return nil
+}
+
+func trustedProxy(ip net.IP) bool {
+	for _, r := range proxyRanges {
+		if r.Contains(ip) {
+			return true
+		}
+	}
+	return false
+}
+
+// forwardedClientIP returns the client behind trusted proxies, as gin does:
+// X-Forwarded-For is walked from the right, skipping trusted hops. A peer
+// that is not a trusted proxy is the client, whatever the header says.
+func forwardedClientIP(peer string, forwarded []byte) string {
+	ip := net.ParseIP(peer)
+	if len(forwarded) == 0 || ip == nil || !trustedProxy(ip) {
+		return peer
+	}
+	hops := strings.Split(string(forwarded), ",")
+	for i := len(hops) - 1; i >= 0; i-- {
+		hop := strings.TrimSpace(hops[i])
+		ip := net.ParseIP(hop)
+		if ip == nil {
+			break
+		}
+		if i == 0 || !trustedProxy(ip) {
+			return hop
+		}
+	}
+	return peer
+}
+
+func asciiEqualFold(b []byte, s string) bool {
+	if len(b) != len(s) {
+		return false
+	}
+	for i := 0; i < len(b); i++ {
+		x, y := b[i], s[i]
+		if 'A' <= x && x <= 'Z' {
+			x += 'a' - 'A'
+		}
+		if 'A' <= y && y <= 'Z' {
+			y += 'a' - 'A'
+		}
+		if x != y {
+			return false
+		}
+	}
+	return true
+}
+
+// appendFastResponse serializes a reply as an HTTP/1.1 response
+func appendFastResponse(dst []byte, reply *passgfwReply, keepAlive bool) []byte {
+	dst = append(dst, "HTTP/1.1 "...)
+	dst = strconv.AppendInt(dst, int64(reply.Status), 10)
+	dst = append(dst, ' ')
+	dst = append(dst, http.StatusText(reply.Status)...)
+	if reply.Status != http.StatusNoContent {
+		dst = append(dst, "\r\nContent-Type: application/json; charset=utf-8\r\nContent-Length: "...)
+		dst = strconv.AppendInt(dst, int64(len(reply.Body)), 10)
+	}
+	if reply.ServerTiming != "" {
+		dst = append(dst, "\r\nServer-Timing: "...)
+		dst = append(dst, reply.ServerTiming...)
+	}
+	if reply.ProbeID != "" {
+		dst = append(dst, "\r\n"+probeIDHeader+": "...)
+		dst = append(dst, reply.ProbeID...)
+	}
+	if !keepAlive {
+		dst = append(dst, "\r\nConnection: close"...)
+	}
+	dst = append(dst, "\r\n\r\n"...)
+	return append(dst, reply.Body...)
+}
+
+// fastErrorReply answers requests the fast path rejects before the handler
+func fastErrorReply(e *fastError) *passgfwReply {
+	body, _ := json.Marshal(ErrorResponse{Error: e.msg})
+	return &passgfwReply{Status: e.status, Body: body}
+}
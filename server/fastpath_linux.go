@@ -0,0 +1,573 @@
+//go:build linux
+
+package main
+
+import (
+	"errors"
+	"fmt"
+	"log"
+	"net"
+	"net/http"
+	"net/url"
+	"os"
+	"sort"
+	"strconv"
+	"sync"
+	"sync/atomic"
+	"syscall"
+	"time"
+)
+
+const (
+	fastReadBuffer    = 64 << 10
+	fastEvents        = 256
+	fastSweepEvery    = time.Second
+	fastRequestExpiry = 10 * time.Second // Partial request or unsent reply
+	fastIdleExpiry    = 60 * time.Second // Keep-alive connection between requests
+)
+
+type eventLoop struct {
+	epfd  int
+	epf   *os.File        // epfd, for the sweep deadline
+	wait  syscall.RawConn // epfd registered with the runtime poller
+	lfd   int
+	conns map[int]*loopConn // Owned by the loop goroutine
+	buf   []byte            // Shared read buffer for every connection of this loop
+}
+
+// loopConn is one client connection. The loop goroutine reads and the
+// request goroutine writes; mu orders them and guards against fd reuse,
+// since the fd is only closed by the loop while holding mu.
+type loopConn struct {
+	mu      sync.Mutex
+	fd      int
+	epfd    int
+	peer    string
+	in      []byte    // Unparsed input
+	out     []byte    // Unsent output, flushed on EPOLLOUT
+	since   time.Time // Start of the current request, or last reply sent
+	busy    bool      // A request is being served
+	polling bool      // That request is a /subscribe long poll
+	eof     bool      // Peer half-closed; finish the reply, then close
+	closing bool      // Shut down once out drains
+	closed  bool
+	polled  bool  // Has long-polled /subscribe, may be in parked
+	held    int64 // Buffer capacity counted in fastBuffers
+}
+
+// fastBuffers tracks the connections holding input or output buffers, for
+// the memory governor. Lock order: loopConn.mu, then fastBuffers.
+var fastBuffers = &fastBufferSet{conns: make(map[*loopConn]struct{})}
+
+type fastBufferSet struct {
+	sync.Mutex
+	conns map[*loopConn]struct{}
+	held  atomic.Int64
+}
+
+// parkedPoll is a fast-path /subscribe long-poll that is up to date. It has
+// no goroutine: watchParkedPolls re-evaluates every parked poll when the
+// config changes and answers 204 once its wait runs out.
+type parkedPoll struct {
+	conn      *loopConn
+	poll      *subscribePoll
+	keepAlive bool
+	deadline  time.Time
+}
+
+var parked = struct {
+	sync.Mutex
+	polls map[*loopConn]*parkedPoll
+}{polls: make(map[*loopConn]*parkedPoll)}
+
+// startFastpath opens one SO_REUSEPORT listener per loop and runs the loops
+func startFastpath() error {
+	if fastpathPort == "" {
+		return nil
+	}
+	port, err := strconv.Atoi(fastpathPort)
+	if err != nil {
+		return fmt.Errorf("invalid -fastpath-port %q", fastpathPort)
+	}
+	for i := 0; i < max(fastpathLoops, 1); i++ {
+		l, err := newEventLoop(port)
+		if err != nil {
+			return err
+		}
+		go l.run()
+	}
+	go watchParkedPolls()
+	governor.register("fastpath", fastBuffers)
+	log.Printf("Fast path: :%d with %d event loops", port, max(fastpathLoops, 1))
+	return nil
+}
+
+func newEventLoop(port int) (*eventLoop, error) {
+	lfd, err := fastListen(port)
+	if err != nil {
+		return nil, fmt.Errorf("fast path listen: %w", err)
+	}
+	epfd, err := syscall.EpollCreate1(syscall.EPOLL_CLOEXEC)
+	if err != nil {
+		syscall.Close(lfd)
+		return nil, err
+	}
+	if err := syscall.EpollCtl(epfd, syscall.EPOLL_CTL_ADD, lfd,
+		&syscall.EpollEvent{Events: syscall.EPOLLIN, Fd: int32(lfd)}); err != nil {
+		syscall.Close(lfd)
+		syscall.Close(epfd)
+		return nil, err
+	}
+	// Blocking in epoll_wait would hold a P until sysmon retakes it, stalling
+	// the request goroutines. The epoll fd is itself pollable, so the loop
+	// parks in the runtime poller and only calls epoll_wait when it is ready.
+	if err := syscall.SetNonblock(epfd, true); err != nil {
+		syscall.Close(lfd)
+		syscall.Close(epfd)
+		return nil, err
+	}
+	epf := os.NewFile(uintptr(epfd), "epoll")
+	wait, err := epf.SyscallConn()
+	if err != nil {
+		syscall.Close(lfd)
+		return nil, err
+	}
+	return &eventLoop{epfd: epfd, epf: epf, wait: wait, lfd: lfd, conns: make(map[int]*loopConn), buf: make([]byte, fastReadBuffer)}, nil
+}
+
+// fastListen binds a non-blocking dual-stack listener, falling back to IPv4
+func fastListen(port int) (int, error) {
+	fd, err := syscall.Socket(syscall.AF_INET6, syscall.SOCK_STREAM|syscall.SOCK_NONBLOCK|syscall.SOCK_CLOEXEC, 0)
+	var sa syscall.Sockaddr = &syscall.SockaddrInet6{Port: port}
+	if err == nil {
+		syscall.SetsockoptInt(fd, syscall.IPPROTO_IPV6, syscall.IPV6_V6ONLY, 0)
+	} else {
+		fd, err = syscall.Socket(syscall.AF_INET, syscall.SOCK_STREAM|syscall.SOCK_NONBLOCK|syscall.SOCK_CLOEXEC, 0)
+		if err != nil {
+			return -1, err
+		}
+		sa = &syscall.SockaddrInet4{Port: port}
+	}
+
+	if err := syscall.SetsockoptInt(fd, syscall.SOL_SOCKET, syscall.SO_REUSEADDR, 1); err != nil {
+		syscall.Close(fd)
+		return -1, err
+	}
+	const soReusePort = 0xf // SO_REUSEPORT, missing from package syscall
+	if err := syscall.SetsockoptInt(fd, syscall.SOL_SOCKET, soReusePort, 1); err != nil {
+		syscall.Close(fd)
+		return -1, err
+	}
+	if err := tuneListener(fd); err != nil {
+		syscall.Close(fd)
+		return -1, err
+	}
+	if err := syscall.Bind(fd, sa); err != nil {
+		syscall.Close(fd)
+		return -1, err
+	}
+	if err := syscall.Listen(fd, backlog()); err != nil {
+		syscall.Close(fd)
+		return -1, err
+	}
+	return fd, nil
+}
+
+func (l *eventLoop) run() {
+	events := make([]syscall.EpollEvent, fastEvents)
+	nextSweep := time.Now().Add(fastSweepEvery)
+	for {
+		// The read deadline wakes the loop for the sweep when it is quiet
+		l.epf.SetReadDeadline(nextSweep)
+		var n int
+		var werr error
+		err := l.wait.Read(func(uintptr) bool {
+			n, werr = syscall.EpollWait(l.epfd, events, 0)
+			return n > 0 || (werr != nil && werr != syscall.EINTR)
+		})
+		if err == nil {
+			err = werr
+		}
+		if now := time.Now(); !now.Before(nextSweep) {
+			l.sweep(now)
+			nextSweep = now.Add(fastSweepEvery)
+		}
+		if errors.Is(err, os.ErrDeadlineExceeded) {
+			continue
+		}
+		if err != nil {
+			log.Printf("Fast path: epoll_wait: %v", err)
+			return
+		}
+		for i := 0; i < n; i++ {
+			fd := int(events[i].Fd)
+			if fd == l.lfd {
+				l.accept()
+				continue
+			}
+			if c := l.conns[fd]; c != nil {
+				l.handle(c, events[i].Events)
+			}
+		}
+	}
+}
+
+func (l *eventLoop) accept() {
+	for {
+		fd, sa, err := syscall.Accept4(l.lfd, syscall.SOCK_NONBLOCK|syscall.SOCK_CLOEXEC)
+		if err != nil {
+			if err != syscall.EAGAIN && err != syscall.ECONNABORTED && err != syscall.EINTR {
+				log.Printf("Fast path: accept: %v", err)
+			}
+			return
+		}
+		if tcpNoDelay {
+			syscall.SetsockoptInt(fd, syscall.IPPROTO_TCP, syscall.TCP_NODELAY, 1)
+		}
+
+		c := &loopConn{fd: fd, epfd: l.epfd, peer: sockaddrIP(sa), since: time.Now()}
+		if err := syscall.EpollCtl(l.epfd, syscall.EPOLL_CTL_ADD, fd,
+			&syscall.EpollEvent{Events: syscall.EPOLLIN | syscall.EPOLLRDHUP, Fd: int32(fd)}); err != nil {
+			syscall.Close(fd)
+			continue
+		}
+		l.conns[fd] = c
+	}
+}
+
+func (l *eventLoop) handle(c *loopConn, events uint32) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	defer c.account()
+
+	if events&syscall.EPOLLOUT != 0 {
+		if !c.flush() {
+			l.close(c)
+			return
+		}
+	}
+	if events&(syscall.EPOLLIN|syscall.EPOLLRDHUP|syscall.EPOLLHUP|syscall.EPOLLERR) != 0 {
+		for {
+			n, err := syscall.Read(c.fd, l.buf)
+			if n > 0 {
+				if len(c.in) == 0 && !c.busy {
+					c.since = time.Now() // A new request starts
+				}
+				c.in = append(c.in, l.buf[:n]...)
+				if len(c.in) > fastMaxHeader+fastMaxBody {
+					l.close(c) // Pipelining far ahead of the responses
+					return
+				}
+				if n < len(l.buf) {
+					break
+				}
+				continue
+			}
+			if err == syscall.EAGAIN {
+				break
+			}
+			if err == syscall.EINTR {
+				continue
+			}
+			// On a half-close the reply being computed or sent is still
+			// delivered; a parked long poll or an error ends the connection
+			if n == 0 && err == nil && ((c.busy && !c.polling) || len(c.out) > 0) {
+				c.eof, c.closing, c.in = true, true, nil
+				c.rearm()
+				return
+			}
+			l.close(c)
+			return
+		}
+	}
+	if !c.busy && !c.closing && len(c.out) == 0 {
+		c.next()
+	}
+}
+
+// next dispatches the next complete request, if any. Called with mu held.
+func (c *loopConn) next() {
+	req, n, err := parseFastRequest(c.in)
+	if err == errFastIncomplete {
+		return
+	}
+	if fe, ok := err.(*fastError); ok {
+		c.in = nil
+		c.writeLocked(appendFastResponse(nil, fastErrorReply(fe), false), false)
+		return
+	}
+
+	// Copy out of c.in: the loop keeps appending to it while the request runs
+	call := &passgfwRequest{
+		Body:        append([]byte(nil), req.Body...),
+		Host:        string(req.Host),
+		ClientIP:    forwardedClientIP(c.peer, req.Forwarded),
+		ProbeID:     string(req.ProbeID),
+		Traceparent: string(req.Traceparent),
+	}
+	keepAlive := req.KeepAlive
+	route, query := req.Route, string(req.Query)
+	c.in = c.in[n:]
+	if len(c.in) == 0 {
+		c.in = nil
+	}
+	c.busy, c.polling = true, route == fastRouteSubscribe
+
+	switch route {
+	case fastRouteSubscribe:
+		c.polled = true
+		go c.poll(query, keepAlive)
+	case fastRouteRegister:
+		go func() {
+			reply := serveSubscribeRegister(call)
+			c.complete(&reply, keepAlive)
+		}()
+	default:
+		// The crypto slot semaphore in servePassGFW bounds how many of these run
+		go func() {
+			reply := servePassGFW(call)
+			c.complete(&reply, keepAlive)
+		}()
+	}
+}
+
+// complete writes the reply to the request being served
+func (c *loopConn) complete(reply *passgfwReply, keepAlive bool) {
+	resp := appendFastResponse(make([]byte, 0, 256+len(reply.Body)), reply, keepAlive)
+
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	if c.closed {
+		return
+	}
+	defer c.account()
+	c.busy, c.polling = false, false
+	c.since = time.Now()
+	c.writeLocked(resp, keepAlive)
+	if !c.closing && len(c.out) == 0 {
+		c.next() // Pipelined request already buffered
+	}
+}
+
+func (c *loopConn) poll(query string, keepAlive bool) {
+	q, _ := url.ParseQuery(query)
+	poll, errReply := parseSubscribePoll(q)
+	if errReply != nil {
+		c.complete(errReply, keepAlive)
+		return
+	}
+	evaluatePoll(&parkedPoll{conn: c, poll: poll, keepAlive: keepAlive, deadline: time.Now().Add(poll.wait)})
+}
+
+// evaluatePoll answers the poll if its state is stale, or parks it
+func evaluatePoll(p *parkedPoll) {
+	for {
+		reply, changed, ready := pollSubscription(p.poll)
+		if ready {
+			p.conn.complete(&reply, p.keepAlive)
+			return
+		}
+		parked.Lock()
+		select {
+		case <-changed:
+			parked.Unlock()
+			continue // Changed while evaluating
+		default:
+		}
+		parked.polls[p.conn] = p
+		parked.Unlock()
+		return
+	}
+}
+
+func watchParkedPolls() {
+	tick := time.NewTicker(time.Second)
+	defer tick.Stop()
+	for {
+		select {
+		case <-configChanged():
+			parked.Lock()
+			polls := parked.polls
+			parked.polls = make(map[*loopConn]*parkedPoll, len(polls))
+			parked.Unlock()
+			for _, p := range polls {
+				evaluatePoll(p)
+			}
+		case now := <-tick.C:
+			var expired []*parkedPoll
+			parked.Lock()
+			for c, p := range parked.polls {
+				if now.After(p.deadline) {
+					expired = append(expired, p)
+					delete(parked.polls, c)
+				}
+			}
+			parked.Unlock()
+			for _, p := range expired {
+				p.conn.complete(&passgfwReply{Status: http.StatusNoContent}, p.keepAlive)
+			}
+		}
+	}
+}
+
+// writeLocked writes resp, queueing any remainder for EPOLLOUT. Without
+// keep-alive the socket is shut down, which the loop sees as EOF and closes.
+func (c *loopConn) writeLocked(resp []byte, keepAlive bool) {
+	c.out = append(c.out, resp...)
+	c.closing = c.closing || !keepAlive
+	if !c.flush() {
+		syscall.Shutdown(c.fd, syscall.SHUT_RDWR)
+	}
+}
+
+// flush writes pending output and arms EPOLLOUT if some remains.
+// It returns false if the connection failed.
+func (c *loopConn) flush() bool {
+	for len(c.out) > 0 {
+		n, err := syscall.Write(c.fd, c.out)
+		if n > 0 {
+			c.out = c.out[n:]
+			c.since = time.Now()
+			continue
+		}
+		if err == syscall.EINTR {
+			continue
+		}
+		if err == syscall.EAGAIN {
+			c.rearm()
+			return true
+		}
+		return false
+	}
+	c.out = nil
+	c.rearm()
+	if c.closing {
+		// Both directions shut down raise EPOLLHUP, so the loop closes it
+		syscall.Shutdown(c.fd, syscall.SHUT_RDWR)
+	}
+	return true
+}
+
+// rearm sets the epoll interest: input until the peer half-closes (a
+// level-triggered EOF would fire forever), output while some is pending
+func (c *loopConn) rearm() {
+	var events uint32
+	if !c.eof {
+		events = syscall.EPOLLIN | syscall.EPOLLRDHUP
+	}
+	if len(c.out) > 0 {
+		events |= syscall.EPOLLOUT
+	}
+	syscall.EpollCtl(c.epfd, syscall.EPOLL_CTL_MOD, c.fd, &syscall.EpollEvent{Events: events, Fd: int32(c.fd)})
+}
+
+// sweep closes connections that stalled: a partial request or an unsent
+// reply older than fastRequestExpiry, or an idle keep-alive connection older
+// than fastIdleExpiry. Requests being served are bounded elsewhere.
+func (l *eventLoop) sweep(now time.Time) {
+	for _, c := range l.conns {
+		c.mu.Lock()
+		expiry := fastIdleExpiry
+		if len(c.in) > 0 || len(c.out) > 0 || c.eof {
+			expiry = fastRequestExpiry
+		}
+		if !c.busy && now.Sub(c.since) > expiry {
+			l.close(c)
+		}
+		c.mu.Unlock()
+	}
+}
+
+// close releases the fd. Called by the loop with mu held.
+func (l *eventLoop) close(c *loopConn) {
+	if c.closed {
+		return
+	}
+	c.closed = true
+	if c.polled {
+		parked.Lock()
+		delete(parked.polls, c)
+		parked.Unlock()
+	}
+	delete(l.conns, c.fd)
+	syscall.Close(c.fd)
+	c.in, c.out = nil, nil
+	c.account()
+}
+
+// account updates fastBuffers after in or out changed. Called with mu held.
+func (c *loopConn) account() {
+	held := int64(cap(c.in) + cap(c.out))
+	if held == c.held {
+		return
+	}
+	fastBuffers.held.Add(held - c.held)
+	if (held > 0) != (c.held > 0) {
+		fastBuffers.Lock()
+		if held > 0 {
+			fastBuffers.conns[c] = struct{}{}
+		} else {
+			delete(fastBuffers.conns, c)
+		}
+		fastBuffers.Unlock()
+	}
+	c.held = held
+}
+
+func (b *fastBufferSet) MemoryUsage() int64 {
+	return b.held.Load()
+}
+
+// Evict shuts down the connections that have held a partial request or an
+// unsent reply the longest; their loops close them on the resulting hangup.
+// Connections with a request being served are left alone.
+func (b *fastBufferSet) Evict(n int64) int64 {
+	type candidate struct {
+		c     *loopConn
+		since time.Time
+	}
+	b.Lock()
+	candidates := make([]candidate, 0, len(b.conns))
+	for c := range b.conns {
+		candidates = append(candidates, candidate{c: c})
+	}
+	b.Unlock()
+	for i := range candidates {
+		c := candidates[i].c
+		c.mu.Lock()
+		candidates[i].since = c.since
+		c.mu.Unlock()
+	}
+	sort.Slice(candidates, func(i, j int) bool { return candidates[i].since.Before(candidates[j].since) })
+
+	var freed int64
+	for _, cand := range candidates {
+		if freed >= n {
+			break
+		}
+		c := cand.c
+		c.mu.Lock()
+		if !c.busy && !c.closed && c.held > 0 {
+			freed += c.held
+			c.in, c.out, c.closing = nil, nil, true
+			syscall.Shutdown(c.fd, syscall.SHUT_RDWR)
+			c.account()
+		}
+		c.mu.Unlock()
+	}
+	return freed
+}
+
+func sockaddrIP(sa syscall.Sockaddr) string {
+	switch a := sa.(type) {
+	case *syscall.SockaddrInet4:
+		return net.IP(a.Addr[:]).String()
+	case *syscall.SockaddrInet6:
+		ip := net.IP(a.Addr[:])
+		if v4 := ip.To4(); v4 != nil {
+			return v4.String()
+		}
+		return ip.String()
+	}
+	return ""
+}
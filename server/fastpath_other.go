@@ -0,0 +1,12 @@
+//go:build !linux
+
+package main
+
+import "errors"
+
+func startFastpath() error {
+	if fastpathPort == "" {
+		return nil
+	}
+	return errors.New("fast path requires linux")
+}
@@ -0,0 +1,365 @@
+package main
+
+import (
+	"crypto/ed25519"
+	"crypto/rsa"
+	"crypto/x509"
+	"encoding/json"
+	"encoding/pem"
+	"errors"
+	"fmt"
+	"io"
+	"log"
+	"net/http"
+	"os"
+	"path/filepath"
+	"strconv"
+	"sync"
+	"sync/atomic"
+	"time"
+
+	"github.com/gin-gonic/gin"
+)
+
+// Fleet configuration distribution.
+//
+// The publisher signs its active runtimeConfig as a versioned snapshot and
+// exposes it in a shared directory and at /fleet/snapshot. Followers poll
+// either source, verify the Ed25519 signature, rebuild a runtimeConfig and
+// swap it in whole, so a request never sees a half-applied update.
+//
+// The RSA private key is not part of the snapshot. Every node is given the
+// same -private-key out of band; a snapshot names the key by fingerprint and
+// followers holding a different key reject it.
+
+const fleetSnapshotFile = "snapshot.json"
+
+// fleetClient bounds each HTTP poll so a stalled publisher cannot hang followLoop
+var fleetClient = &http.Client{Timeout: 10 * time.Second}
+
+var (
+	fleetRole    string        // "", "publish" or "follow"
+	fleetDir     string        // Shared snapshot directory
+	fleetSource  string        // Publisher URL for HTTP following
+	fleetKeyPath string        // Ed25519 PEM: private (publish) or public (follow)
+	fleetPoll    time.Duration // Follower poll interval
+
+	fleetSignKey   ed25519.PrivateKey
+	fleetVerifyKey ed25519.PublicKey
+
+	publishedEnvelope atomic.Pointer[[]byte]
+	publishMu         sync.Mutex
+
+	fleetState fleetStatus
+)
+
+// ConfigSnapshot is the distributed form of runtimeConfig
+type ConfigSnapshot struct {
+	Version   uint64               `json:"version"`
+	Published int64                `json:"published"` // Unix milliseconds
+	KeyID     string               `json:"key_id"`    // Fingerprint of the RSA key the config is served with
+	Domain    string               `json:"domain"`
+	Backends  []Backend            `json:"backends"`
+	Pools     map[string][]Backend `json:"pools,omitempty"`
+	Routes    map[string]string    `json:"routes"`
+	URLs      []URLEntry           `json:"urls"`
+}
+
+// SignedSnapshot carries the exact snapshot bytes that were signed
+type SignedSnapshot struct {
+	Snapshot  json.RawMessage `json:"snapshot"`
+	Signature []byte          `json:"signature"`
+}
+
+type fleetStatus struct {
+	mu            sync.Mutex
+	PublishedAt   int64   `json:"published_at"`
+	AppliedAt     int64   `json:"applied_at"`
+	PropagationMs float64 `json:"propagation_ms"`
+	LastCheck     int64   `json:"last_check"`
+	LastError     string  `json:"last_error,omitempty"`
+}
+
+func setupFleet() error {
+	switch fleetRole {
+	case "":
+		return nil
+	case "publish":
+		// The snapshot and the routing API are served behind adminAuth(),
+		// which lets everything through without credentials
+		if adminUser == "" || adminPass == "" {
+			return fmt.Errorf("publish mode needs -admin-user and -admin-pass")
+		}
+		if err := loadFleetKey(true); err != nil {
+			return err
+		}
+		return publishConfig(currentConfig())
+	case "follow":
+		if fleetDir == "" && fleetSource == "" {
+			return fmt.Errorf("follow mode needs -fleet-dir or -fleet-source")
+		}
+		if err := loadFleetKey(false); err != nil {
+			return err
+		}
+		go followLoop()
+		return nil
+	default:
+		return fmt.Errorf("unknown fleet role %q", fleetRole)
+	}
+}
+
+func loadFleetKey(private bool) error {
+	data, err := os.ReadFile(fleetKeyPath)
+	if err != nil {
+		return fmt.Errorf("fleet key: %w", err)
+	}
+	block, _ := pem.Decode(data)
+	if block == nil {
+		return fmt.Errorf("fleet key: invalid PEM")
+	}
+
+	if private {
+		parsed, err := x509.ParsePKCS8PrivateKey(block.Bytes)
+		if err != nil {
+			return fmt.Errorf("fleet key: %w", err)
+		}
+		key, ok := parsed.(ed25519.PrivateKey)
+		if !ok {
+			return fmt.Errorf("fleet key: not an Ed25519 private key")
+		}
+		fleetSignKey = key
+		fleetVerifyKey = key.Public().(ed25519.PublicKey)
+		return nil
+	}
+
+	parsed, err := x509.ParsePKIXPublicKey(block.Bytes)
+	if err != nil {
+		return fmt.Errorf("fleet key: %w", err)
+	}
+	key, ok := parsed.(ed25519.PublicKey)
+	if !ok {
+		return fmt.Errorf("fleet key: not an Ed25519 public key")
+	}
+	fleetVerifyKey = key
+	return nil
+}
+
+// publishConfig stamps cfg with a new version, activates it locally and
+// writes the signed snapshot. It is a no-op unless this node publishes.
+func publishConfig(cfg *runtimeConfig) error {
+	if fleetRole != "publish" {
+		return nil
+	}
+	publishMu.Lock()
+	defer publishMu.Unlock()
+
+	now := time.Now()
+	version := nextVersion(now)
+
+	next := *cfg
+	next.Version = version
+	snapshot, err := json.Marshal(ConfigSnapshot{
+		Version:   version,
+		Published: now.UnixMilli(),
+		KeyID:     keyID(next.PrivateKey),
+		Domain:    next.Domain,
+		Backends:  next.Backends,
+		Pools:     next.Pools,
+		Routes:    next.Routes,
+		URLs:      next.URLs,
+	})
+	if err != nil {
+		return err
+	}
+	envelope, err := json.Marshal(SignedSnapshot{
+		Snapshot:  snapshot,
+		Signature: ed25519.Sign(fleetSignKey, snapshot),
+	})
+	if err != nil {
+		return err
+	}
+
+	if fleetDir != "" {
+		if err := writeFileAtomic(filepath.Join(fleetDir, fleetSnapshotFile), envelope); err != nil {
+			return err
+		}
+	}
+
+	publishedEnvelope.Store(&envelope)
+	storeConfig(&next)
+	fleetState.record(func(s *fleetStatus) {
+		s.PublishedAt = now.UnixMilli()
+		s.AppliedAt = now.UnixMilli()
+		s.PropagationMs = 0
+		s.LastError = ""
+	})
+	log.Printf("Fleet: published config version %d", version)
+	return nil
+}
+
+// writeFileAtomic writes via a temp file and rename so readers never see a partial file
+func writeFileAtomic(path string, data []byte) error {
+	tmp, err := os.CreateTemp(filepath.Dir(path), ".snapshot-*")
+	if err != nil {
+		return err
+	}
+	defer os.Remove(tmp.Name())
+
+	if _, err := tmp.Write(data); err != nil {
+		tmp.Close()
+		return err
+	}
+	if err := tmp.Sync(); err != nil {
+		tmp.Close()
+		return err
+	}
+	if err := tmp.Close(); err != nil {
+		return err
+	}
+	return os.Rename(tmp.Name(), path)
+}
+
+func followLoop() {
+	for {
+		envelope, err := fetchSnapshot()
+		if err == nil && envelope != nil {
+			err = applySnapshot(envelope)
+		}
+		fleetState.record(func(s *fleetStatus) {
+			s.LastCheck = time.Now().UnixMilli()
+			if err != nil {
+				s.LastError = err.Error()
+			}
+		})
+		if err != nil {
+			log.Printf("Fleet: %v", err)
+		}
+		time.Sleep(fleetPoll)
+	}
+}
+
+// fetchSnapshot returns nil when the source has nothing newer
+func fetchSnapshot() ([]byte, error) {
+	if fleetDir != "" {
+		return os.ReadFile(filepath.Join(fleetDir, fleetSnapshotFile))
+	}
+
+	req, err := http.NewRequest(http.MethodGet, fleetSource, nil)
+	if err != nil {
+		return nil, err
+	}
+	if cfg := currentConfig(); cfg != nil && cfg.Version > 0 {
+		req.Header.Set("If-None-Match", strconv.FormatUint(cfg.Version, 10))
+	}
+
+	resp, err := fleetClient.Do(req)
+	if err != nil {
+		return nil, err
+	}
+	defer resp.Body.Close()
+
+	switch resp.StatusCode {
+	case http.StatusOK:
+		return io.ReadAll(io.LimitReader(resp.Body, 1<<20))
+	case http.StatusNotModified:
+		return nil, nil
+	default:
+		return nil, fmt.Errorf("snapshot source returned HTTP %d", resp.StatusCode)
+	}
+}
+
+var errStaleSnapshot = errors.New("stale snapshot")
+
+// applySnapshot verifies, validates and swaps in a newer snapshot
+func applySnapshot(envelope []byte) error {
+	var signed SignedSnapshot
+	if err := json.Unmarshal(envelope, &signed); err != nil {
+		return fmt.Errorf("decode envelope: %w", err)
+	}
+	if !ed25519.Verify(fleetVerifyKey, signed.Snapshot, signed.Signature) {
+		return fmt.Errorf("snapshot signature invalid")
+	}
+
+	var snap ConfigSnapshot
+	if err := json.Unmarshal(signed.Snapshot, &snap); err != nil {
+		return fmt.Errorf("decode snapshot: %w", err)
+	}
+	if cur := currentConfig(); cur != nil && snap.Version <= cur.Version {
+		if snap.Version < cur.Version {
+			return errStaleSnapshot
+		}
+		return nil
+	}
+
+	key := currentConfig().PrivateKey
+	if id := keyID(key); snap.KeyID != id {
+		return fmt.Errorf("snapshot %d is for key %s, this node holds %s (check -private-key)", snap.Version, snap.KeyID, id)
+	}
+	next := &runtimeConfig{
+		Version:    snap.Version,
+		PrivateKey: key,
+		Domain:     snap.Domain,
+		Backends:   snap.Backends,
+		Pools:      snap.Pools,
+		Routes:     snap.Routes,
+		URLs:       snap.URLs,
+	}
+	if err := next.prepare(); err != nil {
+		return fmt.Errorf("snapshot %d rejected: %w", snap.Version, err)
+	}
+
+	storeConfig(next)
+
+	now := time.Now().UnixMilli()
+	propagation := float64(now - snap.Published)
+	fleetState.record(func(s *fleetStatus) {
+		s.PublishedAt = snap.Published
+		s.AppliedAt = now
+		s.PropagationMs = propagation
+		s.LastError = ""
+	})
+	log.Printf("Fleet: applied config version %d (propagation %.0fms)", snap.Version, propagation)
+	return nil
+}
+
+// keyID fingerprints the public half of key
+func keyID(key *rsa.PrivateKey) string {
+	return shortHash(x509.MarshalPKCS1PublicKey(&key.PublicKey))
+}
+
+func (s *fleetStatus) record(update func(*fleetStatus)) {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	update(s)
+}
+
+func handleFleetSnapshot(c *gin.Context) {
+	envelope := publishedEnvelope.Load()
+	if envelope == nil {
+		c.JSON(http.StatusNotFound, ErrorResponse{Error: "Not a publisher"})
+		return
+	}
+
+	version := strconv.FormatUint(currentConfig().Version, 10)
+	c.Header("ETag", version)
+	if c.GetHeader("If-None-Match") == version {
+		c.Status(http.StatusNotModified)
+		return
+	}
+	c.Data(http.StatusOK, "application/json", *envelope)
+}
+
+func handleFleetStatus(c *gin.Context) {
+	fleetState.mu.Lock()
+	defer fleetState.mu.Unlock()
+
+	c.JSON(http.StatusOK, gin.H{
+		"role":           fleetRole,
+		"config_version": currentConfig().Version,
+		"published_at":   fleetState.PublishedAt,
+		"applied_at":     fleetState.AppliedAt,
+		"propagation_ms": fleetState.PropagationMs,
+		"last_check":     fleetState.LastCheck,
+		"last_error":     fleetState.LastError,
+	})
+}
@@ -0,0 +1,302 @@
+package main
+
+import (
+	"encoding/binary"
+	"fmt"
+	"log"
+	"os"
+	"path/filepath"
+	"sort"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"time"
+	"unsafe"
+)
+
+// Request journal: fixed-width binary records appended into memory-mapped
+// segment files. Appending claims a slot with one atomic add and never takes
+// a lock; only rotating to a new segment is serialized.
+//
+// Segment layout (little endian), shared with cmd/pgfw-journal:
+//
+//	slot 0   header: magic[8] "PGFWJRN1", record size u32, slot count u32
+//	slot 1.. records of journalRecordSize bytes:
+//	  0  ts         i64  unix nanos, stored last; 0 means unwritten
+//	  8  total_us   u32
+//	  12 decrypt_us u32
+//	  16 route_us   u32
+//	  20 sign_us    u32
+//	  24 status     u16  HTTP status
+//	  26 result     u8   journalResult*
+//	  27 os         u8   journalOS*
+//	  28 queue_us   u32  wait for a crypto slot
+//	  32 app        [32]byte
+//	  64 data class [16]byte
+//	  80 domain     [48]byte
+const (
+	journalMagic      = "PGFWJRN1"
+	journalRecordSize = 128
+	journalSegmentExt = ".seg"
+)
+
+// Request results
+const (
+	journalResultOK uint8 = iota
+	journalResultBadBody
+	journalResultDecrypt
+	journalResultBadPayload
+	journalResultShed
+	journalResultInternal
+)
+
+// Client operating systems
+const (
+	journalOSUnknown uint8 = iota
+	journalOSAndroid
+	journalOSIOS
+	journalOSMacOS
+	journalOSHarmony
+	journalOSOther
+)
+
+var (
+	journalDir       string
+	journalSegmentMB int
+	journalKeep      int
+
+	requestJournal *journal
+)
+
+// journalEntry is the per-request metadata captured by handlePassGFW.
+// It also feeds the Server-Timing header.
+type journalEntry struct {
+	Start   time.Time
+	Queue   time.Duration
+	Decrypt time.Duration
+	Route   time.Duration
+	Sign    time.Duration
+	Status  int
+	Result  uint8
+	OS      string
+	App     string
+	Data    string
+	Domain  string
+}
+
+type journal struct {
+	dir    string
+	slots  uint64
+	keep   int
+	cur    atomic.Pointer[journalSegment]
+	rotate sync.Mutex
+	closed atomic.Bool
+}
+
+type journalSegment struct {
+	path   string
+	data   []byte
+	slots  uint64
+	next   atomic.Uint64 // Next free slot
+	refs   atomic.Int64  // Appenders currently writing
+	closed atomic.Bool
+}
+
+func openJournal(dir string, segmentMB, keep int) (*journal, error) {
+	if err := os.MkdirAll(dir, 0o755); err != nil {
+		return nil, err
+	}
+	j := &journal{
+		dir:   dir,
+		slots: uint64(segmentMB) << 20 / journalRecordSize,
+		keep:  keep,
+	}
+	if j.slots < 2 {
+		return nil, fmt.Errorf("segment too small")
+	}
+	seg, err := j.newSegment()
+	if err != nil {
+		return nil, err
+	}
+	j.cur.Store(seg)
+	return j, nil
+}
+
+func (j *journal) newSegment() (*journalSegment, error) {
+	path := filepath.Join(j.dir, fmt.Sprintf("journal-%d%s", time.Now().UnixNano(), journalSegmentExt))
+	data, err := mapSegment(path, int(j.slots*journalRecordSize))
+	if err != nil {
+		return nil, err
+	}
+	copy(data, journalMagic)
+	binary.LittleEndian.PutUint32(data[8:], journalRecordSize)
+	binary.LittleEndian.PutUint32(data[12:], uint32(j.slots))
+
+	seg := &journalSegment{path: path, data: data, slots: j.slots}
+	seg.next.Store(1)
+	return seg, nil
+}
+
+// Append writes one record. It is safe for concurrent use and lock-free
+// except when the current segment is full.
+func (j *journal) Append(e *journalEntry) {
+	for !j.closed.Load() {
+		seg := j.cur.Load()
+		seg.refs.Add(1)
+		if seg.closed.Load() {
+			seg.refs.Add(-1)
+			continue
+		}
+
+		slot := seg.next.Add(1) - 1
+		if slot < seg.slots {
+			encodeJournalRecord(seg.data[slot*journalRecordSize:(slot+1)*journalRecordSize], e)
+			seg.refs.Add(-1)
+			return
+		}
+		seg.refs.Add(-1)
+
+		if err := j.rotateFrom(seg); err != nil {
+			log.Printf("Journal: rotate failed: %v", err)
+			return
+		}
+	}
+}
+
+// rotateFrom replaces full with a fresh segment unless another appender already did
+func (j *journal) rotateFrom(full *journalSegment) error {
+	j.rotate.Lock()
+	defer j.rotate.Unlock()
+	if j.cur.Load() != full {
+		return nil
+	}
+
+	seg, err := j.newSegment()
+	if err != nil {
+		return err
+	}
+	j.cur.Store(seg)
+	full.closed.Store(true)
+
+	go func() {
+		// Appenders that claimed a slot before the swap finish first
+		for full.refs.Load() > 0 {
+			time.Sleep(time.Millisecond)
+		}
+		if err := unmapSegment(full.data); err != nil {
+			log.Printf("Journal: unmap %s: %v", full.path, err)
+		}
+		j.enforceRetention()
+	}()
+	return nil
+}
+
+// Close stops appends and unmaps the current segment once in-flight appenders finish
+func (j *journal) Close() {
+	if j == nil {
+		return
+	}
+	j.rotate.Lock()
+	defer j.rotate.Unlock()
+	if j.closed.Swap(true) {
+		return
+	}
+	seg := j.cur.Load()
+	seg.closed.Store(true)
+	for seg.refs.Load() > 0 {
+		time.Sleep(time.Millisecond)
+	}
+	if err := unmapSegment(seg.data); err != nil {
+		log.Printf("Journal: unmap %s: %v", seg.path, err)
+	}
+}
+
+// mappedBytes is the size of the segment currently mapped for appends.
+// It lives in the page cache, not the Go heap, so the governor only reports it.
+func (j *journal) mappedBytes() int64 {
+	if j == nil {
+		return 0
+	}
+	return int64(j.slots * journalRecordSize)
+}
+
+// enforceRetention deletes the oldest segments beyond the keep limit
+func (j *journal) enforceRetention() {
+	matches, err := filepath.Glob(filepath.Join(j.dir, "journal-*"+journalSegmentExt))
+	if err != nil || len(matches) <= j.keep {
+		return
+	}
+	sort.Strings(matches)
+	for _, path := range matches[:len(matches)-j.keep] {
+		if path == j.cur.Load().path {
+			continue
+		}
+		if err := os.Remove(path); err != nil {
+			log.Printf("Journal: retention: %v", err)
+		}
+	}
+}
+
+func encodeJournalRecord(rec []byte, e *journalEntry) {
+	le := binary.LittleEndian
+	le.PutUint32(rec[8:], micros(time.Since(e.Start)))
+	le.PutUint32(rec[12:], micros(e.Decrypt))
+	le.PutUint32(rec[16:], micros(e.Route))
+	le.PutUint32(rec[20:], micros(e.Sign))
+	le.PutUint16(rec[24:], uint16(e.Status))
+	rec[26] = e.Result
+	rec[27] = journalOSCode(e.OS)
+	le.PutUint32(rec[28:], micros(e.Queue))
+	putFixed(rec[32:64], e.App)
+	putFixed(rec[64:80], journalDataClass(e.Data))
+	putFixed(rec[80:128], e.Domain)
+
+	// Timestamp last: a non-zero ts marks the record complete for readers
+	atomic.StoreInt64((*int64)(unsafe.Pointer(&rec[0])), e.Start.UnixNano())
+}
+
+func micros(d time.Duration) uint32 {
+	us := d.Microseconds()
+	if us > 1<<32-1 {
+		return 1<<32 - 1
+	}
+	return uint32(us)
+}
+
+func putFixed(dst []byte, s string) {
+	n := copy(dst, s)
+	clear(dst[n:])
+}
+
+func journalOSCode(os string) uint8 {
+	switch strings.ToLower(os) {
+	case "":
+		return journalOSUnknown
+	case "android":
+		return journalOSAndroid
+	case "ios":
+		return journalOSIOS
+	case "macos":
+		return journalOSMacOS
+	case "harmonyos":
+		return journalOSHarmony
+	default:
+		return journalOSOther
+	}
+}
+
+// journalDataClass keeps routing keys verbatim and buckets everything else,
+// so free-form client data never lands in the journal
+func journalDataClass(data string) string {
+	if _, ok := currentConfig().Routes[data]; ok {
+		return data
+	}
+	switch {
+	case data == "":
+		return "empty"
+	case strings.HasPrefix(data, "{"):
+		return "json"
+	default:
+		return "other"
+	}
+}
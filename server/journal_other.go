@@ -0,0 +1,13 @@
+//go:build !unix
+
+package main
+
+import "errors"
+
+func mapSegment(path string, size int) ([]byte, error) {
+	return nil, errors.New("request journal requires a unix platform")
+}
+
+func unmapSegment(data []byte) error {
+	return nil
+}
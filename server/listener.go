@@ -0,0 +1,84 @@
+package main
+
+import (
+	"context"
+	"net"
+	"os"
+	"strconv"
+	"strings"
+	"syscall"
+	"time"
+)
+
+// Listener socket tuning shared by the gin port and the fast path. Probes
+// are one short request per connection, so the handshake dominates: TCP Fast
+// Open lets a returning client carry the request in its SYN, and
+// TCP_DEFER_ACCEPT keeps connections out of accept() until data arrives.
+
+var (
+	tcpFastOpen    int           // Pending fast-open queue length (0 disables)
+	tcpDeferAccept time.Duration // Wait for data before accept (0 disables)
+	listenBacklog  int           // Accept backlog (0 uses net.core.somaxconn)
+	tcpNoDelay     bool          // Disable Nagle on accepted connections
+)
+
+// listenTCP opens the gin listener with the tuning flags applied
+func listenTCP(addr string) (net.Listener, error) {
+	lc := net.ListenConfig{Control: func(network, address string, c syscall.RawConn) error {
+		var err error
+		if cerr := c.Control(func(fd uintptr) { err = tuneListener(int(fd)) }); cerr != nil {
+			return cerr
+		}
+		return err
+	}}
+	ln, err := lc.Listen(context.Background(), "tcp", addr)
+	if err != nil {
+		return nil, err
+	}
+
+	// Go always listens with somaxconn; listen(2) again to apply -listen-backlog
+	if listenBacklog > 0 {
+		raw, err := ln.(*net.TCPListener).SyscallConn()
+		if err == nil {
+			cerr := raw.Control(func(fd uintptr) { err = setListenBacklog(fd, listenBacklog) })
+			if err == nil {
+				err = cerr
+			}
+		}
+		if err != nil {
+			ln.Close()
+			return nil, err
+		}
+	}
+	if !tcpNoDelay {
+		return noDelayListener{ln.(*net.TCPListener)}, nil
+	}
+	return ln, nil // Go enables TCP_NODELAY on accepted connections by default
+}
+
+// noDelayListener turns Nagle back on for -tcp-nodelay=false
+type noDelayListener struct {
+	*net.TCPListener
+}
+
+func (l noDelayListener) Accept() (net.Conn, error) {
+	c, err := l.AcceptTCP()
+	if err != nil {
+		return nil, err
+	}
+	c.SetNoDelay(false)
+	return c, nil
+}
+
+// backlog returns the accept backlog for listeners created by hand
+func backlog() int {
+	if listenBacklog > 0 {
+		return listenBacklog
+	}
+	if b, err := os.ReadFile("/proc/sys/net/core/somaxconn"); err == nil {
+		if n, err := strconv.Atoi(strings.TrimSpace(string(b))); err == nil && n > 0 {
+			return n
+		}
+	}
+	return syscall.SOMAXCONN
+}
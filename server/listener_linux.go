@@ -0,0 +1,28 @@
+//go:build linux
+
+package main
+
+import (
+	"fmt"
+	"syscall"
+	"time"
+)
+
+const tcpFastOpenOpt = 0x17 // TCP_FASTOPEN, missing from package syscall
+
+// tuneListener applies the listener flags to a socket before listen(2)
+func tuneListener(fd int) error {
+	if tcpFastOpen > 0 {
+		// Also needs bit 2 of net.ipv4.tcp_fastopen (e.g. sysctl -w net.ipv4.tcp_fastopen=3)
+		if err := syscall.SetsockoptInt(fd, syscall.IPPROTO_TCP, tcpFastOpenOpt, tcpFastOpen); err != nil {
+			return fmt.Errorf("TCP_FASTOPEN: %w", err)
+		}
+	}
+	if tcpDeferAccept > 0 {
+		secs := int((tcpDeferAccept + time.Second - 1) / time.Second)
+		if err := syscall.SetsockoptInt(fd, syscall.IPPROTO_TCP, syscall.TCP_DEFER_ACCEPT, secs); err != nil {
+			return fmt.Errorf("TCP_DEFER_ACCEPT: %w", err)
+		}
+	}
+	return nil
+}
@@ -0,0 +1,12 @@
+//go:build !linux
+
+package main
+
+import "errors"
+
+func tuneListener(fd int) error {
+	if tcpFastOpen > 0 || tcpDeferAccept > 0 {
+		return errors.New("-tcp-fastopen and -tcp-defer-accept require linux")
+	}
+	return nil
+}
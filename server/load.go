@@ -0,0 +1,210 @@
+package main
+
+import (
+	"crypto"
+	"crypto/rand"
+	"crypto/rsa"
+	"crypto/sha256"
+	"math"
+	"net/http"
+	"sort"
+	"sync"
+	"sync/atomic"
+	"time"
+
+	"github.com/gin-gonic/gin"
+)
+
+// Readiness thresholds. A node goes unready when its saturation score
+// reaches readyHighWater and only comes back once it drops to readyLowWater,
+// so a balancer does not flap it in and out on every sample.
+const (
+	readyHighWater   = 1.0
+	readyLowWater    = 0.7
+	maxShedRatio     = 0.05 // shed/(served+shed) that counts as fully saturated
+	latencyRingSize  = 1024
+	loadSampleEvery  = time.Second
+	capacityProbeFor = 300 * time.Millisecond
+)
+
+var (
+	cryptoWorkers int           // Concurrent private-key operations
+	maxQueue      int           // Requests allowed to wait for a crypto slot
+	readyP99      time.Duration // p99 latency at which the node counts as saturated
+
+	load = newLoadMonitor()
+)
+
+// LoadSnapshot is the state reported by /health and /ready
+type LoadSnapshot struct {
+	Ready       bool    `json:"ready"`
+	Saturation  float64 `json:"saturation"`
+	Inflight    int64   `json:"inflight"`
+	Queued      int64   `json:"queued"`
+	P99Ms       float64 `json:"p99_ms"`
+	ShedRate    float64 `json:"shed_rate"`
+	CapacityOps float64 `json:"capacity_ops"` // Private-key ops/sec measured at startup
+	CapacityRPS float64 `json:"capacity_rps"` // /passgfw requests/sec (two private-key ops each)
+	CryptoSlots int     `json:"crypto_slots"`
+	QueueLimit  int     `json:"queue_limit"`
+}
+
+type loadMonitor struct {
+	slots    chan struct{}
+	queued   atomic.Int64
+	inflight atomic.Int64
+	served   atomic.Uint64
+	shed     atomic.Uint64
+
+	latencies [latencyRingSize]atomic.Int64
+	latPos    atomic.Uint64
+
+	capacity atomic.Uint64 // float64 bits
+	snapshot atomic.Pointer[LoadSnapshot]
+}
+
+func newLoadMonitor() *loadMonitor {
+	m := &loadMonitor{}
+	m.snapshot.Store(&LoadSnapshot{})
+	return m
+}
+
+// start sizes the crypto pool, measures capacity and begins sampling.
+// The node stays unready until the capacity is known.
+func (m *loadMonitor) start() {
+	m.slots = make(chan struct{}, cryptoWorkers)
+
+	go func() {
+		// A warm start may already have restored the capacity figure
+		if m.capacity.Load() == 0 {
+			ops := measureCapacity(capacityProbeFor)
+			m.capacity.Store(math.Float64bits(ops))
+		}
+		ready := m.sample(0, 0, false)
+		warm.observe(m.current(), 0)
+
+		var lastServed, lastShed uint64
+		for range time.Tick(loadSampleEvery) {
+			served, shed := m.served.Load(), m.shed.Load()
+			ready = m.sample(served-lastServed, shed-lastShed, ready)
+			warm.observe(m.current(), served-lastServed)
+			lastServed, lastShed = served, shed
+		}
+	}()
+}
+
+// acquire reserves a crypto slot, shedding the request when the queue is full.
+// The returned func releases the slot and records the request latency.
+func (m *loadMonitor) acquire() (func(), bool) {
+	start := time.Now()
+	if m.queued.Add(1) > int64(maxQueue) {
+		m.queued.Add(-1)
+		m.shed.Add(1)
+		return nil, false
+	}
+	m.slots <- struct{}{}
+	m.queued.Add(-1)
+	m.inflight.Add(1)
+
+	return func() {
+		<-m.slots
+		m.inflight.Add(-1)
+		m.served.Add(1)
+		i := m.latPos.Add(1) % latencyRingSize
+		m.latencies[i].Store(int64(time.Since(start)))
+	}, true
+}
+
+// sample recomputes the snapshot from the last interval and applies hysteresis
+func (m *loadMonitor) sample(served, shed uint64, wasReady bool) bool {
+	p99 := m.p99()
+
+	shedRate := 0.0
+	if total := served + shed; total > 0 {
+		shedRate = float64(shed) / float64(total)
+	}
+
+	queued := m.queued.Load()
+	saturation := float64(queued) / float64(maxQueue)
+	if readyP99 > 0 {
+		saturation = max(saturation, float64(p99)/float64(readyP99))
+	}
+	saturation = max(saturation, shedRate/maxShedRatio)
+
+	ready := wasReady
+	if wasReady && saturation >= readyHighWater {
+		ready = false
+	} else if !wasReady && saturation <= readyLowWater {
+		ready = true
+	}
+
+	ops := math.Float64frombits(m.capacity.Load())
+	m.snapshot.Store(&LoadSnapshot{
+		Ready:       ready,
+		Saturation:  saturation,
+		Inflight:    m.inflight.Load(),
+		Queued:      queued,
+		P99Ms:       float64(p99) / float64(time.Millisecond),
+		ShedRate:    shedRate,
+		CapacityOps: ops,
+		CapacityRPS: ops / 2,
+		CryptoSlots: cap(m.slots),
+		QueueLimit:  maxQueue,
+	})
+	return ready
+}
+
+// p99 drains the latency ring, so each sample only reflects the last interval
+func (m *loadMonitor) p99() time.Duration {
+	samples := make([]int64, 0, latencyRingSize)
+	for i := range m.latencies {
+		if v := m.latencies[i].Swap(0); v > 0 {
+			samples = append(samples, v)
+		}
+	}
+	if len(samples) == 0 {
+		return 0
+	}
+	sort.Slice(samples, func(a, b int) bool { return samples[a] < samples[b] })
+	return time.Duration(samples[len(samples)*99/100])
+}
+
+// measureCapacity runs private-key signatures on every crypto slot for d and
+// returns the aggregate ops/sec this node can sustain.
+func measureCapacity(d time.Duration) float64 {
+	hashed := sha256.Sum256([]byte("passgfw-capacity-probe"))
+	key := currentConfig().PrivateKey
+	var ops atomic.Int64
+	var wg sync.WaitGroup
+
+	deadline := time.Now().Add(d)
+	start := time.Now()
+	for i := 0; i < cryptoWorkers; i++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			for time.Now().Before(deadline) {
+				if _, err := rsa.SignPSS(rand.Reader, key, crypto.SHA256, hashed[:], nil); err != nil {
+					return
+				}
+				ops.Add(1)
+			}
+		}()
+	}
+	wg.Wait()
+
+	return float64(ops.Load()) / time.Since(start).Seconds()
+}
+
+func (m *loadMonitor) current() *LoadSnapshot {
+	return m.snapshot.Load()
+}
+
+func handleReady(c *gin.Context) {
+	snap := load.current()
+	status := http.StatusOK
+	if !snap.Ready {
+		status = http.StatusServiceUnavailable
+	}
+	c.JSON(status, snap)
+}
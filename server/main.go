@@ -1,6 +1,7 @@
 package main
 
 import (
+	"context"
 	"crypto"
 	"crypto/rand"
 	"crypto/rsa"
@@ -9,22 +10,28 @@ import (
 	"encoding/base64"
 	"encoding/json"
 	"encoding/pem"
+	"errors"
 	"flag"
 	"fmt"
 	"log"
 	"net/http"
 	"os"
+	"os/signal"
+	"runtime"
+	"syscall"
+	"time"
 
 	"github.com/gin-gonic/gin"
 )
 
+// Long polls still open when this runs out are cut off
+const shutdownTimeout = 10 * time.Second
+
 var (
-	privateKey   *rsa.PrivateKey
-	port         string
-	serverDomain string // Real server domain (configured, not from client)
-	adminUser    string // Admin username for /admin access
-	adminPass    string // Admin password for /admin access
-	adminLocal   bool   // Restrict admin access to localhost only
+	port       string
+	adminUser  string // Admin username for /admin access
+	adminPass  string // Admin password for /admin access
+	adminLocal bool   // Restrict admin access to localhost only
 )
 
 // Built-in private key (matches keys/public_key.pem)
@@ -62,13 +69,17 @@ type URLEntry struct {
 	Method string `json:"method"`
 	URL    string `json:"url"`
 	Store  bool   `json:"store,omitempty"`
+	// IP hints tried before DNS, valid until AddrsExpires (Unix seconds)
+	Addrs        []string `json:"addrs,omitempty"`
+	AddrsExpires int64    `json:"addrs_expires,omitempty"`
 }
 
 type ClientPayload struct {
-	Nonce string `json:"nonce"`
-	OS    string `json:"os"`
-	App   string `json:"app"`
-	Data  string `json:"data"`
+	Nonce    string `json:"nonce"`
+	OS       string `json:"os"`
+	App      string `json:"app"`
+	Data     string `json:"data"`
+	ClientID string `json:"cid,omitempty"` // Stable per-install ID for backend affinity
 }
 
 type PassGFWResponse struct {
@@ -85,30 +96,174 @@ type ErrorResponse struct {
 func main() {
 	privateKeyPath := flag.String("private-key", "", "Path to private key")
 	flag.StringVar(&port, "port", "8080", "Server port")
-	flag.StringVar(&serverDomain, "domain", "", "Server domain")
+	serverDomain := flag.String("domain", "", "Server domain")
 	flag.StringVar(&adminUser, "admin-user", "", "Admin username")
 	flag.StringVar(&adminPass, "admin-pass", "", "Admin password")
 	flag.BoolVar(&adminLocal, "admin-local", false, "Localhost only")
+	flag.IntVar(&cryptoWorkers, "crypto-workers", runtime.NumCPU(), "Concurrent private-key operations")
+	flag.IntVar(&maxQueue, "max-queue", 256, "Requests waiting for crypto before shedding")
+	flag.DurationVar(&readyP99, "ready-p99", 500*time.Millisecond, "p99 latency that marks the node unready (0 disables)")
+	backendSpec := flag.String("backends", "", "Backend pool for client affinity (domain[=weight],...)")
+	urlsFile := flag.String("urls-file", "", "JSON URL list returned with every answer")
+	flag.StringVar(&routesFile, "routes-file", "", "Persist live routing edits here and reload them at boot (empty keeps them in memory)")
+	flag.StringVar(&fleetRole, "fleet-role", "", "Fleet config distribution: publish or follow")
+	flag.StringVar(&fleetDir, "fleet-dir", "", "Shared snapshot directory")
+	flag.StringVar(&fleetSource, "fleet-source", "", "Publisher snapshot URL (follow mode)")
+	flag.StringVar(&fleetKeyPath, "fleet-key", "", "Ed25519 key: private to publish, public to follow")
+	flag.DurationVar(&fleetPoll, "fleet-poll", 5*time.Second, "Follower poll interval")
+	flag.StringVar(&journalDir, "journal-dir", "", "Request journal directory (empty disables)")
+	flag.IntVar(&journalSegmentMB, "journal-segment-mb", 64, "Journal segment size in MiB")
+	flag.IntVar(&journalKeep, "journal-keep", 16, "Journal segments kept on disk")
+	flag.StringVar(&otlpEndpoint, "otlp-endpoint", "", "OTLP/HTTP collector for traces (empty disables)")
+	flag.Float64Var(&traceSample, "trace-sample", 0.01, "Fraction of fast, successful requests traced")
+	flag.DurationVar(&traceSlow, "trace-slow", 250*time.Millisecond, "Requests slower than this are always traced")
+	flag.IntVar(&traceQueue, "trace-queue", 1024, "Traces buffered for export before dropping")
+	flag.StringVar(&memoryLimitSpec, "memory-limit", "", "Process memory limit, sets GOMEMLIMIT (e.g. 512MiB; empty keeps the env value)")
+	flag.Float64Var(&cacheShare, "cache-share", 0.25, "Fraction of the memory limit shared by caches")
+	flag.StringVar(&stateFile, "state-file", "", "Warm-start snapshot file (empty disables)")
+	flag.DurationVar(&stateEvery, "state-every", time.Minute, "Warm-start snapshot interval")
+	flag.BoolVar(&stateRestore, "state-restore", true, "Restore the measured capacity on boot (false only loads the latency baseline)")
+	flag.StringVar(&fastpathPort, "fastpath-port", "", "Epoll fast-path port serving only POST /passgfw and /subscribe (empty disables)")
+	flag.StringVar(&trustedProxies, "trusted-proxies", "", "IPs/CIDRs of reverse proxies whose X-Forwarded-For is trusted (empty trusts none)")
+	flag.IntVar(&fastpathLoops, "fastpath-loops", runtime.GOMAXPROCS(0), "Fast-path event loops")
+	flag.IntVar(&tcpFastOpen, "tcp-fastopen", 0, "TCP Fast Open queue length (0 disables)")
+	flag.DurationVar(&tcpDeferAccept, "tcp-defer-accept", 0, "Hold connections until the request arrives, up to this long (0 disables)")
+	flag.IntVar(&listenBacklog, "listen-backlog", 0, "Accept backlog, capped by net.core.somaxconn (0 uses somaxconn)")
+	flag.BoolVar(&tcpNoDelay, "tcp-nodelay", true, "Disable Nagle's algorithm on accepted connections")
+	flag.StringVar(&aggregateLists, "aggregate-lists", "", "Upstream file lists to flatten into one list (comma-separated URLs)")
+	flag.DurationVar(&aggregateInterval, "aggregate-interval", 5*time.Minute, "Refresh interval of the flattened list")
+	flag.IntVar(&aggregateDepth, "aggregate-depth", 5, "Nesting levels resolved when flattening")
+	flag.StringVar(&aggregatePath, "aggregate-path", "/list.txt", "Path serving the flattened list")
 	debug := flag.Bool("debug", false, "Debug mode")
 	flag.Parse()
 
-	if err := loadPrivateKey(*privateKeyPath); err != nil {
+	if cryptoWorkers < 1 {
+		log.Fatalf("-crypto-workers must be at least 1")
+	}
+	if maxQueue < 1 {
+		log.Fatalf("-max-queue must be at least 1")
+	}
+
+	key, err := loadPrivateKey(*privateKeyPath)
+	if err != nil {
 		log.Fatalf("Failed to load key: %v", err)
 	}
+	pool, err := parseBackends(*backendSpec)
+	if err != nil {
+		log.Fatalf("Invalid -backends: %v", err)
+	}
+	urls, err := loadURLs(*urlsFile)
+	if err != nil {
+		log.Fatalf("Invalid -urls-file: %v", err)
+	}
+
+	cfg := &runtimeConfig{
+		PrivateKey: key,
+		Domain:     *serverDomain,
+		Backends:   pool,
+		Routes:     defaultRoutes,
+		URLs:       urls,
+	}
+	if err := loadRoutingState(cfg); err != nil {
+		log.Fatalf("Invalid -routes-file: %v", err)
+	}
+	if err := cfg.prepare(); err != nil {
+		log.Fatalf("Invalid config: %v", err)
+	}
+	storeConfig(cfg)
+
+	if err := setupMemory(); err != nil {
+		log.Fatalf("Memory setup failed: %v", err)
+	}
+	governor.register("deltas", &deltas)
+
+	if err := setupFleet(); err != nil {
+		log.Fatalf("Fleet setup failed: %v", err)
+	}
+
+	if journalDir != "" {
+		if requestJournal, err = openJournal(journalDir, journalSegmentMB, journalKeep); err != nil {
+			log.Fatalf("Failed to open journal: %v", err)
+		}
+	}
 
 	if !*debug {
 		gin.SetMode(gin.ReleaseMode)
 	}
 
+	setupWarmState()
+	load.start()
+	startTracing()
+	if err := setupTrustedProxies(); err != nil {
+		log.Fatalf("Invalid -trusted-proxies: %v", err)
+	}
+	if err := startFastpath(); err != nil {
+		log.Fatal(err)
+	}
+	if err := startAggregator(); err != nil {
+		log.Fatalf("Invalid -aggregate-lists: %v", err)
+	}
+
 	router := gin.Default()
+	if err := router.SetTrustedProxies(proxyCIDRs); err != nil {
+		log.Fatalf("Invalid -trusted-proxies: %v", err)
+	}
 	router.POST("/passgfw", handlePassGFW)
 	router.GET("/health", handleHealth)
+	router.GET("/ready", handleReady)
+	router.POST("/subscribe", handleSubscribeRegister)
+	router.GET("/subscribe", handleSubscribePoll)
+	if aggregateLists != "" {
+		router.GET(aggregatePath, handleAggregatedList)
+	}
 	router.GET("/admin", adminAuth(), handleAdminPage)
 	router.POST("/api/generate-list", adminAuth(), handleGenerateList)
+	router.POST("/api/preflight", adminAuth(), handlePreflight)
 	router.POST("/api/generate-keys", adminAuth(), handleGenerateKeys)
+	router.GET("/fleet/snapshot", adminAuth(), handleFleetSnapshot)
+	router.GET("/fleet/status", adminAuth(), handleFleetStatus)
+	router.GET("/memory/status", adminAuth(), handleMemoryStatus)
+	router.GET("/api/routing", adminAuth(), handleRoutingGet)
+	router.PUT("/api/routing/routes/:data", adminAuth(), handleRoutePut)
+	router.DELETE("/api/routing/routes/:data", adminAuth(), handleRouteDelete)
+	router.PUT("/api/routing/pools/:name", adminAuth(), handlePoolPut)
+	router.DELETE("/api/routing/pools/:name", adminAuth(), handlePoolDelete)
+	router.POST("/api/routing/rollback", adminAuth(), handleRoutingRollback)
+
+	log.Printf("Server: :%s | Domain: %s | Backends: %d | Fleet: %s | Auth: %v", port, cfg.Domain, len(cfg.Backends), fleetRole, adminUser != "")
+	ln, err := listenTCP(":" + port)
+	if err != nil {
+		log.Fatal(err)
+	}
+	srv := &http.Server{Handler: router}
+	go func() {
+		if err := srv.Serve(ln); err != nil && !errors.Is(err, http.ErrServerClosed) {
+			log.Fatal(err)
+		}
+	}()
 
-	log.Printf("Server: :%s | Domain: %s | Auth: %v", port, serverDomain, adminUser != "")
-	router.Run(":" + port)
+	sig := make(chan os.Signal, 1)
+	signal.Notify(sig, syscall.SIGINT, syscall.SIGTERM)
+	<-sig
+	shutdown(srv)
+}
+
+// shutdown drains in-flight requests, then saves the warm state, flushes
+// queued traces and closes the journal, in that order
+func shutdown(srv *http.Server) {
+	log.Printf("Shutting down")
+	ctx, cancel := context.WithTimeout(context.Background(), shutdownTimeout)
+	defer cancel()
+	if err := srv.Shutdown(ctx); err != nil {
+		log.Printf("Shutdown: %v", err)
+	}
+	if stateFile != "" {
+		if err := saveWarmState(stateFile); err != nil {
+			log.Printf("Warm start: save failed: %v", err)
+		}
+	}
+	tracer.close()
+	requestJournal.Close()
 }
 
 func adminAuth() gin.HandlerFunc {
@@ -135,128 +290,213 @@ func adminAuth() gin.HandlerFunc {
 	}
 }
 
-func loadPrivateKey(path string) error {
-	data := []byte(builtinPrivateKey)
-	if path != "" {
-		var err error
-		data, err = os.ReadFile(path)
-		if err != nil {
-			return err
-		}
-	}
+// Handle /passgfw endpoint
+func handlePassGFW(c *gin.Context) {
+	body, _ := c.GetRawData()
+	reply := servePassGFW(&passgfwRequest{
+		Body:        body,
+		Host:        c.Request.Host,
+		ClientIP:    c.ClientIP(),
+		ProbeID:     c.GetHeader(probeIDHeader),
+		Traceparent: c.GetHeader("traceparent"),
+	})
 
-	block, _ := pem.Decode(data)
-	if block == nil {
-		return fmt.Errorf("invalid PEM")
+	if reply.ProbeID != "" {
+		c.Header(probeIDHeader, reply.ProbeID)
 	}
+	c.Header("Server-Timing", reply.ServerTiming)
+	c.Data(reply.Status, "application/json; charset=utf-8", reply.Body)
+}
 
-	key, err := x509.ParsePKCS1PrivateKey(block.Bytes)
-	if err != nil {
-		parsed, err := x509.ParsePKCS8PrivateKey(block.Bytes)
-		if err != nil {
-			return err
-		}
-		key = parsed.(*rsa.PrivateKey)
-	}
+// passgfwRequest is the transport-independent view of a /passgfw call, so
+// the gin route and the event-loop front end share one implementation
+type passgfwRequest struct {
+	Body        []byte
+	Host        string
+	ClientIP    string
+	ProbeID     string
+	Traceparent string
+}
 
-	privateKey = key
-	return nil
+type passgfwReply struct {
+	Status       int
+	Body         []byte // JSON
+	ServerTiming string
+	ProbeID      string // Echoed probe ID, empty when absent or invalid
 }
 
-// Handle /passgfw endpoint
-func handlePassGFW(c *gin.Context) {
+func servePassGFW(req *passgfwRequest) (reply passgfwReply) {
+	entry := journalEntry{Start: time.Now(), Result: journalResultOK}
+	trace := startTrace(req.Traceparent, entry.Start)
+	defer func() {
+		entry.Status = reply.Status
+		if requestJournal != nil {
+			requestJournal.Append(&entry)
+		}
+		trace.finish(&entry)
+	}()
+
+	// Echo the client's probe ID so it can correlate Server-Timing
+	if validProbeID(req.ProbeID) {
+		reply.ProbeID = req.ProbeID
+	}
+	fail := func(status int, result uint8, msg string) passgfwReply {
+		entry.Result = result
+		reply.Status = status
+		reply.ServerTiming = entry.serverTiming()
+		reply.Body, _ = json.Marshal(ErrorResponse{Error: msg})
+		return reply
+	}
+
 	// Read and decrypt request
-	encryptedData, err := c.GetRawData()
-	if err != nil || len(encryptedData) == 0 {
-		c.JSON(http.StatusBadRequest, ErrorResponse{Error: "Invalid request body"})
-		return
+	encryptedData := req.Body
+	if len(encryptedData) == 0 {
+		return fail(http.StatusBadRequest, journalResultBadBody, "Invalid request body")
 	}
 
-	decryptedData, err := rsa.DecryptOAEP(sha256.New(), rand.Reader, privateKey, encryptedData, nil)
+	// Reserve a crypto slot, shedding when the backlog is full
+	stage := time.Now()
+	release, ok := load.acquire()
+	entry.Queue = time.Since(stage)
+	trace.stage("queue", stage)
+	if !ok {
+		return fail(http.StatusServiceUnavailable, journalResultShed, "Server busy")
+	}
+	defer release()
+
+	// One config for the whole request, even if a new snapshot lands meanwhile
+	cfg := currentConfig()
+
+	stage = time.Now()
+	decryptedData, err := rsa.DecryptOAEP(sha256.New(), rand.Reader, cfg.PrivateKey, encryptedData, nil)
+	entry.Decrypt = time.Since(stage)
+	trace.stage("decrypt", stage)
 	if err != nil {
-		c.JSON(http.StatusBadRequest, ErrorResponse{Error: "Decryption failed"})
-		return
+		return fail(http.StatusBadRequest, journalResultDecrypt, "Decryption failed")
 	}
 
 	// Parse payload
 	var payload ClientPayload
 	if err := json.Unmarshal(decryptedData, &payload); err != nil || payload.Nonce == "" {
-		c.JSON(http.StatusBadRequest, ErrorResponse{Error: "Invalid payload"})
-		return
+		return fail(http.StatusBadRequest, journalResultBadPayload, "Invalid payload")
 	}
+	entry.OS, entry.App, entry.Data = payload.OS, payload.App, payload.Data
 
 	// Build response data
-	domain := serverDomain
+	stage = time.Now()
+	domain := cfg.Domain
 	if domain == "" {
-		domain = c.Request.Host
+		domain = req.Host
+	}
+	clientKey := payload.ClientID
+	if clientKey == "" {
+		clientKey = req.ClientIP
 	}
-	responseData := buildResponseData(domain, payload.OS, payload.App, payload.Data)
 
 	// Decode nonce from base64
 	nonceBytes, err := base64.StdEncoding.DecodeString(payload.Nonce)
 	if err != nil {
-		c.JSON(http.StatusBadRequest, ErrorResponse{Error: "Invalid nonce"})
-		return
+		return fail(http.StatusBadRequest, journalResultBadPayload, "Invalid nonce")
 	}
 
-	// Marshal response data to JSON bytes
-	dataBytes, err := json.Marshal(responseData)
+	dataBytes, answerDomain, err := answerFor(cfg, domain, payload.OS, payload.App, payload.Data, clientKey)
 	if err != nil {
-		c.JSON(http.StatusInternalServerError, ErrorResponse{Error: "Failed to marshal data"})
-		return
+		return fail(http.StatusInternalServerError, journalResultInternal, "Failed to marshal data")
 	}
+	entry.Domain = answerDomain
+	entry.Route = time.Since(stage)
+	trace.stage("route", stage, spanAttr{"passgfw.backend", entry.Domain}, spanAttr{"passgfw.backends", len(cfg.Backends)})
 
 	// Build response for signing (without signature field)
 	responseForSigning := PassGFWResponse{
 		Nonce: nonceBytes,
 		Data:  dataBytes,
-		URLs:  nil, // Add URLs here if needed
+		URLs:  cfg.URLs,
 	}
 
 	// Marshal the response to get signing bytes
+	stage = time.Now()
 	signBytes, err := json.Marshal(responseForSigning)
 	if err != nil {
-		c.JSON(http.StatusInternalServerError, ErrorResponse{Error: "Failed to marshal for signing"})
-		return
+		return fail(http.StatusInternalServerError, journalResultInternal, "Failed to marshal for signing")
 	}
 
 	// Sign the marshaled response
 	hashed := sha256.Sum256(signBytes)
-	signature, err := rsa.SignPSS(rand.Reader, privateKey, crypto.SHA256, hashed[:], nil)
+	signature, err := rsa.SignPSS(rand.Reader, cfg.PrivateKey, crypto.SHA256, hashed[:], nil)
+	entry.Sign = time.Since(stage)
+	trace.stage("sign", stage)
 	if err != nil {
-		c.JSON(http.StatusInternalServerError, ErrorResponse{Error: "Signing failed"})
-		return
+		return fail(http.StatusInternalServerError, journalResultInternal, "Signing failed")
 	}
 
 	// Return response with signature
-	c.JSON(http.StatusOK, PassGFWResponse{
+	body, err := json.Marshal(PassGFWResponse{
 		Nonce:     nonceBytes,
 		Data:      dataBytes,
-		URLs:      nil, // Add URLs here if needed
+		URLs:      cfg.URLs,
 		Signature: signature,
 	})
+	if err != nil {
+		return fail(http.StatusInternalServerError, journalResultInternal, "Failed to marshal response")
+	}
+	reply.Status = http.StatusOK
+	reply.ServerTiming = entry.serverTiming()
+	reply.Body = body
+	return reply
+}
+
+// answerFor builds the routing answer for this client and marshals it
+func answerFor(cfg *runtimeConfig, domain, os, app, clientData, clientKey string) (data []byte, answerDomain string, err error) {
+	responseData := buildResponseData(cfg, domain, os, app, clientData, clientKey)
+	if m, ok := responseData.(map[string]any); ok {
+		answerDomain, _ = m["domain"].(string)
+	}
+	if data, err = json.Marshal(responseData); err != nil {
+		return nil, "", err
+	}
+	return data, answerDomain, nil
 }
 
 // Build response data - customize based on OS/App/Data
-func buildResponseData(domain, os, app, clientData string) any {
+func buildResponseData(cfg *runtimeConfig, domain, os, app, clientData, clientKey string) any {
 	data := map[string]any{
 		"domain":  domain,
 		"version": "2.2",
 	}
 
-	// Custom routing examples
-	switch clientData {
-	case "cdn":
-		data["domain"] = "cdn.example.com:443"
-	case "mobile":
-		data["domain"] = "mobile.example.com:443"
+	// Pin each client to one backend so membership changes move ~1/N of them
+	if backend, ok := pickBackend(cfg.Backends, clientKey); ok {
+		data["domain"] = backend
+	}
+
+	// Custom routing by client data, compiled by prepare
+	if r, ok := cfg.routes[clientData]; ok {
+		if routed, ok := r.resolve(clientKey); ok {
+			data["domain"] = routed
+		}
 	}
 
 	return data
 }
 
+// Liveness only; saturation is reported by /ready
 func handleHealth(c *gin.Context) {
-	c.JSON(http.StatusOK, gin.H{"status": "ok"})
+	snap := load.current()
+	resp := gin.H{
+		"status":         "ok",
+		"capacity_ops":   snap.CapacityOps,
+		"capacity_rps":   snap.CapacityRPS,
+		"config_version": currentConfig().Version,
+	}
+	if stateFile != "" {
+		resp["warm_start"] = warm.report()
+	}
+	if tracer != nil {
+		resp["traces_exported"] = tracer.exported.Load()
+		resp["traces_dropped"] = tracer.dropped.Load()
+	}
+	c.JSON(http.StatusOK, resp)
 }
 
 func handleAdminPage(c *gin.Context) {
@@ -267,21 +507,43 @@ func handleAdminPage(c *gin.Context) {
 func handleGenerateList(c *gin.Context) {
 	var req struct {
 		URLs []URLEntry `json:"urls" binding:"required"`
+		// Optional reachability preflight before encoding
+		Preflight *struct {
+			preflightOptions
+			DropFailed bool `json:"drop_failed"`
+			ByLatency  bool `json:"by_latency"`
+		} `json:"preflight"`
+		// Optional IP hints resolved by the server, valid for TTL seconds
+		Addrs *struct {
+			TTL int `json:"ttl"`
+		} `json:"addrs"`
 	}
 	if err := c.ShouldBindJSON(&req); err != nil {
 		c.JSON(http.StatusBadRequest, ErrorResponse{Error: err.Error()})
 		return
 	}
 
+	resp := gin.H{"success": true}
+	if p := req.Preflight; p != nil {
+		if len(req.URLs) > preflightMaxURLs {
+			c.JSON(http.StatusBadRequest, ErrorResponse{Error: fmt.Sprintf("At most %d URLs", preflightMaxURLs)})
+			return
+		}
+		results := preflight(c.Request.Context(), currentConfig(), req.URLs, p.preflightOptions)
+		req.URLs = applyPreflight(req.URLs, results, p.DropFailed, p.ByLatency)
+		resp["preflight"] = results
+	}
+	if a := req.Addrs; a != nil {
+		resp["addrs"] = resolveAddrHints(c.Request.Context(), req.URLs, a.TTL)
+	}
+
 	jsonData, _ := json.Marshal(req.URLs)
 	b64 := base64.StdEncoding.EncodeToString(jsonData)
 
-	c.JSON(http.StatusOK, gin.H{
-		"success":     true,
-		"json":        string(jsonData),
-		"base64":      b64,
-		"pgfw_format": fmt.Sprintf("*PGFW*%s*PGFW*", b64),
-	})
+	resp["json"] = string(jsonData)
+	resp["base64"] = b64
+	resp["pgfw_format"] = fmt.Sprintf("*PGFW*%s*PGFW*", b64)
+	c.JSON(http.StatusOK, resp)
 }
 
 func handleGenerateKeys(c *gin.Context) {
@@ -449,6 +711,13 @@ func getAdminHTML() string {
             background: #f44336;
         }
         
+        .preflight-badge {
+            flex: 0 0 90px;
+            padding-top: 10px;
+            font-size: 13px;
+            white-space: nowrap;
+        }
+        
         .add-btn {
             background: #4caf50;
             margin-bottom: 15px;
@@ -535,12 +804,25 @@ func getAdminHTML() string {
                             <input type="checkbox" class="store-checkbox">
                             <span>持久化</span>
                         </label>
+                        <span class="preflight-badge"></span>
                         <button onclick="removeURLEntry(this)">删除</button>
                     </div>
                 </div>
                 
                 <button class="add-btn" onclick="addURLEntry()">➕ 添加URL</button>
+                <button onclick="preflightList()">🩺 预检可达性</button>
                 <button onclick="generateList()">🚀 生成列表</button>
+                <label style="display: inline-flex; align-items: center; gap: 5px; margin-left: 10px;">
+                    <input type="checkbox" id="addrs-checkbox">
+                    <span>附带 IP 提示，有效期</span>
+                    <input type="number" id="addrs-ttl" value="24" min="1" max="720" style="width: 70px;">
+                    <span>小时</span>
+                </label>
+
+                <div id="preflight-actions" style="display: none; margin-top: 10px;">
+                    <button class="copy-btn" onclick="dropFailedEntries()">🗑️ 移除失败项</button>
+                    <button class="copy-btn" onclick="sortEntriesByLatency()">⏱️ 按延迟排序</button>
+                </div>
                 
                 <div id="list-result" class="result">
                     <h3>生成结果：</h3>
@@ -612,6 +894,7 @@ func getAdminHTML() string {
                     <input type="checkbox" class="store-checkbox">
                     <span>持久化</span>
                 </label>
+                <span class="preflight-badge"></span>
                 <button onclick="removeURLEntry(this)">删除</button>
             ` + "`" + `;
             container.appendChild(entry);
@@ -651,10 +934,14 @@ func getAdminHTML() string {
             }
 
             try {
+                const body = { urls };
+                if (document.getElementById('addrs-checkbox').checked) {
+                    body.addrs = { ttl: Math.round(parseFloat(document.getElementById('addrs-ttl').value) * 3600) };
+                }
                 const response = await fetch('/api/generate-list', {
                     method: 'POST',
                     headers: { 'Content-Type': 'application/json' },
-                    body: JSON.stringify({ urls })
+                    body: JSON.stringify(body)
                 });
 
                 const data = await response.json();
@@ -671,6 +958,91 @@ func getAdminHTML() string {
             }
         }
 
+        async function preflightList() {
+            const rows = [];
+            const urls = [];
+            document.querySelectorAll('.url-entry').forEach(entry => {
+                setBadge(entry, null);
+                const url = entry.querySelector('.url-input').value.trim();
+                if (url) {
+                    rows.push(entry);
+                    urls.push({ method: entry.querySelector('.method-select').value, url });
+                }
+            });
+            if (urls.length === 0) {
+                alert('请至少添加一个URL！');
+                return;
+            }
+            rows.forEach(entry => { entry.querySelector('.preflight-badge').textContent = '⏳'; });
+
+            try {
+                const response = await fetch('/api/preflight', {
+                    method: 'POST',
+                    headers: { 'Content-Type': 'application/json' },
+                    body: JSON.stringify({ urls })
+                });
+
+                const data = await response.json();
+
+                if (data.success) {
+                    data.results.forEach(r => setBadge(rows[r.index], r));
+                    document.getElementById('preflight-actions').style.display = 'block';
+                } else {
+                    alert('预检失败：' + (data.error || '未知错误'));
+                }
+            } catch (error) {
+                alert('请求失败：' + error.message);
+            }
+        }
+
+        function setBadge(entry, r) {
+            const badge = entry.querySelector('.preflight-badge');
+            delete entry.dataset.preflight;
+            delete entry.dataset.latency;
+            badge.textContent = '';
+            badge.title = '';
+            if (!r) return;
+
+            entry.dataset.preflight = r.status;
+            if (r.status === 'ok') {
+                entry.dataset.latency = r.total_ms;
+                badge.textContent = '✅ ' + Math.round(r.total_ms) + 'ms';
+                badge.title = '连接 ' + (r.connect_ms || 0).toFixed(1) + 'ms, TLS ' + (r.tls_ms || 0).toFixed(1) + 'ms' +
+                    (r.entries ? ', ' + r.entries + ' 条' : '');
+            } else if (r.status === 'fail') {
+                badge.textContent = '❌ 失败';
+                badge.title = r.error || '';
+            } else {
+                badge.textContent = '—';
+                badge.title = '此类型不预检';
+            }
+        }
+
+        function dropFailedEntries() {
+            const entries = document.querySelectorAll('.url-entry');
+            const failed = document.querySelectorAll('.url-entry[data-preflight="fail"]');
+            if (failed.length === entries.length) {
+                alert('所有URL均不可达，至少需要保留一个URL！');
+                return;
+            }
+            failed.forEach(entry => entry.remove());
+        }
+
+        // 仅在已预检的条目之间排序，navigate/remove 保持原位
+        function sortEntriesByLatency() {
+            const container = document.getElementById('url-entries');
+            const entries = Array.from(container.querySelectorAll('.url-entry'));
+            const probed = entries.filter(e => e.dataset.preflight === 'ok' || e.dataset.preflight === 'fail');
+            const sorted = probed.slice().sort((a, b) => {
+                const la = a.dataset.preflight === 'ok' ? parseFloat(a.dataset.latency) : Infinity;
+                const lb = b.dataset.preflight === 'ok' ? parseFloat(b.dataset.latency) : Infinity;
+                return la === lb ? 0 : la - lb;
+            });
+            let k = 0;
+            const order = entries.map(e => probed.includes(e) ? sorted[k++] : e);
+            order.forEach(e => container.appendChild(e));
+        }
+
         async function generateKeys() {
             const keySize = parseInt(document.getElementById('key-size').value);
             
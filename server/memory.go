@@ -0,0 +1,230 @@
+package main
+
+import (
+	"fmt"
+	"math"
+	"net/http"
+	"runtime/debug"
+	"runtime/metrics"
+	"sort"
+	"strconv"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"time"
+
+	"github.com/gin-gonic/gin"
+)
+
+// Memory governor: one budget for every evictable cache and buffer.
+//
+// The process limit (-memory-limit) is handed to the runtime as GOMEMLIMIT.
+// Consumers share cacheShare of it; when their combined usage exceeds that,
+// or the live heap nears the limit, each consumer is asked to evict in
+// proportion to its usage, so no single cache can crowd out the rest.
+
+const (
+	defaultCacheBudget = 64 << 20 // Used when no memory limit is set
+	heapPressure       = 0.9      // Live heap / limit that triggers reclaim
+	governorTick       = time.Second
+)
+
+var (
+	memoryLimitSpec string  // -memory-limit, e.g. "512MiB" (empty keeps GOMEMLIMIT)
+	cacheShare      float64 // Fraction of the limit caches may use together
+
+	governor = &memoryGovernor{kick: make(chan struct{}, 1)}
+)
+
+// memoryConsumer is implemented by anything that holds evictable memory
+type memoryConsumer interface {
+	MemoryUsage() int64
+	// Evict frees roughly n bytes, oldest data first, and returns the amount freed
+	Evict(n int64) int64
+}
+
+type memoryGovernor struct {
+	limit  int64 // Process limit (math.MaxInt64 when unset)
+	budget int64 // Shared by all consumers
+
+	consumers atomic.Pointer[[]*registeredConsumer] // Copy-on-write, read lock-free
+	reclaim   sync.Mutex
+
+	reclaims atomic.Uint64
+	kick     chan struct{}
+}
+
+type registeredConsumer struct {
+	name    string
+	c       memoryConsumer
+	evicted atomic.Int64
+}
+
+// setupMemory applies the limit to the runtime and starts the reclaim loop
+func setupMemory() error {
+	if memoryLimitSpec != "" {
+		limit, err := parseBytes(memoryLimitSpec)
+		if err != nil {
+			return fmt.Errorf("invalid -memory-limit: %w", err)
+		}
+		debug.SetMemoryLimit(limit)
+	}
+	if cacheShare <= 0 || cacheShare > 1 {
+		return fmt.Errorf("-cache-share must be in (0,1]")
+	}
+
+	governor.limit = debug.SetMemoryLimit(-1)
+	governor.budget = defaultCacheBudget
+	if governor.limit != math.MaxInt64 {
+		governor.budget = int64(float64(governor.limit) * cacheShare)
+	}
+	go governor.loop()
+	return nil
+}
+
+func (g *memoryGovernor) register(name string, c memoryConsumer) {
+	g.reclaim.Lock()
+	defer g.reclaim.Unlock()
+	var list []*registeredConsumer
+	if cur := g.consumers.Load(); cur != nil {
+		list = append(list, *cur...)
+	}
+	list = append(list, &registeredConsumer{name: name, c: c})
+	g.consumers.Store(&list)
+}
+
+func (g *memoryGovernor) list() []*registeredConsumer {
+	if cur := g.consumers.Load(); cur != nil {
+		return *cur
+	}
+	return nil
+}
+
+// grew is called by consumers after inserting (without holding their own
+// locks); it wakes the governor when the shared budget is exceeded instead
+// of waiting for the next tick
+func (g *memoryGovernor) grew() {
+	if g.budget > 0 && g.usage() > g.budget {
+		select {
+		case g.kick <- struct{}{}:
+		default:
+		}
+	}
+}
+
+func (g *memoryGovernor) usage() int64 {
+	var total int64
+	for _, rc := range g.list() {
+		total += rc.c.MemoryUsage()
+	}
+	return total
+}
+
+func (g *memoryGovernor) loop() {
+	ticker := time.NewTicker(governorTick)
+	defer ticker.Stop()
+	for {
+		select {
+		case <-ticker.C:
+		case <-g.kick:
+		}
+		g.rebalance()
+	}
+}
+
+// rebalance evicts the larger of the budget overrun and the heap overrun,
+// split across consumers by their share of the total
+func (g *memoryGovernor) rebalance() {
+	g.reclaim.Lock()
+	defer g.reclaim.Unlock()
+
+	consumers := g.list()
+	usages := make([]int64, len(consumers))
+	var total int64
+	for i, rc := range consumers {
+		usages[i] = rc.c.MemoryUsage()
+		total += usages[i]
+	}
+
+	need := total - g.budget
+	if g.limit != math.MaxInt64 {
+		if over := liveHeap() - int64(float64(g.limit)*heapPressure); over > need {
+			need = over
+		}
+	}
+	if need <= 0 || total == 0 {
+		return
+	}
+	need = min(need, total)
+
+	g.reclaims.Add(1)
+	for i, rc := range consumers {
+		if share := need * usages[i] / total; share > 0 {
+			rc.evicted.Add(rc.c.Evict(share))
+		}
+	}
+}
+
+func liveHeap() int64 {
+	sample := []metrics.Sample{{Name: "/memory/classes/heap/objects:bytes"}}
+	metrics.Read(sample)
+	if sample[0].Value.Kind() != metrics.KindUint64 {
+		return 0
+	}
+	return int64(sample[0].Value.Uint64())
+}
+
+func handleMemoryStatus(c *gin.Context) {
+	list := governor.list()
+	consumers := make([]gin.H, 0, len(list))
+	var total int64
+	for _, rc := range list {
+		usage := rc.c.MemoryUsage()
+		total += usage
+		consumers = append(consumers, gin.H{
+			"name":          rc.name,
+			"usage_bytes":   usage,
+			"evicted_bytes": rc.evicted.Load(),
+		})
+	}
+	sort.Slice(consumers, func(a, b int) bool { return consumers[a]["name"].(string) < consumers[b]["name"].(string) })
+
+	limit := any(governor.limit)
+	if governor.limit == math.MaxInt64 {
+		limit = nil
+	}
+	c.JSON(http.StatusOK, gin.H{
+		"limit_bytes":          limit,
+		"budget_bytes":         governor.budget,
+		"usage_bytes":          total,
+		"heap_bytes":           liveHeap(),
+		"reclaims":             governor.reclaims.Load(),
+		"consumers":            consumers,
+		"journal_mapped_bytes": requestJournal.mappedBytes(), // File-backed, reclaimable by the kernel
+	})
+}
+
+// parseBytes accepts plain bytes or a KiB/MiB/GiB (also KB/MB/GB) suffix
+func parseBytes(s string) (int64, error) {
+	s = strings.TrimSpace(s)
+	units := []struct {
+		suffix string
+		mult   int64
+	}{
+		{"KiB", 1 << 10}, {"MiB", 1 << 20}, {"GiB", 1 << 30},
+		{"KB", 1000}, {"MB", 1000 * 1000}, {"GB", 1000 * 1000 * 1000},
+		{"B", 1},
+	}
+	mult := int64(1)
+	for _, u := range units {
+		if strings.HasSuffix(s, u.suffix) {
+			s, mult = strings.TrimSpace(strings.TrimSuffix(s, u.suffix)), u.mult
+			break
+		}
+	}
+	n, err := strconv.ParseInt(s, 10, 64)
+	if err != nil || n <= 0 {
+		return 0, fmt.Errorf("bad size %q", s)
+	}
+	return n * mult, nil
+}
@@ -0,0 +1,337 @@
+package main
+
+import (
+	"bytes"
+	"context"
+	"crypto"
+	"crypto/rand"
+	"crypto/rsa"
+	"crypto/sha256"
+	"crypto/tls"
+	"encoding/base64"
+	"encoding/json"
+	"fmt"
+	"io"
+	"net/http"
+	"net/http/httptrace"
+	"net/url"
+	"sort"
+	"strings"
+	"sync"
+	"time"
+
+	"github.com/gin-gonic/gin"
+)
+
+// Reachability preflight for generated URL lists. Every dead entry costs
+// every client a full timeout per detection round, so the admin can probe
+// the list from the server first: api entries get a real signed /passgfw
+// exchange, file entries are fetched and parsed like the SDKs do.
+
+const (
+	preflightMaxURLs  = 256
+	preflightMaxBody  = 1 << 20
+	preflightMaxConns = 64
+)
+
+type preflightOptions struct {
+	Concurrency int `json:"concurrency"` // Probes in flight (default 16)
+	PerHost     int `json:"per_host"`    // Probes in flight per host (default 2)
+	TimeoutMs   int `json:"timeout_ms"`  // Per probe (default 5000)
+}
+
+type preflightResult struct {
+	Index      int     `json:"index"`
+	Method     string  `json:"method"`
+	URL        string  `json:"url"`
+	Status     string  `json:"status"` // ok, fail or skipped
+	ConnectMs  float64 `json:"connect_ms,omitempty"`
+	TLSMs      float64 `json:"tls_ms,omitempty"`
+	TotalMs    float64 `json:"total_ms,omitempty"`
+	HTTPStatus int     `json:"http_status,omitempty"`
+	Entries    int     `json:"entries,omitempty"` // Parsed entries of a file list
+	Error      string  `json:"error,omitempty"`
+}
+
+func (o *preflightOptions) normalize() {
+	if o.Concurrency <= 0 {
+		o.Concurrency = 16
+	}
+	o.Concurrency = min(o.Concurrency, preflightMaxConns)
+	if o.PerHost <= 0 {
+		o.PerHost = 2
+	}
+	if o.TimeoutMs <= 0 {
+		o.TimeoutMs = 5000
+	}
+	o.TimeoutMs = min(o.TimeoutMs, 30000)
+}
+
+// preflight probes all entries concurrently, at most opts.Concurrency in
+// total and opts.PerHost against any one host. Results are in entry order.
+func preflight(ctx context.Context, cfg *runtimeConfig, urls []URLEntry, opts preflightOptions) []preflightResult {
+	opts.normalize()
+	results := make([]preflightResult, len(urls))
+	slots := make(chan struct{}, opts.Concurrency)
+
+	var mu sync.Mutex
+	hosts := make(map[string]chan struct{})
+	hostSlot := func(host string) chan struct{} {
+		mu.Lock()
+		defer mu.Unlock()
+		if hosts[host] == nil {
+			hosts[host] = make(chan struct{}, opts.PerHost)
+		}
+		return hosts[host]
+	}
+
+	var wg sync.WaitGroup
+	for i, u := range urls {
+		results[i] = preflightResult{Index: i, Method: u.Method, URL: u.URL}
+		if u.Method != "api" && u.Method != "file" {
+			results[i].Status = "skipped"
+			continue
+		}
+		target, err := url.Parse(u.URL)
+		if err != nil || (target.Scheme != "http" && target.Scheme != "https") || target.Host == "" {
+			results[i].Status, results[i].Error = "fail", "unsupported URL"
+			continue
+		}
+
+		wg.Add(1)
+		go func(r *preflightResult, host chan struct{}) {
+			defer wg.Done()
+			// Take the host slot first so waiting on a busy host holds no global slot
+			host <- struct{}{}
+			defer func() { <-host }()
+			slots <- struct{}{}
+			defer func() { <-slots }()
+
+			probeCtx, cancel := context.WithTimeout(ctx, time.Duration(opts.TimeoutMs)*time.Millisecond)
+			defer cancel()
+			probeEntry(probeCtx, cfg, r)
+		}(&results[i], hostSlot(target.Host))
+	}
+	wg.Wait()
+	return results
+}
+
+// probeEntry runs one probe on a fresh connection so connect and TLS times
+// are what a client without a pooled connection would see
+func probeEntry(ctx context.Context, cfg *runtimeConfig, r *preflightResult) {
+	// The trace hooks run on dial goroutines, which may race each other
+	// (Happy Eyeballs) and outlive Do on a timeout, so they only touch these
+	// under mu; r is filled in once the probe is done
+	var (
+		mu                     sync.Mutex
+		connectStart, tlsStart time.Time
+		connectMs, tlsMs       float64
+	)
+	ctx = httptrace.WithClientTrace(ctx, &httptrace.ClientTrace{
+		ConnectStart: func(string, string) {
+			mu.Lock()
+			connectStart = time.Now()
+			mu.Unlock()
+		},
+		ConnectDone: func(_, _ string, err error) {
+			mu.Lock()
+			if err == nil {
+				connectMs = msSince(connectStart)
+			}
+			mu.Unlock()
+		},
+		TLSHandshakeStart: func() {
+			mu.Lock()
+			tlsStart = time.Now()
+			mu.Unlock()
+		},
+		TLSHandshakeDone: func(tls.ConnectionState, error) {
+			mu.Lock()
+			tlsMs = msSince(tlsStart)
+			mu.Unlock()
+		},
+	})
+	client := &http.Client{Transport: &http.Transport{DisableKeepAlives: true, Proxy: http.ProxyFromEnvironment}}
+
+	start := time.Now()
+	var err error
+	if r.Method == "api" {
+		err = probeAPI(ctx, client, cfg, r)
+	} else {
+		err = probeFile(ctx, client, r)
+	}
+	r.TotalMs = msSince(start)
+	mu.Lock()
+	r.ConnectMs, r.TLSMs = connectMs, tlsMs
+	mu.Unlock()
+	if err != nil {
+		r.Status, r.Error = "fail", err.Error()
+		return
+	}
+	r.Status = "ok"
+}
+
+// probeAPI performs a /passgfw exchange encrypted to this server's key and
+// checks the nonce and signature the way the SDKs do
+func probeAPI(ctx context.Context, client *http.Client, cfg *runtimeConfig, r *preflightResult) error {
+	nonce := make([]byte, 32)
+	if _, err := rand.Read(nonce); err != nil {
+		return err
+	}
+	payload, _ := json.Marshal(ClientPayload{
+		Nonce: base64.StdEncoding.EncodeToString(nonce),
+		OS:    "preflight",
+		App:   "passgfw-preflight",
+	})
+	body, err := rsa.EncryptOAEP(sha256.New(), rand.Reader, &cfg.PrivateKey.PublicKey, payload, nil)
+	if err != nil {
+		return err
+	}
+
+	req, err := http.NewRequestWithContext(ctx, http.MethodPost, r.URL, bytes.NewReader(body))
+	if err != nil {
+		return err
+	}
+	req.Header.Set("Content-Type", "application/octet-stream")
+	raw, err := fetch(client, req, r)
+	if err != nil {
+		return err
+	}
+
+	var resp PassGFWResponse
+	if err := json.Unmarshal(raw, &resp); err != nil {
+		return fmt.Errorf("invalid response: %v", err)
+	}
+	if !bytes.Equal(resp.Nonce, nonce) {
+		return fmt.Errorf("nonce mismatch")
+	}
+	signature := resp.Signature
+	resp.Signature = nil
+	signed, _ := json.Marshal(resp)
+	hashed := sha256.Sum256(signed)
+	if rsa.VerifyPSS(&cfg.PrivateKey.PublicKey, crypto.SHA256, hashed[:], signature, nil) != nil {
+		return fmt.Errorf("signature does not match this server's key")
+	}
+	return nil
+}
+
+// probeFile fetches a list file and requires at least one parsable entry
+func probeFile(ctx context.Context, client *http.Client, r *preflightResult) error {
+	req, err := http.NewRequestWithContext(ctx, http.MethodGet, r.URL, nil)
+	if err != nil {
+		return err
+	}
+	raw, err := fetch(client, req, r)
+	if err != nil {
+		return err
+	}
+	r.Entries = len(parseURLList(string(raw)))
+	if r.Entries == 0 {
+		return fmt.Errorf("no URL list found")
+	}
+	return nil
+}
+
+func fetch(client *http.Client, req *http.Request, r *preflightResult) ([]byte, error) {
+	resp, err := client.Do(req)
+	if err != nil {
+		return nil, err
+	}
+	defer resp.Body.Close()
+	r.HTTPStatus = resp.StatusCode
+	if resp.StatusCode != http.StatusOK {
+		return nil, fmt.Errorf("HTTP %d", resp.StatusCode)
+	}
+	return io.ReadAll(io.LimitReader(resp.Body, preflightMaxBody))
+}
+
+// parseURLList accepts the formats the SDKs do: *PGFW* markers, a JSON
+// array, {"urls": [...]} and plain text with one URL per line
+func parseURLList(text string) []URLEntry {
+	var list []URLEntry
+	if _, rest, ok := strings.Cut(text, "*PGFW*"); ok {
+		if encoded, _, ok := strings.Cut(rest, "*PGFW*"); ok {
+			if decoded, err := base64.StdEncoding.DecodeString(encoded); err == nil && json.Unmarshal(decoded, &list) == nil {
+				return list
+			}
+		}
+	}
+	if json.Unmarshal([]byte(text), &list) == nil {
+		return list
+	}
+	var legacy struct {
+		URLs []URLEntry `json:"urls"`
+	}
+	if json.Unmarshal([]byte(text), &legacy) == nil && legacy.URLs != nil {
+		return legacy.URLs
+	}
+	list = nil
+	for _, line := range strings.Split(text, "\n") {
+		line = strings.TrimSpace(line)
+		if strings.HasPrefix(line, "http://") || strings.HasPrefix(line, "https://") {
+			list = append(list, URLEntry{Method: "api", URL: line})
+		}
+	}
+	return list
+}
+
+// applyPreflight drops failed entries and/or orders the probed entries by
+// latency. Probed entries only move among their own positions, so navigate
+// and remove entries keep their place in the list.
+func applyPreflight(urls []URLEntry, results []preflightResult, dropFailed, byLatency bool) []URLEntry {
+	var slots []int
+	var probed []preflightResult
+	for i, r := range results {
+		if r.Status != "skipped" {
+			slots = append(slots, i)
+			probed = append(probed, r)
+		}
+	}
+	if byLatency {
+		sort.SliceStable(probed, func(a, b int) bool {
+			if (probed[a].Status == "ok") != (probed[b].Status == "ok") {
+				return probed[a].Status == "ok"
+			}
+			return probed[a].Status == "ok" && probed[a].TotalMs < probed[b].TotalMs
+		})
+	}
+	order := make([]int, len(urls))
+	for i := range order {
+		order[i] = i
+	}
+	for k, slot := range slots {
+		order[slot] = probed[k].Index
+	}
+
+	out := make([]URLEntry, 0, len(urls))
+	for _, i := range order {
+		if dropFailed && results[i].Status == "fail" {
+			continue
+		}
+		out = append(out, urls[i])
+	}
+	return out
+}
+
+func handlePreflight(c *gin.Context) {
+	var req struct {
+		URLs []URLEntry `json:"urls" binding:"required"`
+		preflightOptions
+	}
+	if err := c.ShouldBindJSON(&req); err != nil {
+		c.JSON(http.StatusBadRequest, ErrorResponse{Error: err.Error()})
+		return
+	}
+	if len(req.URLs) > preflightMaxURLs {
+		c.JSON(http.StatusBadRequest, ErrorResponse{Error: fmt.Sprintf("At most %d URLs", preflightMaxURLs)})
+		return
+	}
+	c.JSON(http.StatusOK, gin.H{
+		"success": true,
+		"results": preflight(c.Request.Context(), currentConfig(), req.URLs, req.preflightOptions),
+	})
+}
+
+func msSince(t time.Time) float64 {
+	return float64(time.Since(t).Microseconds()) / 1000
+}
@@ -0,0 +1,104 @@
+package main
+
+import (
+	"fmt"
+	"hash/fnv"
+	"math"
+	"strconv"
+	"strings"
+)
+
+// Backend is a weighted domain that clients can be pinned to
+type Backend struct {
+	Domain string  `json:"domain"`
+	Weight float64 `json:"weight"`
+}
+
+// parseBackends parses "a.example.com:443=2,b.example.com:443" (weight defaults to 1)
+func parseBackends(spec string) ([]Backend, error) {
+	var list []Backend
+	for _, item := range strings.Split(spec, ",") {
+		item = strings.TrimSpace(item)
+		if item == "" {
+			continue
+		}
+
+		b := Backend{Domain: item, Weight: 1}
+		if i := strings.LastIndex(item, "="); i >= 0 {
+			w, err := strconv.ParseFloat(item[i+1:], 64)
+			if err != nil || w <= 0 {
+				return nil, fmt.Errorf("invalid weight in %q", item)
+			}
+			b.Domain, b.Weight = item[:i], w
+		}
+		list = append(list, b)
+	}
+	return list, nil
+}
+
+const (
+	poolPrefix  = "@"       // Route target naming a pool instead of a domain
+	defaultPool = "default" // Pool name of the -backends affinity pool
+)
+
+// route is a compiled Routes entry: a fixed domain, or a pool the client is
+// pinned into like the default affinity pool
+type route struct {
+	domain string
+	pool   []Backend
+}
+
+func (r route) resolve(clientKey string) (string, bool) {
+	if r.pool != nil {
+		return pickBackend(r.pool, clientKey)
+	}
+	return r.domain, true
+}
+
+// validDomain accepts host or host:port names as returned to clients
+func validDomain(s string) bool {
+	if s == "" || strings.HasPrefix(s, poolPrefix) {
+		return false
+	}
+	for _, r := range s {
+		if r <= ' ' || r == '/' || r == 0x7f {
+			return false
+		}
+	}
+	return true
+}
+
+// pickBackend selects a backend by weighted rendezvous hashing.
+// Each backend scores -weight/ln(u) with u = hash(client, domain) in (0,1);
+// the highest score wins. Adding or removing a backend only moves the
+// clients whose winner changed, roughly 1/N of them.
+func pickBackend(pool []Backend, clientKey string) (string, bool) {
+	best, bestScore := "", math.Inf(-1)
+	for _, b := range pool {
+		u := unitHash(clientKey, b.Domain)
+		score := -b.Weight / math.Log(u)
+		if score > bestScore {
+			best, bestScore = b.Domain, score
+		}
+	}
+	return best, best != ""
+}
+
+// unitHash maps (client, domain) to a stable value in the open interval (0,1).
+// FNV is used instead of maphash so every node agrees on the result.
+func unitHash(clientKey, domain string) float64 {
+	h := fnv.New64a()
+	h.Write([]byte(clientKey))
+	h.Write([]byte{0})
+	h.Write([]byte(domain))
+
+	// splitmix64 finalizer to spread FNV's weak low bits
+	x := h.Sum64()
+	x ^= x >> 30
+	x *= 0xbf58476d1ce4e5b9
+	x ^= x >> 27
+	x *= 0x94d049bb133111eb
+	x ^= x >> 31
+
+	return (float64(x>>11) + 0.5) / (1 << 53)
+}
@@ -0,0 +1,274 @@
+package main
+
+import (
+	"encoding/json"
+	"errors"
+	"fmt"
+	"log"
+	"maps"
+	"net/http"
+	"os"
+	"sync"
+	"time"
+
+	"github.com/gin-gonic/gin"
+)
+
+// Live routing management. A change copies the active runtimeConfig, edits
+// the copy, compiles and validates it with prepare, then swaps it in under a
+// new version. The request path keeps reading active without a lock, and the
+// configs a change replaced are kept for rollback. With -routes-file the
+// committed backends, pools and routes are also written to disk before they
+// go live, and reloaded at boot in place of the flag defaults.
+
+const routingHistoryLen = 32
+
+type routingChange struct {
+	Version uint64 `json:"version"`
+	At      int64  `json:"at"` // Unix milliseconds
+	Change  string `json:"change"`
+	cfg     *runtimeConfig
+}
+
+var (
+	routesFile string // Persisted routing state (empty keeps edits in memory only)
+
+	routingMu      sync.Mutex      // Serializes writers; readers use active
+	routingHistory []routingChange // Oldest first, the active config last
+
+	errFollower = errors.New("routing is managed by the fleet publisher")
+	errNotFound = errors.New("not found")
+)
+
+// routingState is what -routes-file holds
+type routingState struct {
+	Backends []Backend            `json:"backends"`
+	Pools    map[string][]Backend `json:"pools"`
+	Routes   map[string]string    `json:"routes"`
+}
+
+// loadRoutingState replaces the flag-derived routing in cfg with the saved
+// state, if any. It runs before the first prepare and publish.
+func loadRoutingState(cfg *runtimeConfig) error {
+	if routesFile == "" {
+		return nil
+	}
+	data, err := os.ReadFile(routesFile)
+	if errors.Is(err, os.ErrNotExist) {
+		return nil
+	}
+	if err != nil {
+		return err
+	}
+	var state routingState
+	if err := json.Unmarshal(data, &state); err != nil {
+		return fmt.Errorf("%s: %w", routesFile, err)
+	}
+	cfg.Backends, cfg.Pools, cfg.Routes = state.Backends, state.Pools, state.Routes
+	log.Printf("Routing: restored %d routes and %d pools from %s", len(state.Routes), len(state.Pools), routesFile)
+	return nil
+}
+
+func saveRoutingState(cfg *runtimeConfig) error {
+	if routesFile == "" {
+		return nil
+	}
+	data, err := json.Marshal(routingState{cfg.Backends, cfg.Pools, cfg.Routes})
+	if err != nil {
+		return err
+	}
+	return writeFileAtomic(routesFile, data)
+}
+
+type routingView struct {
+	Version  uint64               `json:"version"`
+	Domain   string               `json:"domain"`
+	Backends []Backend            `json:"backends"`
+	Pools    map[string][]Backend `json:"pools"`
+	Routes   map[string]string    `json:"routes"`
+	History  []routingChange      `json:"history"`
+}
+
+func viewRouting(cfg *runtimeConfig) routingView {
+	routingMu.Lock()
+	history := append([]routingChange(nil), routingHistory...)
+	routingMu.Unlock()
+	return routingView{cfg.Version, cfg.Domain, cfg.Backends, cfg.Pools, cfg.Routes, history}
+}
+
+// updateRouting applies edit to a copy of the active config and commits it
+func updateRouting(edit func(next *runtimeConfig) (string, error)) (*runtimeConfig, error) {
+	routingMu.Lock()
+	defer routingMu.Unlock()
+
+	if fleetRole == "follow" {
+		return nil, errFollower
+	}
+	next := *currentConfig()
+	next.Routes = maps.Clone(next.Routes)
+	next.Pools = maps.Clone(next.Pools)
+	change, err := edit(&next)
+	if err != nil {
+		return nil, err
+	}
+	return commitConfig(&next, change)
+}
+
+// commitConfig activates next under a new version, signing and distributing
+// it on a publisher. Callers hold routingMu.
+func commitConfig(next *runtimeConfig, change string) (*runtimeConfig, error) {
+	if err := next.prepare(); err != nil {
+		return nil, err
+	}
+	if len(routingHistory) == 0 {
+		recordRouting(currentConfig(), "initial")
+	}
+	// Saved first, so a change that could not be persisted never goes live;
+	// the previous state is written back if publishing then fails
+	prev := currentConfig()
+	if err := saveRoutingState(next); err != nil {
+		return nil, fmt.Errorf("save routing state: %w", err)
+	}
+	if fleetRole == "publish" {
+		if err := publishConfig(next); err != nil {
+			if rerr := saveRoutingState(prev); rerr != nil {
+				log.Printf("Routing: restore %s after failed publish: %v", routesFile, rerr)
+			}
+			return nil, err
+		}
+	} else {
+		next.Version = nextVersion(time.Now())
+		storeConfig(next)
+	}
+
+	cur := currentConfig()
+	recordRouting(cur, change)
+	log.Printf("Routing: version %d: %s", cur.Version, change)
+	return cur, nil
+}
+
+func recordRouting(cfg *runtimeConfig, change string) {
+	routingHistory = append(routingHistory, routingChange{cfg.Version, time.Now().UnixMilli(), change, cfg})
+	if len(routingHistory) > routingHistoryLen {
+		routingHistory = routingHistory[len(routingHistory)-routingHistoryLen:]
+	}
+}
+
+func handleRoutingGet(c *gin.Context) {
+	c.JSON(http.StatusOK, viewRouting(currentConfig()))
+}
+
+// PUT /api/routing/routes/:data {"target": "host:port" | "@pool"}
+func handleRoutePut(c *gin.Context) {
+	data := c.Param("data")
+	var req struct {
+		Target string `json:"target"`
+	}
+	if err := c.ShouldBindJSON(&req); err != nil {
+		c.JSON(http.StatusBadRequest, ErrorResponse{Error: "Invalid request: " + err.Error()})
+		return
+	}
+	respondRouting(c, func(next *runtimeConfig) (string, error) {
+		if next.Routes == nil {
+			next.Routes = make(map[string]string)
+		}
+		next.Routes[data] = req.Target
+		return fmt.Sprintf("route %q -> %q", data, req.Target), nil
+	})
+}
+
+func handleRouteDelete(c *gin.Context) {
+	data := c.Param("data")
+	respondRouting(c, func(next *runtimeConfig) (string, error) {
+		if _, ok := next.Routes[data]; !ok {
+			return "", errNotFound
+		}
+		delete(next.Routes, data)
+		return fmt.Sprintf("delete route %q", data), nil
+	})
+}
+
+// PUT /api/routing/pools/:name {"backends": [{"domain": "...", "weight": 1}]}
+// The "default" pool is the -backends affinity pool.
+func handlePoolPut(c *gin.Context) {
+	name := c.Param("name")
+	var req struct {
+		Backends []Backend `json:"backends"`
+	}
+	if err := c.ShouldBindJSON(&req); err != nil {
+		c.JSON(http.StatusBadRequest, ErrorResponse{Error: "Invalid request: " + err.Error()})
+		return
+	}
+	for i := range req.Backends {
+		if req.Backends[i].Weight == 0 {
+			req.Backends[i].Weight = 1
+		}
+	}
+	respondRouting(c, func(next *runtimeConfig) (string, error) {
+		if name == defaultPool {
+			next.Backends = req.Backends
+		} else {
+			if next.Pools == nil {
+				next.Pools = make(map[string][]Backend)
+			}
+			next.Pools[name] = req.Backends
+		}
+		return fmt.Sprintf("pool %q (%d backends)", name, len(req.Backends)), nil
+	})
+}
+
+// Deleting a pool that routes still target fails validation
+func handlePoolDelete(c *gin.Context) {
+	name := c.Param("name")
+	respondRouting(c, func(next *runtimeConfig) (string, error) {
+		if name == defaultPool {
+			next.Backends = nil
+		} else if _, ok := next.Pools[name]; ok {
+			delete(next.Pools, name)
+		} else {
+			return "", errNotFound
+		}
+		return fmt.Sprintf("delete pool %q", name), nil
+	})
+}
+
+// POST /api/routing/rollback [{"version": N}] restores a config from the
+// history, the previous one by default, as a new version
+func handleRoutingRollback(c *gin.Context) {
+	var req struct {
+		Version *uint64 `json:"version"`
+	}
+	if body, _ := c.GetRawData(); len(body) > 0 {
+		if err := json.Unmarshal(body, &req); err != nil {
+			c.JSON(http.StatusBadRequest, ErrorResponse{Error: "Invalid request: " + err.Error()})
+			return
+		}
+	}
+	respondRouting(c, func(next *runtimeConfig) (string, error) {
+		var target *routingChange
+		for i := len(routingHistory) - 2; i >= 0 && target == nil; i-- {
+			if req.Version == nil || routingHistory[i].Version == *req.Version {
+				target = &routingHistory[i]
+			}
+		}
+		if target == nil {
+			return "", errNotFound
+		}
+		next.Backends, next.Pools, next.Routes = target.cfg.Backends, target.cfg.Pools, target.cfg.Routes
+		return fmt.Sprintf("rollback to %d", target.Version), nil
+	})
+}
+
+func respondRouting(c *gin.Context, edit func(next *runtimeConfig) (string, error)) {
+	cfg, err := updateRouting(edit)
+	switch {
+	case err == nil:
+		c.JSON(http.StatusOK, viewRouting(cfg))
+	case errors.Is(err, errNotFound):
+		c.JSON(http.StatusNotFound, ErrorResponse{Error: err.Error()})
+	case errors.Is(err, errFollower):
+		c.JSON(http.StatusConflict, ErrorResponse{Error: err.Error()})
+	default:
+		c.JSON(http.StatusBadRequest, ErrorResponse{Error: err.Error()})
+	}
+}
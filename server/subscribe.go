@@ -0,0 +1,372 @@
+package main
+
+import (
+	"crypto"
+	"crypto/hmac"
+	"crypto/rand"
+	"crypto/rsa"
+	"crypto/sha256"
+	"encoding/base64"
+	"encoding/hex"
+	"encoding/json"
+	"errors"
+	"net/http"
+	"net/url"
+	"strconv"
+	"sync"
+	"sync/atomic"
+	"time"
+
+	"github.com/gin-gonic/gin"
+)
+
+// Subscriptions let long-lived clients learn about answer and URL-list
+// changes without repeating the RSA exchange. A client registers once with
+// an encrypted payload (POST /subscribe) and gets a sealed token plus its
+// signed current state; it then long-polls GET /subscribe with the token and
+// the hashes it holds. A poll is answered with a signed delta as soon as
+// either hash differs from the current config, or 204 after the wait.
+//
+// Signed deltas are shared between subscribers. What ties a reply to one
+// subscription is its binding: an HMAC of the reply keyed with the nonce
+// from the client's encrypted payload, which only the client and its token
+// (sealed with AES-GCM) know.
+//
+// Waiting costs no registration: pollers wait on configChanged(), and the
+// fast path parks them without a goroutine (see fastpath_linux.go).
+
+const (
+	subscribeTokenTTL  = 24 * time.Hour
+	subscribeWait      = 30 * time.Second
+	subscribeMaxWait   = 55 * time.Second // Below common proxy idle timeouts
+	subscribeMaxDeltas = 4096
+)
+
+// subscribeClaims is what a token carries; the token binds a client to the
+// routing inputs of its registration
+type subscribeClaims struct {
+	ClientKey string `json:"c"`
+	Data      string `json:"d"`
+	Host      string `json:"h"`
+	Nonce     []byte `json:"n"` // From the registration payload, keys the binding
+	Expires   int64  `json:"e"` // Unix seconds
+}
+
+type subscribePoll struct {
+	claims     subscribeClaims
+	answerHash string
+	urlsHash   string
+	wait       time.Duration
+}
+
+// SubscribeDelta is a signed state change. Data and URLs are present only
+// when they changed; the hashes are what the client sends on its next poll.
+// The same delta goes to every subscriber in that state, so clients check the
+// binding of the update carrying it and ignore a delta whose version is lower
+// than one they already applied.
+type SubscribeDelta struct {
+	Version    uint64          `json:"version"`
+	AnswerHash string          `json:"answer_hash"`
+	URLsHash   string          `json:"urls_hash"`
+	Data       []byte          `json:"data,omitempty"` // As in PassGFWResponse
+	URLs       json.RawMessage `json:"urls,omitempty"`
+	Signature  []byte          `json:"signature"`
+}
+
+type SubscribeRegistration struct {
+	Token   string          `json:"token"`
+	Expires int64           `json:"expires"` // Unix seconds
+	State   json.RawMessage `json:"state"`   // Full SubscribeDelta
+	Binding []byte          `json:"binding"` // HMAC-SHA256(payload nonce, state)
+}
+
+// SubscribeUpdate answers a poll whose state changed
+type SubscribeUpdate struct {
+	Delta   json.RawMessage `json:"delta"`   // SubscribeDelta
+	Binding []byte          `json:"binding"` // HMAC-SHA256(payload nonce, delta)
+}
+
+// Signed deltas of the current version, shared by every subscriber that
+// needs the same change so a config push costs one signature per distinct
+// answer rather than one per subscriber
+var deltas deltaCache
+
+type deltaCache struct {
+	sync.Mutex
+	version uint64
+	signed  map[string]*signedDeltaEntry
+	held    atomic.Int64 // Bytes of the signed bodies in signed
+}
+
+// signedDeltaEntry is signed once; subscribers woken together wait on once
+type signedDeltaEntry struct {
+	once sync.Once
+	body []byte
+	err  error
+	size int64 // Counted in held while the entry is in the map
+}
+
+var errBusy = errors.New("server busy")
+
+func shortHash(b []byte) string {
+	sum := sha256.Sum256(b)
+	return hex.EncodeToString(sum[:8])
+}
+
+// issueToken seals the claims, so the client ID, data and nonce never
+// appear in poll URLs
+func issueToken(cfg *runtimeConfig, claims subscribeClaims) string {
+	payload, _ := json.Marshal(claims)
+	nonce := make([]byte, cfg.tokenAEAD.NonceSize(), cfg.tokenAEAD.NonceSize()+len(payload)+cfg.tokenAEAD.Overhead())
+	rand.Read(nonce)
+	return base64.RawURLEncoding.EncodeToString(cfg.tokenAEAD.Seal(nonce, nonce, payload, nil))
+}
+
+func verifyToken(cfg *runtimeConfig, token string) (subscribeClaims, bool) {
+	var claims subscribeClaims
+	sealed, err := base64.RawURLEncoding.DecodeString(token)
+	if err != nil || len(sealed) < cfg.tokenAEAD.NonceSize() {
+		return claims, false
+	}
+	nonce, ciphertext := sealed[:cfg.tokenAEAD.NonceSize()], sealed[cfg.tokenAEAD.NonceSize():]
+	payload, err := cfg.tokenAEAD.Open(nil, nonce, ciphertext, nil)
+	if err != nil {
+		return claims, false
+	}
+	if json.Unmarshal(payload, &claims) != nil || len(claims.Nonce) == 0 || time.Now().Unix() > claims.Expires {
+		return claims, false
+	}
+	return claims, true
+}
+
+// bind ties a shared signed body to one subscription
+func bind(claims *subscribeClaims, body []byte) []byte {
+	mac := hmac.New(sha256.New, claims.Nonce)
+	mac.Write(body)
+	return mac.Sum(nil)
+}
+
+// signedDelta returns the signed delta body, signing at most once per
+// distinct content and config version
+func signedDelta(cfg *runtimeConfig, data []byte, answerHash string, withData, withURLs bool) ([]byte, error) {
+	key := answerHash + strconv.FormatBool(withData) + strconv.FormatBool(withURLs)
+	deltas.Lock()
+	if deltas.signed == nil || deltas.version != cfg.Version || len(deltas.signed) >= subscribeMaxDeltas {
+		deltas.version, deltas.signed = cfg.Version, make(map[string]*signedDeltaEntry)
+		deltas.held.Store(0)
+	}
+	e := deltas.signed[key]
+	if e == nil {
+		e = &signedDeltaEntry{}
+		deltas.signed[key] = e
+	}
+	deltas.Unlock()
+
+	signed := false
+	e.once.Do(func() {
+		e.body, e.err = signDelta(cfg, data, answerHash, withData, withURLs)
+		signed = true
+	})
+	if signed {
+		deltas.Lock()
+		if deltas.signed[key] == e {
+			if e.err != nil {
+				delete(deltas.signed, key) // Retry on the next poll
+			} else {
+				e.size = int64(len(key) + len(e.body))
+				deltas.held.Add(e.size)
+			}
+		}
+		deltas.Unlock()
+		if e.err == nil {
+			governor.grew()
+		}
+	}
+	return e.body, e.err
+}
+
+func (d *deltaCache) MemoryUsage() int64 {
+	return d.held.Load()
+}
+
+// Evict drops signed deltas; every entry belongs to the current version, so
+// any of them is as good as another. A dropped delta is signed again on the
+// next poll that needs it.
+func (d *deltaCache) Evict(n int64) int64 {
+	d.Lock()
+	defer d.Unlock()
+	var freed int64
+	for key, e := range d.signed {
+		if freed >= n {
+			break
+		}
+		if e.size > 0 {
+			freed += e.size
+			d.held.Add(-e.size)
+			delete(d.signed, key)
+		}
+	}
+	return freed
+}
+
+func signDelta(cfg *runtimeConfig, data []byte, answerHash string, withData, withURLs bool) ([]byte, error) {
+	delta := SubscribeDelta{Version: cfg.Version, AnswerHash: answerHash, URLsHash: cfg.urlsHash}
+	if withData {
+		delta.Data = data
+	}
+	if withURLs {
+		delta.URLs = cfg.urlsJSON
+	}
+	signBytes, err := json.Marshal(delta)
+	if err != nil {
+		return nil, err
+	}
+	release, ok := load.acquire()
+	if !ok {
+		return nil, errBusy
+	}
+	hashed := sha256.Sum256(signBytes)
+	delta.Signature, err = rsa.SignPSS(rand.Reader, cfg.PrivateKey, crypto.SHA256, hashed[:], nil)
+	release()
+	if err != nil {
+		return nil, err
+	}
+	return json.Marshal(delta)
+}
+
+// serveSubscribeRegister handles POST /subscribe: the same encrypted payload
+// as /passgfw, answered with a token and the signed current state
+func serveSubscribeRegister(req *passgfwRequest) passgfwReply {
+	if len(req.Body) == 0 {
+		return jsonReply(http.StatusBadRequest, ErrorResponse{Error: "Invalid request body"})
+	}
+	release, ok := load.acquire()
+	if !ok {
+		return jsonReply(http.StatusServiceUnavailable, ErrorResponse{Error: "Server busy"})
+	}
+	cfg := currentConfig()
+	decrypted, err := rsa.DecryptOAEP(sha256.New(), rand.Reader, cfg.PrivateKey, req.Body, nil)
+	release()
+	if err != nil {
+		return jsonReply(http.StatusBadRequest, ErrorResponse{Error: "Decryption failed"})
+	}
+	var payload ClientPayload
+	if err := json.Unmarshal(decrypted, &payload); err != nil || payload.Nonce == "" {
+		return jsonReply(http.StatusBadRequest, ErrorResponse{Error: "Invalid payload"})
+	}
+	nonce, err := base64.StdEncoding.DecodeString(payload.Nonce)
+	if err != nil || len(nonce) == 0 {
+		return jsonReply(http.StatusBadRequest, ErrorResponse{Error: "Invalid nonce"})
+	}
+
+	claims := subscribeClaims{
+		ClientKey: payload.ClientID,
+		Data:      payload.Data,
+		Host:      req.Host,
+		Nonce:     nonce,
+		Expires:   time.Now().Add(subscribeTokenTTL).Unix(),
+	}
+	if claims.ClientKey == "" {
+		claims.ClientKey = req.ClientIP
+	}
+	data, err := answerForClaims(cfg, &claims)
+	if err != nil {
+		return jsonReply(http.StatusInternalServerError, ErrorResponse{Error: "Failed to marshal data"})
+	}
+	state, err := signedDelta(cfg, data, shortHash(data), true, true)
+	if err != nil {
+		return deltaError(err)
+	}
+	return jsonReply(http.StatusOK, SubscribeRegistration{
+		Token:   issueToken(cfg, claims),
+		Expires: claims.Expires,
+		State:   state,
+		Binding: bind(&claims, state),
+	})
+}
+
+// parseSubscribePoll validates GET /subscribe?token=&a=&u=&wait=
+func parseSubscribePoll(q url.Values) (*subscribePoll, *passgfwReply) {
+	claims, ok := verifyToken(currentConfig(), q.Get("token"))
+	if !ok {
+		reply := jsonReply(http.StatusUnauthorized, ErrorResponse{Error: "Invalid or expired token"})
+		return nil, &reply
+	}
+	poll := &subscribePoll{claims: claims, answerHash: q.Get("a"), urlsHash: q.Get("u"), wait: subscribeWait}
+	if s, err := strconv.Atoi(q.Get("wait")); err == nil && s >= 0 {
+		poll.wait = min(time.Duration(s)*time.Second, subscribeMaxWait)
+	}
+	return poll, nil
+}
+
+// pollSubscription compares the poller's hashes with the current config.
+// When they match, ready is false and the caller waits on changed.
+func pollSubscription(poll *subscribePoll) (reply passgfwReply, changed <-chan struct{}, ready bool) {
+	changed = configChanged()
+	cfg := currentConfig()
+	data, err := answerForClaims(cfg, &poll.claims)
+	if err != nil {
+		return jsonReply(http.StatusInternalServerError, ErrorResponse{Error: "Failed to marshal data"}), changed, true
+	}
+	answerHash := shortHash(data)
+	if answerHash == poll.answerHash && cfg.urlsHash == poll.urlsHash {
+		return reply, changed, false
+	}
+	body, err := signedDelta(cfg, data, answerHash, answerHash != poll.answerHash, cfg.urlsHash != poll.urlsHash)
+	if err != nil {
+		return deltaError(err), changed, true
+	}
+	return jsonReply(http.StatusOK, SubscribeUpdate{Delta: body, Binding: bind(&poll.claims, body)}), changed, true
+}
+
+func answerForClaims(cfg *runtimeConfig, claims *subscribeClaims) ([]byte, error) {
+	domain := cfg.Domain
+	if domain == "" {
+		domain = claims.Host
+	}
+	data, _, err := answerFor(cfg, domain, "", "", claims.Data, claims.ClientKey)
+	return data, err
+}
+
+func jsonReply(status int, v any) passgfwReply {
+	body, _ := json.Marshal(v)
+	return passgfwReply{Status: status, Body: body}
+}
+
+func deltaError(err error) passgfwReply {
+	if err == errBusy {
+		return jsonReply(http.StatusServiceUnavailable, ErrorResponse{Error: "Server busy"})
+	}
+	return jsonReply(http.StatusInternalServerError, ErrorResponse{Error: "Signing failed"})
+}
+
+func handleSubscribeRegister(c *gin.Context) {
+	body, _ := c.GetRawData()
+	reply := serveSubscribeRegister(&passgfwRequest{Body: body, Host: c.Request.Host, ClientIP: c.ClientIP()})
+	c.Data(reply.Status, "application/json; charset=utf-8", reply.Body)
+}
+
+func handleSubscribePoll(c *gin.Context) {
+	poll, errReply := parseSubscribePoll(c.Request.URL.Query())
+	if errReply != nil {
+		c.Data(errReply.Status, "application/json; charset=utf-8", errReply.Body)
+		return
+	}
+	timeout := time.NewTimer(poll.wait)
+	defer timeout.Stop()
+	for {
+		reply, changed, ready := pollSubscription(poll)
+		if ready {
+			c.Data(reply.Status, "application/json; charset=utf-8", reply.Body)
+			return
+		}
+		select {
+		case <-changed:
+		case <-timeout.C:
+			c.Status(http.StatusNoContent)
+			return
+		case <-c.Request.Context().Done():
+			return
+		}
+	}
+}
@@ -0,0 +1,49 @@
+package main
+
+import (
+	"fmt"
+	"strings"
+	"time"
+)
+
+const (
+	probeIDHeader = "X-PassGFW-Probe"
+	maxProbeIDLen = 64
+)
+
+// validProbeID accepts only [0-9A-Za-z_-]{1,64}, since the ID is echoed
+// verbatim into a response header
+func validProbeID(id string) bool {
+	if id == "" || len(id) > maxProbeIDLen {
+		return false
+	}
+	for i := 0; i < len(id); i++ {
+		c := id[i]
+		if !('0' <= c && c <= '9' || 'A' <= c && c <= 'Z' || 'a' <= c && c <= 'z' || c == '_' || c == '-') {
+			return false
+		}
+	}
+	return true
+}
+
+// serverTiming renders the stages measured so far as a Server-Timing header
+// value, so clients can split their observed latency into network and server time.
+func (e *journalEntry) serverTiming() string {
+	var b strings.Builder
+	for _, stage := range []struct {
+		name string
+		dur  time.Duration
+	}{
+		{"queue", e.Queue},
+		{"decrypt", e.Decrypt},
+		{"route", e.Route},
+		{"sign", e.Sign},
+		{"total", time.Since(e.Start)},
+	} {
+		if b.Len() > 0 {
+			b.WriteString(", ")
+		}
+		fmt.Fprintf(&b, "%s;dur=%.3f", stage.name, float64(stage.dur)/float64(time.Millisecond))
+	}
+	return b.String()
+}
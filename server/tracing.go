@@ -0,0 +1,366 @@
+package main
+
+import (
+	"bytes"
+	"crypto/rand"
+	"encoding/hex"
+	"encoding/json"
+	"fmt"
+	"log"
+	mrand "math/rand"
+	"net/http"
+	"strconv"
+	"strings"
+	"sync/atomic"
+	"time"
+)
+
+// Request tracing exported as OTLP/JSON over HTTP (POST {endpoint}/v1/traces).
+//
+// Every /passgfw request records a root span and one child per stage. The
+// export decision is made when the request ends: slow or failed requests are
+// always kept (tail sampling), the rest at -trace-sample (head sampling,
+// which an incoming sampled traceparent forces on). Kept traces go through a
+// bounded queue to a single batching goroutine; when the queue is full the
+// trace is dropped, never the request delayed.
+
+const (
+	traceServiceName = "passgfw-server"
+	traceBatchSpans  = 512
+	traceFlushEvery  = 2 * time.Second
+	traceHTTPTimeout = 5 * time.Second
+)
+
+var (
+	otlpEndpoint string        // Collector base URL, e.g. http://127.0.0.1:4318 (empty disables)
+	traceSample  float64       // Head sampling ratio for fast successful requests
+	traceSlow    time.Duration // Requests at least this slow are always exported
+	traceQueue   int           // Traces buffered for export before dropping
+
+	tracer *traceExporter
+)
+
+type spanRecord struct {
+	ID     [8]byte
+	Parent [8]byte
+	Name   string
+	Kind   int
+	Start  time.Time
+	End    time.Time
+	Attrs  []spanAttr
+	Error  string
+}
+
+type spanAttr struct {
+	Key   string
+	Value any // string, int, float64 or bool
+}
+
+// requestTrace collects the spans of one request. A nil *requestTrace is a
+// valid no-op, so the handler does not branch on whether tracing is enabled.
+type requestTrace struct {
+	TraceID     [16]byte
+	HeadSampled bool
+	Spans       []spanRecord // [0] is the root
+}
+
+type traceExporter struct {
+	endpoint string
+	queue    chan *requestTrace
+	stop     chan chan struct{}
+	client   *http.Client
+	queued   atomic.Int64 // Approximate bytes waiting in queue
+	exported atomic.Uint64
+	dropped  atomic.Uint64
+}
+
+// Rough in-memory size of one recorded span, for the memory governor
+const traceSpanBytes = 256
+
+func startTracing() {
+	if otlpEndpoint == "" {
+		return
+	}
+	tracer = &traceExporter{
+		endpoint: strings.TrimSuffix(otlpEndpoint, "/") + "/v1/traces",
+		queue:    make(chan *requestTrace, traceQueue),
+		stop:     make(chan chan struct{}),
+		client:   &http.Client{Timeout: traceHTTPTimeout},
+	}
+	go tracer.loop()
+	governor.register("traces", tracer)
+	log.Printf("Tracing: exporting to %s (sample %.3f, slow %v)", tracer.endpoint, traceSample, traceSlow)
+}
+
+// startTrace opens the root span, continuing a W3C traceparent when present
+func startTrace(traceparent string, start time.Time) *requestTrace {
+	if tracer == nil {
+		return nil
+	}
+	tr := &requestTrace{Spans: make([]spanRecord, 1, 6)}
+	root := &tr.Spans[0]
+	root.Name, root.Kind, root.Start = "POST /passgfw", spanKindServer, start
+	rand.Read(root.ID[:])
+
+	if traceID, parent, sampled, ok := parseTraceparent(traceparent); ok {
+		tr.TraceID, root.Parent, tr.HeadSampled = traceID, parent, sampled
+	} else {
+		rand.Read(tr.TraceID[:])
+		tr.HeadSampled = mrand.Float64() < traceSample
+	}
+	return tr
+}
+
+// stage records a finished child span of the root
+func (tr *requestTrace) stage(name string, start time.Time, attrs ...spanAttr) {
+	if tr == nil {
+		return
+	}
+	s := spanRecord{Parent: tr.Spans[0].ID, Name: name, Kind: spanKindInternal, Start: start, End: time.Now(), Attrs: attrs}
+	rand.Read(s.ID[:])
+	tr.Spans = append(tr.Spans, s)
+}
+
+// finish closes the root span and hands the trace to the exporter if sampled
+func (tr *requestTrace) finish(e *journalEntry) {
+	if tr == nil {
+		return
+	}
+	root := &tr.Spans[0]
+	root.End = time.Now()
+	root.Attrs = append(root.Attrs,
+		spanAttr{"http.response.status_code", e.Status},
+		spanAttr{"passgfw.result", journalResultName(e.Result)},
+		spanAttr{"passgfw.os", e.OS},
+		spanAttr{"passgfw.app", e.App},
+		spanAttr{"passgfw.domain", e.Domain},
+		spanAttr{"passgfw.queue_ms", float64(e.Queue) / float64(time.Millisecond)},
+	)
+	failed := e.Result != journalResultOK || e.Status >= http.StatusInternalServerError
+	if failed {
+		root.Error = journalResultName(e.Result)
+	}
+
+	if !failed && !tr.HeadSampled && root.End.Sub(root.Start) < traceSlow {
+		return
+	}
+	tracer.queued.Add(tr.size())
+	select {
+	case tracer.queue <- tr:
+		governor.grew()
+	default:
+		tracer.queued.Add(-tr.size())
+		tracer.dropped.Add(1)
+	}
+}
+
+func (tr *requestTrace) size() int64 {
+	return int64(len(tr.Spans) * traceSpanBytes)
+}
+
+func (x *traceExporter) MemoryUsage() int64 {
+	return x.queued.Load()
+}
+
+// Evict drops the oldest queued traces
+func (x *traceExporter) Evict(n int64) int64 {
+	var freed int64
+	for freed < n {
+		select {
+		case tr := <-x.queue:
+			freed += tr.size()
+			x.queued.Add(-tr.size())
+			x.dropped.Add(1)
+		default:
+			return freed
+		}
+	}
+	return freed
+}
+
+func (x *traceExporter) loop() {
+	ticker := time.NewTicker(traceFlushEvery)
+	defer ticker.Stop()
+
+	var batch []*requestTrace
+	spans := 0
+	for {
+		select {
+		case tr := <-x.queue:
+			x.queued.Add(-tr.size())
+			batch = append(batch, tr)
+			spans += len(tr.Spans)
+			if spans < traceBatchSpans {
+				continue
+			}
+		case <-ticker.C:
+			if len(batch) == 0 {
+				continue
+			}
+		case done := <-x.stop:
+			for len(x.queue) > 0 {
+				tr := <-x.queue
+				x.queued.Add(-tr.size())
+				batch = append(batch, tr)
+				spans += len(tr.Spans)
+			}
+			if len(batch) > 0 {
+				x.export(batch, spans)
+			}
+			close(done)
+			return
+		}
+		x.export(batch, spans)
+		clear(batch)
+		batch, spans = batch[:0], 0
+	}
+}
+
+// close exports whatever is still queued and stops the loop
+func (x *traceExporter) close() {
+	if x == nil {
+		return
+	}
+	done := make(chan struct{})
+	x.stop <- done
+	<-done
+}
+
+func (x *traceExporter) export(batch []*requestTrace, spans int) {
+	body, err := json.Marshal(encodeOTLP(batch, spans))
+	if err != nil {
+		log.Printf("Tracing: encode: %v", err)
+		return
+	}
+	resp, err := x.client.Post(x.endpoint, "application/json", bytes.NewReader(body))
+	if err != nil {
+		x.dropped.Add(uint64(len(batch)))
+		log.Printf("Tracing: export failed: %v", err)
+		return
+	}
+	resp.Body.Close()
+	if resp.StatusCode/100 != 2 {
+		x.dropped.Add(uint64(len(batch)))
+		log.Printf("Tracing: collector returned HTTP %d", resp.StatusCode)
+		return
+	}
+	x.exported.Add(uint64(len(batch)))
+}
+
+// OTLP/JSON encoding (opentelemetry-proto, JSON mapping)
+
+const (
+	spanKindInternal = 1
+	spanKindServer   = 2
+
+	statusCodeError = 2
+)
+
+type otlpAttr struct {
+	Key   string         `json:"key"`
+	Value map[string]any `json:"value"`
+}
+
+type otlpSpan struct {
+	TraceID      string     `json:"traceId"`
+	SpanID       string     `json:"spanId"`
+	ParentSpanID string     `json:"parentSpanId,omitempty"`
+	Name         string     `json:"name"`
+	Kind         int        `json:"kind"`
+	Start        string     `json:"startTimeUnixNano"`
+	End          string     `json:"endTimeUnixNano"`
+	Attributes   []otlpAttr `json:"attributes,omitempty"`
+	Status       struct {
+		Code    int    `json:"code,omitempty"`
+		Message string `json:"message,omitempty"`
+	} `json:"status"`
+}
+
+func encodeOTLP(batch []*requestTrace, spans int) any {
+	out := make([]otlpSpan, 0, spans)
+	for _, tr := range batch {
+		traceID := hex.EncodeToString(tr.TraceID[:])
+		for _, s := range tr.Spans {
+			o := otlpSpan{
+				TraceID: traceID,
+				SpanID:  hex.EncodeToString(s.ID[:]),
+				Name:    s.Name,
+				Kind:    s.Kind,
+				Start:   strconv.FormatInt(s.Start.UnixNano(), 10),
+				End:     strconv.FormatInt(s.End.UnixNano(), 10),
+			}
+			if s.Parent != ([8]byte{}) {
+				o.ParentSpanID = hex.EncodeToString(s.Parent[:])
+			}
+			for _, a := range s.Attrs {
+				o.Attributes = append(o.Attributes, otlpAttr{a.Key, otlpValue(a.Value)})
+			}
+			if s.Error != "" {
+				o.Status.Code, o.Status.Message = statusCodeError, s.Error
+			}
+			out = append(out, o)
+		}
+	}
+
+	return map[string]any{
+		"resourceSpans": []any{map[string]any{
+			"resource": map[string]any{
+				"attributes": []otlpAttr{{"service.name", otlpValue(traceServiceName)}},
+			},
+			"scopeSpans": []any{map[string]any{
+				"scope": map[string]any{"name": "passgfw"},
+				"spans": out,
+			}},
+		}},
+	}
+}
+
+func otlpValue(v any) map[string]any {
+	switch v := v.(type) {
+	case int:
+		return map[string]any{"intValue": strconv.Itoa(v)} // int64 is a string in OTLP/JSON
+	case float64:
+		return map[string]any{"doubleValue": v}
+	case bool:
+		return map[string]any{"boolValue": v}
+	default:
+		return map[string]any{"stringValue": fmt.Sprint(v)}
+	}
+}
+
+// parseTraceparent parses "00-<trace-id>-<parent-id>-<flags>"
+func parseTraceparent(h string) (traceID [16]byte, parent [8]byte, sampled, ok bool) {
+	parts := strings.Split(h, "-")
+	if len(parts) != 4 || len(parts[0]) != 2 || parts[0] == "ff" ||
+		len(parts[1]) != 32 || len(parts[2]) != 16 || len(parts[3]) != 2 {
+		return
+	}
+	if _, err := hex.Decode(traceID[:], []byte(parts[1])); err != nil || traceID == ([16]byte{}) {
+		return
+	}
+	if _, err := hex.Decode(parent[:], []byte(parts[2])); err != nil || parent == ([8]byte{}) {
+		return
+	}
+	flags, err := strconv.ParseUint(parts[3], 16, 8)
+	if err != nil {
+		return
+	}
+	return traceID, parent, flags&1 == 1, true
+}
+
+func journalResultName(result uint8) string {
+	switch result {
+	case journalResultOK:
+		return "ok"
+	case journalResultBadBody:
+		return "bad_body"
+	case journalResultDecrypt:
+		return "decrypt"
+	case journalResultBadPayload:
+		return "bad_payload"
+	case journalResultShed:
+		return "shed"
+	default:
+		return "internal"
+	}
+}
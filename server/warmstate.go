@@ -0,0 +1,174 @@
+package main
+
+import (
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"hash/crc32"
+	"log"
+	"os"
+	"runtime"
+	"sync"
+	"time"
+
+	"github.com/gin-gonic/gin"
+)
+
+// Warm start: the measured crypto capacity and the latency EWMA are written to
+// -state-file periodically and during shutdown, and reloaded before the node
+// first reports ready. Time to ready and to steady state (latency back at the
+// saved EWMA) is measured on every boot and reported by /health.
+//
+// File layout (little endian), CRC-32 of everything before it at the end:
+//
+//	magic[8] "PGFWWRM2", saved_at i64, capacity_ops f64,
+//	crypto_workers u32, cpus u32, key_bits u32, p99_ewma_ns i64
+
+const (
+	warmMagic         = "PGFWWRM2"
+	warmMaxAge        = 24 * time.Hour // Older capacity figures are re-measured
+	warmEWMAAlpha     = 0.2
+	warmSteadyMinReqs = 20  // Requests per interval before steady state is judged
+	warmSteadyP99     = 1.2 // p99 within this factor of the saved EWMA
+)
+
+var (
+	stateFile    string        // Empty disables warm start
+	stateEvery   time.Duration // Periodic snapshot interval
+	stateRestore bool          // false keeps the baseline only, for cold-start comparison
+
+	processStart = time.Now()
+	warm         warmState
+)
+
+type warmState struct {
+	mu sync.Mutex
+
+	p99EWMA     float64 // ns, over intervals with traffic
+	baselineP99 float64 // Loaded from the previous run
+
+	restoredCapacity bool
+	readyAfterMs     float64 // 0 until ready
+	steadyAfterMs    float64 // 0 until steady
+	snapshotAgeMs    float64 // At boot
+}
+
+// setupWarmState restores the previous snapshot and schedules new ones.
+// It runs before load.start so restored capacity skips the startup probe.
+func setupWarmState() {
+	if stateFile == "" {
+		return
+	}
+	started := time.Now()
+	if err := loadWarmState(stateFile); err != nil && !errors.Is(err, os.ErrNotExist) {
+		log.Printf("Warm start: %v", err)
+	} else if err == nil {
+		log.Printf("Warm start: restored capacity %v in %v",
+			warm.restoredCapacity, time.Since(started).Round(time.Microsecond))
+	}
+
+	go func() {
+		for range time.Tick(stateEvery) {
+			if err := saveWarmState(stateFile); err != nil {
+				log.Printf("Warm start: save failed: %v", err)
+			}
+		}
+	}()
+}
+
+func saveWarmState(path string) error {
+	cfg := currentConfig()
+	le := binary.LittleEndian
+
+	warm.mu.Lock()
+	p99 := warm.p99EWMA
+	warm.mu.Unlock()
+
+	buf := make([]byte, 0, 48)
+	buf = append(buf, warmMagic...)
+	buf = le.AppendUint64(buf, uint64(time.Now().UnixNano()))
+	buf = le.AppendUint64(buf, load.capacity.Load())
+	buf = le.AppendUint32(buf, uint32(cryptoWorkers))
+	buf = le.AppendUint32(buf, uint32(runtime.NumCPU()))
+	buf = le.AppendUint32(buf, uint32(cfg.PrivateKey.N.BitLen()))
+	buf = le.AppendUint64(buf, uint64(p99))
+	buf = le.AppendUint32(buf, crc32.ChecksumIEEE(buf))
+
+	return writeFileAtomic(path, buf)
+}
+
+func loadWarmState(path string) error {
+	buf, err := os.ReadFile(path)
+	if err != nil {
+		return err
+	}
+	if len(buf) < 48 || string(buf[:8]) != warmMagic {
+		return fmt.Errorf("%s: not a warm-start file", path)
+	}
+	le := binary.LittleEndian
+	body := buf[:len(buf)-4]
+	if crc32.ChecksumIEEE(body) != le.Uint32(buf[len(buf)-4:]) {
+		return fmt.Errorf("%s: checksum mismatch", path)
+	}
+
+	cfg := currentConfig()
+	savedAt := time.Unix(0, int64(le.Uint64(body[8:])))
+	capacity := le.Uint64(body[16:])
+	workers, cpus, keyBits := le.Uint32(body[24:]), le.Uint32(body[28:]), le.Uint32(body[32:])
+	p99 := float64(le.Uint64(body[36:]))
+
+	warm.mu.Lock()
+	warm.baselineP99 = p99
+	warm.snapshotAgeMs = float64(time.Since(savedAt)) / float64(time.Millisecond)
+	warm.mu.Unlock()
+
+	if !stateRestore {
+		return nil
+	}
+
+	// Capacity only carries over to the same hardware shape and key size
+	if time.Since(savedAt) < warmMaxAge && capacity != 0 && int(workers) == cryptoWorkers &&
+		int(cpus) == runtime.NumCPU() && int(keyBits) == cfg.PrivateKey.N.BitLen() {
+		load.capacity.Store(capacity)
+		warm.restoredCapacity = true
+	}
+	return nil
+}
+
+// observe is called by the load monitor after every sample
+func (w *warmState) observe(snap *LoadSnapshot, served uint64) {
+	w.mu.Lock()
+	defer w.mu.Unlock()
+	since := float64(time.Since(processStart)) / float64(time.Millisecond)
+
+	if snap.Ready && w.readyAfterMs == 0 {
+		w.readyAfterMs = since
+	}
+
+	if served < warmSteadyMinReqs {
+		return
+	}
+	p99 := snap.P99Ms * float64(time.Millisecond)
+	if w.p99EWMA == 0 {
+		w.p99EWMA = p99
+	} else {
+		w.p99EWMA += warmEWMAAlpha * (p99 - w.p99EWMA)
+	}
+
+	if w.steadyAfterMs == 0 && w.baselineP99 > 0 && p99 <= w.baselineP99*warmSteadyP99 {
+		w.steadyAfterMs = since
+		log.Printf("Warm start: steady after %.0fms (p99 %.2fms)", since, p99/float64(time.Millisecond))
+	}
+}
+
+func (w *warmState) report() gin.H {
+	w.mu.Lock()
+	defer w.mu.Unlock()
+	return gin.H{
+		"restored_capacity": w.restoredCapacity,
+		"snapshot_age_ms":   w.snapshotAgeMs,
+		"ready_after_ms":    w.readyAfterMs,
+		"steady_after_ms":   w.steadyAfterMs,
+		"p99_ewma_ms":       w.p99EWMA / float64(time.Millisecond),
+	}
+}